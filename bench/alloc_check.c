@@ -0,0 +1,165 @@
+/**
+ * zero-allocation check
+ * ---------------------
+ * build: gcc -O2 -DALLOC_STATS -I . bench/alloc_check.c src/editor_state.c src/words.c src/render.c src/mono.c src/selection.c src/document.c src/scratch.c src/block.c src/marker.c src/utf8.c src/docfile.c src/textscan.c src/alloc_stats.c -o alloc_check
+ * usage: alloc_check [blocks]
+ *
+ * asserts that the steady state of the headless core never touches the
+ * heap: idle frames (the layout pass of a frame), cursor movement
+ * (arrow keys with and without shift, clicks and drags) and window
+ * resizes with their reflow. blocks are loaded up front; loading a lazy
+ * block is the one allocation moving onto it may make. exits 1 and names
+ * the subsystem if anything allocated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/editor_state.h"
+#include "include/alloc_stats.h"
+
+#ifndef ALLOC_STATS
+#error "alloc_check counts allocations: build with -DALLOC_STATS"
+#endif
+
+static unsigned seed = 12345;
+
+static unsigned next_rand(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static float measure_fixed(void *user, int codepoint) {
+    (void)user;
+    if (codepoint == ' ') return 5.0f;
+    return 7.0f + codepoint % 5;
+}
+
+// short and long blocks, some with soft breaks and multi-byte text
+static void make_block_text(char *out, int size) {
+    static const char *words[] = { "the", "cursor", "moves", "over", "blocks", "ação", "日本語", "layout", "a" };
+    int i = 0;
+    while (i < size) {
+        const char *w = words[next_rand() % 9];
+        int n = strlen(w);
+        if (i + n + 1 >= size) break;
+        memcpy(&out[i], w, n);
+        i += n;
+        out[i++] = (next_rand() % 15 == 0) ? '\n' : ' ';
+    }
+    out[i] = '\0';
+}
+
+// what a frame lays out before drawing, as main.c does: the focus, then
+// the blocks on screen from the first one the view index finds
+static int layout_frame(EditorState *ed) {
+    const Layout *lo = &ed->layout;
+    editor_place_focus(ed, ed->height);
+    int top;
+    Block *b = editor_block_at(ed, (int)ed->scroll_y - ed->top, &top);
+    int y = ed->top - (int)ed->scroll_y + top;
+    int glyphs = 0;
+    for (; b != NULL && y <= ed->height; b = b->next) {
+        int height = editor_block_estimate(ed, b);
+        if (y + height + lo->gap >= 0) {
+            height = editor_block_height(ed, b);
+            LayoutIter it;
+            layout_begin(&it, lo, b->text, block_len(b));
+            while (layout_next(&it)) glyphs++;
+        }
+        y += height + lo->gap;
+    }
+    return glyphs;
+}
+
+static int failures = 0;
+
+static void expect_none(const char *what, const AllocSnapshot *before, int steps) {
+    AllocSnapshot after, delta;
+    alloc_stats_snapshot(&after);
+    AllocCount total = alloc_stats_since(before, &after, &delta);
+    if (total.allocs == 0 && total.frees == 0) {
+        printf("ok    %-16s %d steps, no allocations\n", what, steps);
+        return;
+    }
+    printf("FAIL  %-16s %lld allocations (%lld bytes), %lld frees:", what, total.allocs, total.bytes, total.frees);
+    for (int a = 0; a < ALLOC_SUBSYSTEMS; a++) {
+        if (delta.sub[a].allocs || delta.sub[a].frees) {
+            printf(" %s %lld/%lld", alloc_subsystem_name(a), delta.sub[a].allocs, delta.sub[a].frees);
+        }
+    }
+    printf("\n");
+    failures++;
+}
+
+int main(int argc, char **argv) {
+    int blocks = (argc > 1) ? atoi(argv[1]) : 2000;
+    Document *doc = create_document();
+    char text[2048];
+    for (int i = 0; i < blocks; i++) {
+        make_block_text(text, (i % 7 == 0) ? 2000 : 20 + next_rand() % 300);
+        add_block(doc, text);
+    }
+    EditorState ed;
+    editor_init(&ed, doc, measure_fixed, NULL);
+    ed.focus = doc->start;
+    ed.focus->cursor_index = 0;
+
+    AllocSnapshot before;
+    int glyphs = 0;
+
+    // idle frames, scrolled around
+    editor_content_height(&ed);   // builds the view index
+    alloc_stats_snapshot(&before);
+    for (int i = 0; i < 200; i++) {
+        ed.scroll_y = (float)(next_rand() % (blocks * 20));
+        glyphs += layout_frame(&ed);
+    }
+    expect_none("idle frames", &before, 200);
+
+    // arrow keys, plain and shifted
+    static const int keys[] = { INPUT_KEY_LEFT, INPUT_KEY_RIGHT, INPUT_KEY_UP, INPUT_KEY_DOWN };
+    int steps = 20000;
+    for (int pass = 0; pass < 2; pass++) {
+        // the first pass warms up: the editor's line map grows to the
+        // longest block it meets
+        if (pass == 1) alloc_stats_snapshot(&before);
+        for (int i = 0; i < steps; i++) {
+            // runs of the same key, so the cursor travels across blocks
+            InputEvent ev = { .type = INPUT_KEY, .key = keys[(i / 50) % 4], .mods = (i / 200) % 2 ? INPUT_SHIFT : 0 };
+            editor_handle(&ed, &ev);
+        }
+    }
+    expect_none("arrow keys", &before, steps);
+
+    // clicks and drags
+    alloc_stats_snapshot(&before);
+    for (int i = 0; i < steps; i++) {
+        InputEvent ev = {
+            .type = (i % 10 == 0) ? INPUT_MOUSE_PRESS : INPUT_MOUSE_DRAG,
+            .x = (float)(next_rand() % 800),
+            .y = (float)(next_rand() % 600),
+        };
+        if (i % 100 == 0) ed.scroll_y = (float)(next_rand() % (blocks * 20));
+        editor_handle(&ed, &ev);
+    }
+    expect_none("mouse", &before, steps);
+
+    // window resizes: new wrap width, reflow step, frame
+    InputEvent size = { .type = INPUT_RESIZE, .x = 800, .y = 600 };
+    editor_handle(&ed, &size);
+    editor_reflow(&ed, EDITOR_REFLOW_BUDGET);
+    alloc_stats_snapshot(&before);
+    for (int i = 0; i < 200; i++) {
+        size.x = (float)(400 + next_rand() % 800);
+        editor_handle(&ed, &size);
+        editor_reflow(&ed, EDITOR_REFLOW_BUDGET / 8);
+        glyphs += layout_frame(&ed);
+    }
+    expect_none("resize", &before, 200);
+
+    if (glyphs < 0) printf("unreachable\n");
+    editor_free(&ed);
+    free_document(doc);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+/**
+ * editor core microbenchmark
+ * --------------------------
+ * build: gcc -O2 -I . bench/editor_bench.c src/editor_state.c src/words.c src/render.c src/mono.c src/selection.c src/document.c src/scratch.c src/block.c src/marker.c src/utf8.c src/docfile.c src/textscan.c src/alloc_stats.c -o editor_bench
+ * usage: editor_bench [max megabytes] [json path]
+ *
+ * runs the headless core (no window) over synthetic documents of 1 to
+ * 10^6 blocks of 10 B to 100 MB each, skipping shapes bigger than the
+ * limit (default 128 MB). every operation is timed one call at a time:
+ *
+ *   add_block        building the document
+ *   type             a char typed in the middle of a random block
+ *   split            hard enter in the middle of a random block
+ *   merge            backspace at the start of a random block
+ *   word_move        ctrl+right from a random point (after an edit, so
+ *                    the block's word bitmaps are rebuilt half the time)
+ *   page_move        page down from a random block (view index lookups,
+ *                    updated after an edit half the time)
+ *   select           update_selection_range between two random points
+ *   find_block       resolving a random block id
+ *   delete_range     delete_selected_text over a quarter of the document
+ *   layout           line count of every block, as a frame does
+ *   layout_mono      the same with a fixed-advance font (mono.h)
+ *
+ * results go out as json (stdout, or the given path) with mean,
+ * p50 / p90 / p99 and max in microseconds; a table goes to stderr.
+ * built with -DALLOC_STATS, heap allocations per call are reported too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/editor_state.h"
+#include "include/alloc_stats.h"
+
+// seconds since the first call: epoch seconds in a double would round
+// away everything below ~0.2 us
+static double now_sec(void) {
+    static time_t base = 0;
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    if (base == 0) base = ts.tv_sec;
+    return (double)(ts.tv_sec - base) + ts.tv_nsec * 1e-9;
+}
+
+static unsigned seed = 12345;
+
+static unsigned next_rand(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// proportional-ish advances, no font needed
+static float measure_fixed(void *user, int codepoint) {
+    (void)user;
+    if (codepoint == ' ') return 5.0f;
+    return 7.0f + codepoint % 5;
+}
+
+// every ascii glyph as wide as the next, so the layout takes mono.h
+static float measure_mono(void *user, int codepoint) {
+    (void)user;
+    return (codepoint < 0x80) ? 8.0f : 12.0f;
+}
+
+// words with a line break every ~12 of them
+static char* make_block_text(size_t size) {
+    static const char *words[] = {
+        "the", "search", "block", "editor", "of", "and", "text", "line", "value",
+        "render", "cursor", "a", "document", "selection", "in", "for", "layout",
+    };
+    int word_count = sizeof(words) / sizeof(words[0]);
+    char *data = (char*)malloc(size + 1);
+    size_t i = 0;
+    while (i < size) {
+        unsigned r = next_rand();
+        const char *w = words[r % word_count];
+        for (int k = 0; w[k] && i < size; k++) data[i++] = w[k];
+        if (i < size) data[i++] = (r % 12 == 0) ? '\n' : ' ';
+    }
+    data[size] = '\0';
+    return data;
+}
+
+// ----------------------------------------------------------------------------
+// samples
+// ----------------------------------------------------------------------------
+
+typedef struct {
+    double *us;
+    int count, cap;
+    long long allocs;    // heap allocations over all the calls
+} Samples;
+
+static AllocSnapshot op_allocs;
+
+// start of one timed call
+static double op_begin(void) {
+    alloc_stats_snapshot(&op_allocs);
+    return now_sec();
+}
+
+static void sample(Samples *s, double t0) {
+    double us = (now_sec() - t0) * 1e6;
+    AllocSnapshot after;
+    alloc_stats_snapshot(&after);
+    s->allocs += alloc_stats_since(&op_allocs, &after, NULL).allocs;
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1024;
+        s->us = (double*)realloc(s->us, s->cap * sizeof(double));
+    }
+    s->us[s->count++] = us;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const Samples *s, double q) {
+    return s->us[(int)(q * (s->count - 1) + 0.5)];
+}
+
+static FILE *json;
+static bool first_result = true;
+
+static void report(const char *op, int blocks, size_t block_bytes, Samples *s) {
+    if (s->count == 0) return;
+    qsort(s->us, s->count, sizeof(double), cmp_double);
+    double sum = 0;
+    for (int i = 0; i < s->count; i++) sum += s->us[i];
+    double mean = sum / s->count;
+
+    fprintf(json, "%s    { \"op\": \"%s\", \"blocks\": %d, \"block_bytes\": %zu, \"samples\": %d, "
+                  "\"mean_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, "
+                  "\"allocs_per_op\": %.2f }",
+            first_result ? "" : ",\n", op, blocks, block_bytes, s->count,
+            mean, percentile(s, 0.5), percentile(s, 0.9), percentile(s, 0.99), s->us[s->count - 1],
+            (double)s->allocs / s->count);
+    first_result = false;
+    fprintf(stderr, "%-13s %8d x %-10zu %7d %12.2f %12.2f %12.2f %12.2f %8.2f\n", op, blocks, block_bytes,
+            s->count, percentile(s, 0.5), percentile(s, 0.99), s->us[s->count - 1], mean, (double)s->allocs / s->count);
+    s->count = 0;
+    s->allocs = 0;
+}
+
+// ----------------------------------------------------------------------------
+// documents
+// ----------------------------------------------------------------------------
+
+typedef struct {
+    Document *doc;
+    Block **blocks;      // document order at build time
+    int count;
+} Fixture;
+
+static void build(Fixture *f, int blocks, const char *text, Samples *timing) {
+    f->doc = create_document();
+    for (int i = 0; i < blocks; i++) {
+        double t0 = op_begin();
+        add_block(f->doc, (char*)text);
+        if (timing != NULL) sample(timing, t0);
+    }
+    f->blocks = (Block**)malloc(blocks * sizeof(Block*));
+    f->count = 0;
+    for (Block *b = f->doc->start; b; b = b->next) f->blocks[f->count++] = b;
+}
+
+static void teardown(Fixture *f) {
+    free_document(f->doc);
+    free(f->blocks);
+}
+
+static Block* random_block(const Fixture *f) {
+    return f->blocks[next_rand() % f->count];
+}
+
+// calls per operation: enough for stable percentiles, bounded in time
+static int sample_count(int blocks, size_t block_bytes) {
+    double cost = blocks * 4.0 + block_bytes / 8.0;
+    int n = (int)(2e8 / cost);
+    if (n < 20) n = 20;
+    if (n > 1000) n = 1000;
+    return n;
+}
+
+static InputEvent key_event(int key) {
+    return (InputEvent){ .type = INPUT_KEY, .key = key };
+}
+
+static void run_shape(int blocks, size_t block_bytes) {
+    Samples s = { 0 };
+    char *text = make_block_text(block_bytes);
+    int n = sample_count(blocks, block_bytes);
+    Fixture f;
+    EditorState ed;
+
+    // add_block
+    build(&f, blocks, text, &s);
+    report("add_block", blocks, block_bytes, &s);
+
+    // typing in the middle of a block
+    editor_init(&ed, f.doc, measure_fixed, NULL);
+    for (int i = 0; i < n; i++) {
+        ed.focus = random_block(&f);
+        ed.focus->cursor_index = block_len(ed.focus) / 2;
+        InputEvent ev = { .type = INPUT_CHAR, .codepoint = 'x' };
+        double t0 = op_begin();
+        editor_handle(&ed, &ev);
+        sample(&s, t0);
+    }
+    report("type", blocks, block_bytes, &s);
+
+    // word jumps, every other one right after typing into the block
+    for (int i = 0; i < n; i++) {
+        ed.focus = random_block(&f);
+        ed.focus->cursor_index = next_rand() % (block_len(ed.focus) + 1);
+        if (i % 2 == 0) block_insert(ed.focus, ed.focus->cursor_index, "w", 1);
+        InputEvent ev = { .type = INPUT_KEY, .key = INPUT_KEY_RIGHT, .mods = INPUT_CTRL };
+        double t0 = op_begin();
+        editor_handle(&ed, &ev);
+        sample(&s, t0);
+    }
+    report("word_move", blocks, block_bytes, &s);
+
+    // page down from anywhere, every other one after typing in the focus
+    // (the view index takes it as a height update)
+    for (int i = 0; i < n; i++) {
+        ed.focus = random_block(&f);
+        ed.focus->cursor_index = 0;
+        if (i % 2 == 0) block_insert(ed.focus, 0, "p", 1);
+        InputEvent ev = key_event(INPUT_KEY_PAGE_DOWN);
+        double t0 = op_begin();
+        editor_handle(&ed, &ev);
+        sample(&s, t0);
+    }
+    report("page_move", blocks, block_bytes, &s);
+
+    // hard enter splits
+    for (int i = 0; i < n; i++) {
+        ed.focus = random_block(&f);
+        ed.focus->cursor_index = block_len(ed.focus) / 2;
+        InputEvent ev = key_event(INPUT_KEY_ENTER);
+        double t0 = op_begin();
+        editor_handle(&ed, &ev);
+        sample(&s, t0);
+    }
+    report("split", blocks, block_bytes, &s);
+    editor_free(&ed);
+    teardown(&f);
+
+    // backspace merges (the merged block leaves the pick list)
+    build(&f, blocks, text, NULL);
+    editor_init(&ed, f.doc, measure_fixed, NULL);
+    for (int i = 0; i < n && f.count > 1; i++) {
+        int k = next_rand() % f.count;
+        if (f.blocks[k] == f.doc->start) continue;
+        ed.focus = f.blocks[k];
+        ed.focus->cursor_index = 0;
+        f.blocks[k] = f.blocks[--f.count];
+        InputEvent ev = key_event(INPUT_KEY_BACKSPACE);
+        double t0 = op_begin();
+        editor_handle(&ed, &ev);
+        sample(&s, t0);
+    }
+    report("merge", blocks, block_bytes, &s);
+    editor_free(&ed);
+    teardown(&f);
+
+    // update_selection_range between random points
+    build(&f, blocks, text, NULL);
+    Selection sel = { 0 };
+    for (int i = 0; i < n; i++) {
+        Block *a = random_block(&f), *b = random_block(&f);
+        selection_begin(&sel, a, next_rand() % (block_len(a) + 1));
+        int index = next_rand() % (block_len(b) + 1);
+        double t0 = op_begin();
+        update_selection_range(f.doc, &sel, b, index);
+        sample(&s, t0);
+    }
+    report("select", blocks, block_bytes, &s);
+
+    // id lookups
+    for (int i = 0; i < n; i++) {
+        int id = random_block(&f)->id;
+        double t0 = op_begin();
+        Block *found = find_block(f.doc, id);
+        sample(&s, t0);
+        if (found == NULL || found->id != id) printf("find_block lost id %d\n", id);
+    }
+    report("find_block", blocks, block_bytes, &s);
+
+    // full layout
+    editor_init(&ed, f.doc, measure_fixed, NULL);
+    int lines = 0;
+    for (int i = 0; i < (n < 50 ? n : 50); i++) {
+        double t0 = op_begin();
+        for (Block *b = f.doc->start; b; b = b->next) lines += layout_line_count(&ed.layout, b->text, block_len(b));
+        sample(&s, t0);
+    }
+    report("layout", blocks, block_bytes, &s);
+    editor_free(&ed);
+
+    editor_init(&ed, f.doc, measure_mono, NULL);
+    for (int i = 0; i < (n < 50 ? n : 50); i++) {
+        double t0 = op_begin();
+        for (Block *b = f.doc->start; b; b = b->next) lines += layout_line_count(&ed.layout, b->text, block_len(b));
+        sample(&s, t0);
+    }
+    if (lines < 0) printf("unreachable\n");
+    report("layout_mono", blocks, block_bytes, &s);
+    editor_free(&ed);
+    teardown(&f);
+
+    // delete_selected_text over a quarter of a fresh document
+    for (int i = 0; i < 5; i++) {
+        build(&f, blocks, text, NULL);
+        int first = f.count / 4, last = first + f.count / 4;
+        Block *a = f.blocks[first], *b = f.blocks[last];
+        int from = block_len(a) / (blocks == 1 ? 4 : 2);
+        int to = (blocks == 1) ? block_len(b) * 3 / 4 : block_len(b) / 2;
+        selection_begin(&sel, a, from);
+        update_selection_range(f.doc, &sel, b, to);
+        double t0 = op_begin();
+        delete_selected_text(f.doc);
+        sample(&s, t0);
+        teardown(&f);
+    }
+    report("delete_range", blocks, block_bytes, &s);
+
+    free(s.us);
+    free(text);
+}
+
+int main(int argc, char **argv) {
+    size_t max_bytes = ((argc > 1) ? (size_t)atoi(argv[1]) : 128) << 20;
+    json = (argc > 2) ? fopen(argv[2], "w") : stdout;
+    if (json == NULL) {
+        fprintf(stderr, "cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    static const int block_counts[] = { 1, 100, 10000, 1000000 };
+    static const size_t block_sizes[] = { 10, 1000, 100000, 100 << 20 };
+
+    fprintf(json, "{\n  \"bench\": \"editor_core\",\n  \"unit\": \"us\",\n  \"alloc_stats\": %s,\n  \"results\": [\n",
+            alloc_stats_enabled() ? "true" : "false");
+    fprintf(stderr, "%-13s %23s %7s %12s %12s %12s %12s %8s\n", "op", "blocks x bytes", "samples", "p50 us", "p99 us", "max us", "mean us", "allocs");
+    for (int c = 0; c < 4; c++) {
+        for (int z = 0; z < 4; z++) {
+            if ((size_t)block_counts[c] * block_sizes[z] > max_bytes) continue;
+            run_shape(block_counts[c], block_sizes[z]);
+        }
+    }
+    fprintf(json, "\n  ]\n}\n");
+    if (json != stdout) fclose(json);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * event stream check
+ * ------------------
+ * build: gcc -O2 -I . bench/event_check.c src/search.c src/regex.c src/editor_state.c src/words.c src/render.c src/mono.c src/selection.c src/document.c src/scratch.c src/block.c src/marker.c src/utf8.c src/docfile.c src/textscan.c src/alloc_stats.c -o event_check
+ * usage: event_check
+ *
+ * feeds short scripted event streams through the headless core, with the
+ * layout pass of a frame between events, the way main.c runs them, and
+ * checks where they leave the focus, the cursor and the document. each
+ * stream is one the app can see (a frame before the first click, ...).
+ * build it with -fsanitize=address to have bad reads fail loudly too.
+ * exits 1 if a check failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/editor_state.h"
+#include "include/search.h"
+
+static float measure_fixed(void *user, int codepoint) {
+    (void)user;
+    return codepoint == ' ' ? 5.0f : 9.0f;
+}
+
+// what a frame lays out before drawing, as main.c does: the focus, then
+// the blocks in the view and its overscan
+static int layout_frame(EditorState *ed) {
+    const Layout *lo = &ed->layout;
+    int overscan = ed->height;
+    editor_place_focus(ed, overscan);
+    int top;
+    Block *b = editor_block_at(ed, (int)ed->scroll_y - ed->top - overscan, &top);
+    int y = ed->top - (int)ed->scroll_y + top;
+    int glyphs = 0;
+    for (; b != NULL && y <= ed->height + overscan; b = b->next) {
+        int height = editor_block_estimate(ed, b);
+        if (y + height + lo->gap >= 0 && y <= ed->height) {
+            block_load(b);
+            height = editor_block_height(ed, b);
+            LayoutIter it;
+            layout_begin(&it, lo, b->text, block_len(b));
+            while (layout_next(&it)) glyphs++;
+        }
+        y += height + lo->gap;
+    }
+    return glyphs;
+}
+
+// events, then reflow and a frame
+static void run(EditorState *ed, const InputEvent *events, int count) {
+    for (int i = 0; i < count; i++) editor_handle(ed, &events[i]);
+    editor_reflow(ed, EDITOR_REFLOW_BUDGET);
+    layout_frame(ed);
+}
+
+static int failures = 0;
+
+static void check(const char *stream, const char *what, bool ok) {
+    if (ok) return;
+    printf("FAIL  %-24s %s\n", stream, what);
+    failures++;
+}
+
+static Document* make_document(int blocks) {
+    Document *doc = create_document();
+    char text[256];
+    for (int i = 0; i < blocks; i++) {
+        snprintf(text, sizeof(text), "block %d: the quick brown fox jumps over the lazy dog\nand a second line", i);
+        add_block(doc, text);
+    }
+    return doc;
+}
+
+// the app's first frames: nothing is focused until a click or a drop,
+// keys and scrolling before it go nowhere
+static void first_frame(void) {
+    const char *name = "first frame";
+    Document *doc = make_document(200);
+    EditorState ed;
+    editor_init(&ed, doc, measure_fixed, NULL);
+    run(&ed, &(InputEvent){ .type = INPUT_RESIZE, .x = 800, .y = 600 }, 1);
+    check(name, "focus before any click", ed.focus == NULL);
+
+    InputEvent keys[] = {
+        { .type = INPUT_KEY, .key = INPUT_KEY_DOWN },
+        { .type = INPUT_KEY, .key = INPUT_KEY_PAGE_DOWN },
+        { .type = INPUT_CHAR, .codepoint = 'x' },
+        { .type = INPUT_KEY, .key = INPUT_KEY_BACKSPACE },
+    };
+    run(&ed, keys, 4);
+    ed.scroll_y = 3000;
+    run(&ed, NULL, 0);
+    check(name, "keys without a focus", ed.focus == NULL && ed.scroll_y == 3000);
+    check(name, "document untouched", block_len(doc->start) == (int)strlen("block 0: the quick brown fox jumps over the lazy dog\nand a second line"));
+
+    // the first click focuses, typing goes there
+    ed.scroll_y = 0;
+    run(&ed, &(InputEvent){ .type = INPUT_MOUSE_PRESS, .x = ed.left + 1, .y = ed.top + 1 }, 1);
+    check(name, "click focuses the first block", ed.focus == doc->start && doc->start->cursor_index == 0);
+    run(&ed, &(InputEvent){ .type = INPUT_CHAR, .codepoint = 'x' }, 1);
+    check(name, "typing after the click", doc->start->text[0] == 'x' && doc->start->cursor_index == 1);
+
+    editor_free(&ed);
+    free_document(doc);
+}
+
+// find bar replace all (main.c calls it between frames) with the cursor
+// in a block a crossing match absorbs: the focus moves to the block the
+// match was merged into, after the replacement
+static void replace_absorbed_focus(void) {
+    const char *name = "replace all, focus merged";
+    Document *doc = create_document();
+    add_block(doc, "one two");
+    add_block(doc, "three");
+    add_block(doc, "four five");
+    EditorState ed;
+    editor_init(&ed, doc, measure_fixed, NULL);
+    run(&ed, &(InputEvent){ .type = INPUT_RESIZE, .x = 800, .y = 600 }, 1);
+    int top = editor_block_top(&ed, doc->start->next);
+    run(&ed, &(InputEvent){ .type = INPUT_MOUSE_PRESS, .x = ed.left + 20, .y = ed.top + top + ed.layout.pad + 1 }, 1);
+    check(name, "click focuses the middle block", ed.focus == doc->start->next && ed.focus->cursor_index > 0);
+
+    const char needle[] = { 't', 'w', 'o', SEARCH_BLOCK_SEP, 't', 'h', 'r', 'e', 'e', SEARCH_BLOCK_SEP, 'f', 'o', 'u', 'r' };
+    SearchQuery q;
+    search_query_init(&q, needle, sizeof(needle), SEARCH_CROSS_BLOCKS);
+    int count = search_replace_all(doc, &q, "2-4", 3, &ed.focus);
+    search_query_free(&q);
+    check(name, "one replacement", count == 1);
+    check(name, "blocks merged", doc->start->next == NULL && strcmp(doc->start->text, "one 2-4 five") == 0);
+    check(name, "focus on the merged block", ed.focus == doc->start);
+    check(name, "cursor after the replacement", ed.focus->cursor_index == (int)strlen("one 2-4"));
+
+    run(&ed, &(InputEvent){ .type = INPUT_CHAR, .codepoint = '!' }, 1);
+    check(name, "typing after the replace", strcmp(doc->start->text, "one 2-4! five") == 0);
+
+    editor_free(&ed);
+    free_document(doc);
+}
+
+int main(void) {
+    first_frame();
+    replace_absorbed_focus();
+    if (failures == 0) printf("ok    all event streams\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * substring search microbenchmark
+ * -------------------------------
+ * build: gcc -O2 -I . bench/search_bench.c src/search.c src/regex.c src/document.c src/scratch.c src/block.c src/marker.c src/utf8.c src/docfile.c src/textscan.c src/alloc_stats.c -o search_bench
+ * usage: search_bench [megabytes]
+ *
+ * times search_find_with per kernel for a few needle lengths over
+ * synthetic text (needle absent, so every byte is scanned) and prints
+ * the best of several runs in GB/s.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/search.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// english-ish words, so first/last byte candidates show up at a realistic rate
+static char* make_text(size_t size) {
+    static const char *words[] = {
+        "the", "search", "block", "editor", "of", "and", "text", "line", "value",
+        "render", "cursor", "a", "document", "selection", "in", "for", "layout",
+    };
+    int word_count = sizeof(words) / sizeof(words[0]);
+    char *data = (char*)malloc(size);
+    unsigned seed = 12345;
+    size_t i = 0;
+    while (i < size) {
+        seed = seed * 1103515245 + 12345;
+        const char *w = words[(seed >> 16) % word_count];
+        for (int k = 0; w[k] && i < size; k++) data[i++] = w[k];
+        if (i < size) data[i++] = ((seed >> 8) % 12 == 0) ? '\n' : ' ';
+    }
+    return data;
+}
+
+int main(int argc, char **argv) {
+    size_t mb = (argc > 1) ? (size_t)atoi(argv[1]) : 256;
+    size_t size = mb << 20;
+    char *text = make_text(size);
+
+    static const char *needles[] = {
+        "zq", "layouts", "document selectionz", "the editor render cursor layout of blocks in text z",
+        "search block editor of and text line value render cursor a document selection in for layout "
+        "the search block editor of and text line value render cursor a document selection in for layout "
+        "the search block editor z",
+    };
+    static const char *kernels[] = { "auto", "scalar", "sse2", "avx2" };
+
+    for (size_t n = 0; n < sizeof(needles) / sizeof(needles[0]); n++) {
+        SearchQuery q;
+        search_query_init(&q, needles[n], (int)strlen(needles[n]), 0);
+        printf("needle %2d bytes:", q.len);
+        for (int k = 0; k < 4; k++) {
+            double best = 1e9;
+            for (int run = 0; run < 5; run++) {
+                double t0 = now_sec();
+                const char *hit = search_find_with((ScanKernel)k, &q, text, size);
+                double t = now_sec() - t0;
+                if (hit != NULL) printf(" (found?)");
+                if (t < best) best = t;
+            }
+            printf("  %s %.2f GB/s", kernels[k], size / best / 1e9);
+        }
+        printf("\n");
+        search_query_free(&q);
+    }
+
+    free(text);
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * text import scanner microbenchmark
+ * ----------------------------------
+ * build: gcc -O2 -I . bench/split_bench.c src/textscan.c -o split_bench
+ * usage: split_bench [megabytes]
+ *
+ * times text_split per kernel on synthetic LF and CRLF text and prints
+ * the best of several runs in GB/s.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/textscan.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// lines of 20-100 chars, a blank line every ~8 lines
+static char* make_text(size_t size, bool crlf) {
+    char *data = (char*)malloc(size);
+    unsigned seed = 12345;
+    size_t i = 0;
+    int line = 0;
+    while (i < size) {
+        seed = seed * 1103515245 + 12345;
+        int n = 20 + (seed >> 16) % 80;
+        for (int k = 0; k < n && i < size; k++) data[i++] = 'a' + (k * 7 + line) % 26;
+        int breaks = (line % 8 == 7) ? 2 : 1;
+        for (int k = 0; k < breaks; k++) {
+            if (crlf && i < size) data[i++] = '\r';
+            if (i < size) data[i++] = '\n';
+        }
+        line++;
+    }
+    return data;
+}
+
+static void run(const char *label, const char *input, size_t size) {
+    static const struct { ScanKernel kernel; const char *name; } kernels[] = {
+        { SCAN_SCALAR, "scalar" }, { SCAN_SSE2, "sse2" }, { SCAN_AVX2, "avx2" },
+    };
+    char *work = (char*)malloc(size);
+    TextSpans split = {0};
+
+    for (int k = 0; k < 3; k++) {
+        double best = 1e30;
+        for (int rep = 0; rep < 5; rep++) {
+            memcpy(work, input, size);
+            double t0 = now_sec();
+            text_split_with(kernels[k].kernel, work, size, &split);
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        printf("%-5s %-6s %8.2f GB/s  blocks %d  len %zu\n",
+               label, kernels[k].name, size / best / 1e9, split.count, split.len);
+    }
+    text_split_free(&split);
+    free(work);
+}
+
+int main(int argc, char **argv) {
+    size_t mb = (argc > 1) ? (size_t)atoi(argv[1]) : 256;
+    size_t size = mb << 20;
+    printf("text_split, %zu MB, default kernel: %s\n", mb, text_split_kernel_name());
+
+    char *lf = make_text(size, false);
+    run("lf", lf, size);
+    free(lf);
+
+    char *crlf = make_text(size, true);
+    run("crlf", crlf, size);
+    free(crlf);
+    return 0;
+}
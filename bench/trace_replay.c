@@ -0,0 +1,150 @@
+/**
+ * input trace replay
+ * ------------------
+ * build: gcc -O2 -I . bench/trace_replay.c src/trace.c src/editor_state.c src/words.c src/render.c src/mono.c src/selection.c src/document.c src/scratch.c src/block.c src/marker.c src/utf8.c src/docfile.c src/textscan.c src/alloc_stats.c -o trace_replay
+ * usage: trace_replay trace [document]
+ *
+ * feeds a trace recorded with TEXT_EDITOR_TRACE=path through the headless
+ * core, frame by frame, with the recorded view and glyph advances, so
+ * two runs over the same trace do exactly the same work. the document
+ * is the file the recording started from (or the editor's default
+ * block when none is given).
+ *
+ * a frame's time is its events plus the layout pass a frame does (the
+ * focus and the blocks around the view, every glyph of the visible
+ * ones), without drawing. prints p50 / p99 / max, and whether the replay
+ * ended on the document the recording did.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/docfile.h"
+#include "include/trace.h"
+
+// seconds since the first call: epoch seconds in a double would round
+// away everything below ~0.2 us
+static double now_sec(void) {
+    static time_t base = 0;
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    if (base == 0) base = ts.tv_sec;
+    return (double)(ts.tv_sec - base) + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// what a frame lays out before drawing, as main.c does: the focus, then
+// the blocks in the view and its overscan, from the first one the view
+// index finds. returns glyphs visited.
+static int layout_frame(EditorState *ed) {
+    const Layout *lo = &ed->layout;
+    int overscan = ed->height;
+    editor_place_focus(ed, overscan);
+    int top;
+    Block *b = editor_block_at(ed, (int)ed->scroll_y - ed->top - overscan, &top);
+    int y = ed->top - (int)ed->scroll_y + top;
+    int glyphs = 0;
+    for (; b != NULL && y <= ed->height + overscan; b = b->next) {
+        int height = editor_block_estimate(ed, b);
+        if (y + height + lo->gap >= 0 && y <= ed->height) {
+            block_load(b);
+            height = editor_block_height(ed, b);
+            LayoutIter it;
+            layout_begin(&it, lo, b->text, block_len(b));
+            while (layout_next(&it)) glyphs++;
+        }
+        y += height + lo->gap;
+    }
+    return glyphs;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: trace_replay trace [document]\n");
+        return 1;
+    }
+    const char *error = NULL;
+    TraceReader *r = trace_read_open(argv[1], &error);
+    if (r == NULL) {
+        fprintf(stderr, "%s: %s\n", argv[1], error);
+        return 1;
+    }
+
+    Document *doc = create_document();
+    if (argc < 3 || !docfile_open(doc, argv[2])) {
+        if (argc >= 3) fprintf(stderr, "cannot open %s, starting from the default document\n", argv[2]);
+        add_block(doc, "click here to edit...");
+    }
+    unsigned blocks = 0, want_blocks;
+    unsigned long long bytes = 0, want_bytes;
+    for (Block *b = doc->start; b; b = b->next) {
+        blocks++;
+        bytes += block_len(b);
+    }
+    trace_read_doc_info(r, &want_blocks, &want_bytes);
+    if (blocks != want_blocks || bytes != want_bytes) {
+        fprintf(stderr, "warning: recorded on %u blocks / %llu bytes, replaying on %u / %llu\n",
+                want_blocks, want_bytes, blocks, bytes);
+    }
+
+    EditorState ed;
+    trace_read_init(r, &ed, doc);
+
+    InputQueue events = { 0 };
+    TraceFrame frame;
+    double *us = NULL;
+    int frames = 0, cap = 0, event_count = 0;
+    long long glyphs = 0;
+    double t_first = 0, t_last = 0;
+    while (trace_read_frame(r, &frame, &events)) {
+        if (frames == 0) t_first = frame.time;
+        t_last = frame.time;
+        ed.scroll_y = frame.scroll_y;
+        ed.height = frame.height;
+
+        double t0 = now_sec();
+        for (int i = 0; i < events.count; i++) editor_handle(&ed, &events.events[i]);
+        editor_reflow(&ed, EDITOR_REFLOW_BUDGET);
+        glyphs += layout_frame(&ed);
+        double t = (now_sec() - t0) * 1e6;
+
+        if (frames == cap) {
+            cap = cap ? cap * 2 : 4096;
+            us = (double*)realloc(us, cap * sizeof(double));
+        }
+        us[frames++] = t;
+        event_count += events.count;
+    }
+
+    printf("%d frames (%.1f s recorded), %d events, %lld glyphs laid out\n",
+           frames, t_last - t_first, event_count, glyphs);
+    if (frames > 0) {
+        qsort(us, frames, sizeof(double), cmp_double);
+        printf("frame us: p50 %.2f  p99 %.2f  max %.2f\n",
+               us[(int)(0.5 * (frames - 1) + 0.5)], us[(int)(0.99 * (frames - 1) + 0.5)], us[frames - 1]);
+    }
+
+    int status = 0;
+    unsigned long long want_hash;
+    if (!trace_read_end(r, &want_hash, &want_blocks)) {
+        printf("trace ends early (no end record), final document not checked\n");
+    } else {
+        blocks = 0;
+        for (Block *b = doc->start; b; b = b->next) blocks++;
+        bool same = (trace_doc_hash(doc) == want_hash && blocks == want_blocks);
+        printf("final document: %s\n", same ? "matches the recording" : "DIFFERS from the recording");
+        status = same ? 0 : 2;
+    }
+
+    free(us);
+    input_free(&events);
+    editor_free(&ed);
+    free_document(doc);
+    trace_read_close(r);
+    return status;
+}
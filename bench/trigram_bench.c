@@ -0,0 +1,133 @@
+/**
+ * trigram index benchmark
+ * -----------------------
+ * build: gcc -O2 -I . bench/trigram_bench.c src/trigram.c src/search.c src/search_job.c src/threadpool.c src/regex.c src/document.c src/scratch.c src/block.c src/marker.c src/utf8.c src/docfile.c src/textscan.c src/alloc_stats.c -lpthread -o trigram_bench
+ * usage: trigram_bench [blocks] [index megabytes]
+ *
+ * builds a synthetic document (paragraph-sized lazy blocks of
+ * english-ish words plus a few rare tokens), indexes it and compares the latency of
+ * finding every block that matches a query: brute-force scan of all
+ * blocks vs index filter + verification of the candidates.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/trigram.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned seed = 12345;
+
+static unsigned next_rand(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void make_paragraph(char *out, int size, int index) {
+    static const char *words[] = {
+        "the", "search", "block", "editor", "of", "and", "text", "line", "value",
+        "render", "cursor", "a", "document", "selection", "in", "for", "layout",
+    };
+    int word_count = sizeof(words) / sizeof(words[0]);
+    int i = 0;
+    while (i < size - 24) {
+        const char *w = words[next_rand() % word_count];
+        int n = strlen(w);
+        memcpy(&out[i], w, n);
+        i += n;
+        out[i++] = ' ';
+    }
+    // rare tokens: one block in 1000, one in 100000
+    if (index % 1000 == 7) i += sprintf(&out[i], "quasar%d ", index % 10);
+    if (index % 100000 == 3) i += sprintf(&out[i], "zyzzyva ");
+    out[i] = '\0';
+}
+
+// blocks matching q, and the time it took
+static int count_blocks(Document *doc, const SearchQuery *q, const TrigramFilter *f, double *ms) {
+    double t0 = now_sec();
+    int count = 0;
+    for (Block *b = doc->start; b; b = b->next) {
+        if (f != NULL && !trigram_filter_has(f, b)) continue;
+        SearchMatch m;
+        if (search_in_block(q, b, 0, &m)) count++;
+    }
+    *ms = (now_sec() - t0) * 1000.0;
+    return count;
+}
+
+int main(int argc, char **argv) {
+    int blocks = (argc > 1) ? atoi(argv[1]) : 200000;
+    size_t budget = (argc > 2) ? (size_t)atoi(argv[2]) << 20 : TRIGRAM_INDEX_BYTES;
+
+    // lazy blocks over one buffer, like a file opened through the mapping
+    char *text = (char*)malloc((size_t)blocks * 512);
+    Document *doc = create_document();
+    size_t bytes = 0;
+    for (int i = 0; i < blocks; i++) {
+        char *para = &text[bytes];
+        make_paragraph(para, 200 + next_rand() % 300, i);
+        int len = strlen(para);
+        append_block(doc, create_lazy_block(i + 1, para, len, 1));
+        bytes += len;
+    }
+    doc->id_counter = blocks;
+    printf("document: %d blocks, %.1f MB\n", blocks, bytes / 1048576.0);
+
+    double t0 = now_sec();
+    TrigramIndex *ix = trigram_index_create(budget);
+    for (Block *b = doc->start; b; b = b->next) trigram_index_add(ix, b);
+    printf("index: built in %.0f ms, %.1f MB of %.0f MB budget\n",
+           (now_sec() - t0) * 1000.0, trigram_index_bytes(ix) / 1048576.0, budget / 1048576.0);
+
+    static const struct { const char *needle; int flags; } queries[] = {
+        { "zyzzyva", 0 },
+        { "quasar3", 0 },
+        { "quasar", 0 },
+        { "quasar[0-4]", SEARCH_REGEX },
+        { "selection layout", 0 },
+        { "the", 0 },
+    };
+    printf("%-20s %10s %10s %12s %10s\n", "query", "matches", "scan ms", "candidates", "index ms");
+    for (size_t k = 0; k < sizeof(queries) / sizeof(queries[0]); k++) {
+        SearchQuery q;
+        search_query_init(&q, queries[k].needle, (int)strlen(queries[k].needle), queries[k].flags);
+
+        double scan_ms, index_ms;
+        int brute = count_blocks(doc, &q, NULL, &scan_ms);
+
+        double t1 = now_sec();
+        TrigramFilter *f = trigram_filter(ix, &q);
+        double filter_ms = (now_sec() - t1) * 1000.0;
+        int indexed = count_blocks(doc, &q, f, &index_ms);
+        int candidates = 0;
+        for (Block *b = doc->start; b; b = b->next) candidates += (f == NULL || trigram_filter_has(f, b));
+        trigram_filter_free(f);
+
+        printf("%-20s %10d %10.2f %12d %10.2f%s\n", queries[k].needle, brute, scan_ms,
+               candidates, filter_ms + index_ms, indexed == brute ? "" : "  MISMATCH");
+        search_query_free(&q);
+    }
+
+    // incremental update: edit 1000 blocks, then sync
+    int edited = 0;
+    for (Block *b = doc->start; b; b = b->next) {
+        if (next_rand() % (blocks / 1000 + 1) != 0) continue;
+        block_touch(b);
+        edited++;
+    }
+    t0 = now_sec();
+    int synced = trigram_index_sync(ix, doc);
+    printf("sync after editing %d blocks: %d re-indexed in %.2f ms\n", edited, synced, (now_sec() - t0) * 1000.0);
+
+    trigram_index_free(ix);
+    free_document(doc);
+    free(text);
+    return 0;
+}
@@ -5,7 +5,9 @@ echo Compilando com w64devkit...
 
 set PATH=C:\w64devkit\bin;%PATH%
 
-gcc main.c -o app.exe -I include -L lib -lraylib -lopengl32 -lgdi32 -lwinmm
+REM argumentos vao para o gcc: "build.bat -DPROFILE" liga os marcadores de perfil (F11 grava profile.json), "-DALLOC_STATS" conta as alocacoes
+
+gcc %* src/main.c src/block.c src/document.c src/docfile.c src/textscan.c src/utf8.c src/glyph_cache.c src/search.c src/regex.c src/search_job.c src/threadpool.c src/trigram.c src/highlight.c src/selection.c src/render.c src/mono.c src/editor_state.c src/words.c src/trace.c src/frame_stats.c src/profile.c src/alloc_stats.c src/scratch.c src/marker.c -o app.exe -I . -I include -L lib -lraylib -lopengl32 -lgdi32 -lwinmm
 
 if %errorlevel% neq 0 (
     pause
@@ -0,0 +1,72 @@
+/**
+ * allocation accounting
+ * ---------------------
+ * built with -DALLOC_STATS, malloc / calloc / realloc / strdup / free in
+ * our sources go through counting wrappers, tagged with the subsystem
+ * of the file that calls them. a source defines ALLOC_SUBSYSTEM and
+ * includes this header after every other one (it redefines names the
+ * system headers declare). counters are atomic, worker threads count
+ * too. without the flag nothing is wrapped and every counter reads 0.
+ *
+ * a frame or an operation is measured by taking a snapshot before and
+ * after it. allocations made in headers (inline functions) and by
+ * raylib are not seen.
+ */
+
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef enum {
+    ALLOC_DOCUMENT,      // blocks & block list
+    ALLOC_EDIT,          // selection, editor state
+    ALLOC_FILE,          // docfile, text scan, traces
+    ALLOC_SEARCH,        // search, regex, jobs, highlights
+    ALLOC_INDEX,         // trigram index
+    ALLOC_GLYPHS,
+    ALLOC_UI,            // main loop, find bar, statistics
+    ALLOC_OTHER,         // thread pool
+    ALLOC_SUBSYSTEMS
+} AllocSubsystem;
+
+typedef struct {
+    long long allocs;    // malloc, calloc, strdup and realloc calls
+    long long frees;
+    long long bytes;     // requested
+} AllocCount;
+
+typedef struct {
+    AllocCount sub[ALLOC_SUBSYSTEMS];
+} AllocSnapshot;
+
+bool alloc_stats_enabled(void);
+const char* alloc_subsystem_name(AllocSubsystem s);
+
+void alloc_stats_snapshot(AllocSnapshot *out);
+
+// after - before, per subsystem; returns the total
+AllocCount alloc_stats_since(const AllocSnapshot *before, const AllocSnapshot *after, AllocSnapshot *delta);
+
+#ifdef ALLOC_STATS
+
+void* alloc_counted_malloc(size_t n, int sub);
+void* alloc_counted_calloc(size_t count, size_t n, int sub);
+void* alloc_counted_realloc(void *p, size_t n, int sub);
+char* alloc_counted_strdup(const char *s, int sub);
+void alloc_counted_free(void *p, int sub);
+
+#ifdef ALLOC_SUBSYSTEM
+#include <stdlib.h>
+#include <string.h>
+#define malloc(n) alloc_counted_malloc((n), ALLOC_SUBSYSTEM)
+#define calloc(c, n) alloc_counted_calloc((c), (n), ALLOC_SUBSYSTEM)
+#define realloc(p, n) alloc_counted_realloc((p), (n), ALLOC_SUBSYSTEM)
+#define strdup(s) alloc_counted_strdup((s), ALLOC_SUBSYSTEM)
+#define free(p) alloc_counted_free((p), ALLOC_SUBSYSTEM)
+#endif
+
+#endif
+
+#endif
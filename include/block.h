@@ -0,0 +1,151 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct BlockMeta;
+struct BlockPool;
+struct Marker;
+
+#define BLOCK_META_TOUCHED 256
+
+typedef struct {
+    int id;
+    int handle;                 // -1 = empty slot
+} BlockIdSlot;
+
+typedef struct {
+    char *text;
+    unsigned gen;               // newest snapshot that may still read it
+} BlockRetired;
+
+typedef struct Block {
+    int id;
+    char *text;
+    int text_cap;               // bytes allocated for text, 0 = strlen + 1
+    int cursor_index;
+    struct Block *next;
+
+    // hot per-block data lives in the document's BlockMeta under handle
+    // (NULL / -1 while the block is in no document)
+    struct BlockMeta *meta;
+    int handle;
+
+    // position markers in the text, sorted by offset (see marker.h)
+    struct Marker *markers;
+    int marker_count;
+    int marker_cap;
+
+    // native file backing (see docfile.h).
+    // lazy blocks keep text == NULL and read from src until first touched.
+    struct BlockPool *pool;     // shared allocation (create_lazy_blocks), NULL = own
+    const char *src;
+    int src_len;                // stored payload length
+    long long file_offset;      // payload offset in the native file (-1 = not stored)
+    unsigned long long hash;    // stored payload hash
+    int line_count;             // cached '\n' count + 1, valid while !dirty
+    bool dirty;                 // changed since last load/save
+    unsigned version;           // bumped by block_touch, caches compare it to spot edits
+
+    // utf-8 check cache (see utf8.h), dropped by block_touch
+    bool utf8_checked;
+    int cp_count;
+    int utf8_errors;            // invalid sequences
+    int utf8_first_error;       // byte offset, -1 = valid
+} Block;
+
+// what passes over the whole document read, as a struct of arrays
+// indexed by block handle, so they scan memory in order instead of
+// chasing Block->next. a block takes a handle when it joins a document
+// and keeps it until it is freed; freed handles are reused.
+typedef struct BlockMeta {
+    Block **block;              // owner, NULL = free handle
+    int *len;                   // text bytes, -1 = count again (edited)
+    int *lines;                 // visual lines, valid under layout_gen
+    int *height;                // pixels, valid under layout_gen
+    unsigned *layout_gen;       // Layout.gen lines / height were measured with, 0 = stale
+    uint64_t **words;           // word start / end bitmaps (words.h), NULL = none yet
+    unsigned *words_version;    // Block.version + 1 they describe, 0 = stale
+    int *sel_start;             // selected range, -1 = none
+    int *sel_len;
+    int sel_lo, sel_hi;         // handles outside [lo, hi) hold no selection
+
+    int count;                  // handles handed out so far (used length)
+    int cap;
+    int *free_handles;
+    int free_count;
+
+    // for indexes over the block order (the editor's view index): shape
+    // changes when a block joins or leaves, reshaped logs which (the
+    // handle of a join, -1 - handle of a leave, in order), touched lists
+    // the handles whose height may have changed (edited or loaded) since
+    // the index last looked. more than BLOCK_META_TOUCHED of either =
+    // look at all.
+    unsigned shape;
+    int reshaped[BLOCK_META_TOUCHED];
+    int reshaped_count;
+    int touched[BLOCK_META_TOUCHED];
+    int touched_count;
+
+    // id -> handle, open addressing with linear probing (power of two
+    // capacity, at most half full). ids are unique, a native file that
+    // repeats one is not opened.
+    BlockIdSlot *ids;
+    int id_cap;
+    int id_count;
+
+    // texts borrowed by snapshots (search_job.h). a text allocated before
+    // the newest live snapshot is shared: block_touch copies it before the
+    // first write and free_block keeps it, both retire the old buffer
+    // until every snapshot that may read it has been released.
+    unsigned *text_gen;         // snap_gen the text was allocated under
+    unsigned snap_gen;
+    unsigned *snaps;            // gens of live snapshots, oldest first
+    int snap_count, snap_cap;
+    BlockRetired *retired;
+    int retired_count, retired_cap;
+
+    // lazy payloads whose bytes did not hash to their stored hash when
+    // loaded (they are kept as read, the next save writes them anew)
+    int damaged;
+} BlockMeta;
+
+// lazy blocks allocated together, freed with the last of them
+typedef struct BlockPool {
+    int live;
+    Block blocks[];
+} BlockPool;
+
+void block_meta_attach(BlockMeta *m, Block *b);   // gives b a handle and indexes its id
+void block_meta_free(BlockMeta *m);
+void block_meta_touched(BlockMeta *m, int handle);    // records a height change
+Block* block_meta_find(const BlockMeta *m, int id);   // NULL if no live block has it
+unsigned block_meta_pin(BlockMeta *m);                // texts stay readable until the unpin
+void block_meta_unpin(BlockMeta *m, unsigned gen);    // frees what only this snapshot still read
+
+Block* create_block(int id, char *text_content);
+Block* create_lazy_block(int id, const char *src, int src_len, int line_count);
+// count lazy blocks in one allocation (a native file's block table), each
+// as create_lazy_block(0, NULL, 0, 1) makes it: fill in id, src, src_len
+// and line_count. freed one by one with free_block as usual.
+Block* create_lazy_blocks(int count);
+void free_block(Block *b);
+
+// text access for lazy blocks
+void block_load(Block *b);   // materialize text from the mapping
+void block_touch(Block *b);  // load + mark dirty, call before any write
+int block_len(const Block *b);
+
+// room for size bytes (nul included), growing geometrically so typing
+// does not reallocate on every character. text must be loaded.
+void block_reserve(Block *b, int size);
+
+// edits in place (touch the block themselves, shift the block's markers)
+void block_insert(Block *b, int at, const char *s, int n);
+void block_erase(Block *b, int at, int n);
+
+// validates & counts codepoints once per edit, results stay on the block
+void block_check_utf8(Block *b);
+
+#endif
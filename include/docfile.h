@@ -0,0 +1,71 @@
+/**
+ * document files
+ * --------------
+ * plain text: blocks are separated by a blank line, CRLF is read as LF
+ * and written back as CRLF when the file's first line ended that way.
+ * the format cannot tell a block boundary from a blank line inside a
+ * block: a block holding "\n\n", or starting or ending with '\n', comes
+ * back split differently after a save and reopen. save as .tdoc to keep
+ * the blocks exactly.
+ *
+ * native (.tdoc): laid out so the block table can be mapped and used
+ * directly, blocks are created lazily (in one allocation) and point into
+ * the mapping. a table with payloads outside the file, repeated or out
+ * of range ids or impossible line counts is not opened; each payload is
+ * checked against its hash when it is first loaded.
+ *
+ *   [header][payloads ...][block table]
+ *
+ * saving appends changed payloads and a fresh table at the end of the
+ * file, syncs them to disk, then rewrites the header. the old table stays valid until the
+ * header flips. dead bytes are reclaimed by a full rewrite once they
+ * outweigh the live ones. integers are stored little endian.
+ */
+
+#ifndef DOCFILE_H
+#define DOCFILE_H
+
+#include <stdint.h>
+#include "document.h"
+
+#define DOCFILE_MAGIC "TXEDOC\0\1"
+#define DOCFILE_VERSION 1
+#define DOCFILE_EXT ".tdoc"
+
+typedef struct DocFile DocFile;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_count;
+    uint32_t id_counter;
+    uint32_t reserved;
+    uint64_t table_offset;
+    uint64_t payload_bytes;  // live payload bytes, for compaction
+    uint64_t file_size;
+    uint64_t reserved2[2];
+} DocFileHeader;             // 64 bytes
+
+typedef struct {
+    uint32_t id;
+    uint32_t line_count;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t hash;           // fnv-1a 64 of the payload, checked on load
+} DocFileEntry;              // 32 bytes
+
+// opens a native or plain text file (picked by magic) into an empty doc
+bool docfile_open(Document *doc, const char *path);
+
+// saves back to the opened path in the format it was opened with
+bool docfile_save(Document *doc);
+
+// saves to a new path, native when it ends in DOCFILE_EXT
+bool docfile_save_as(Document *doc, const char *path);
+
+void docfile_close(Document *doc);
+const char* docfile_path(const Document *doc);
+
+uint64_t docfile_hash(const char *data, size_t len);
+
+#endif
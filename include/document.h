@@ -0,0 +1,36 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include "block.h"
+
+struct DocFile;
+struct MarkerTable;
+
+typedef struct {
+    Block *start;
+    Block *end;
+    int id_counter;
+    BlockMeta meta;      // per-handle tables of the blocks below
+
+    // open file, NULL for a new unsaved document (see docfile.h)
+    struct DocFile *file;
+
+    // bookmarks & other position markers, NULL until the first (see marker.h)
+    struct MarkerTable *markers;
+} Document;
+
+Document* create_document();
+void add_block(Document *doc, char *text);
+void insert_block_after(Document *doc, Block *prev_block, char *text);
+void append_block(Document *doc, Block *new_block);
+Block* find_block(Document *doc, int id);         // O(1) through the id map, NULL if gone
+Block* block_before(Document *doc, Block *b);   // NULL for the first block
+void remove_blocks_after(Document *doc, Block *b, Block *last);
+void free_document(Document *doc);
+
+// editing. each returns the block that ends up holding the cursor.
+Block* split_block(Document *doc, Block *b, int at);    // b[at..] moves to a new block after b
+Block* merge_with_next(Document *doc, Block *b);        // b->next is appended to b and freed
+Block* insert_text(Document *doc, Block *b, const char *text, size_t len);
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * editor state
+ * ------------
+ * what the editor knows besides the document: the focused block, the
+ * selection, layout and view. it changes only through input events
+ * (input.h), and measures text only through the layout callback
+ * (render.h), so the whole editing path runs without a window:
+ * benchmarks and stress tests drive it on a headless box.
+ *
+ * drawing stays with the platform layer, which reads the state back.
+ */
+
+#ifndef EDITOR_STATE_H
+#define EDITOR_STATE_H
+
+#include <stdbool.h>
+#include "document.h"
+#include "selection.h"
+#include "render.h"
+#include "input.h"
+
+// block tops in document order for page / document jumps: a fenwick
+// tree over block height + gap, heights as the draw walk takes them
+// (editor_block_estimate). built on the first jump; after that edits,
+// loads and measurements update single heights.
+//
+// the blocks sit in slots with free ones between them (a packed memory
+// array), so a block joining or leaving does not move the rest: a join
+// takes a free slot next to its neighbours, or spreads out the smallest
+// aligned window around them that has room; a leave frees its slot and
+// spreads out its window once that gets too empty. only a new line
+// height, a document that outgrew (or shrank well below) the slots, or
+// more joins and leaves between two looks than BlockMeta logs rebuild it.
+typedef struct {
+    bool built;
+    Document *doc;           // what it was built over
+    unsigned shape;          // doc->meta.shape then
+    int line_height, pad, gap;   // the layout's then
+    Block **order;           // by slot, NULL = free
+    int *height;             // by slot, gap included, 0 = free
+    int *tree;               // fenwick over the slots, 1-based
+    int slots;               // power of two
+    int count;               // blocks in it
+    int cap;
+    int *pos;                // by handle: slot, -1 = none
+    int pos_cap;
+} ViewIndex;
+
+// line map (layout_line_map) of the block the cursor last moved by lines
+// in, kept until it is edited or the layout changes. a vertical step is
+// then two binary searches.
+typedef struct {
+    Block *block;            // NULL = none
+    int id;
+    unsigned version;        // Block.version then
+    unsigned gen;            // Layout.gen then
+    int count;
+    int cap;
+    int *start;              // by line: byte index of its first glyph
+    float *end_x;            // by line: caret x at its end
+    float *x;                // by byte: caret x before it on its line
+    int x_cap;
+} LineCache;
+
+typedef struct {
+    Document *doc;
+    Block *focus;            // block holding the cursor, NULL = none yet
+    Selection sel;
+    Layout layout;
+
+    // view: blocks stack down from top - scroll_y, text starts at left
+    float scroll_y;
+    int top;
+    int left;
+    int height;              // visible pixels, set by INPUT_RESIZE
+    ViewIndex view;
+    LineCache lines;
+
+    // x that up / down aim for, kept over a run of vertical moves so the
+    // caret comes back to its column past short lines. valid while the
+    // caret is where the last vertical move left it.
+    Block *sticky_block;     // NULL = none, take the caret's x
+    unsigned sticky_version;
+    int sticky_index;
+    float sticky_x;
+
+    // background reflow after the wrap width changed (editor_reflow)
+    unsigned reflow_gen;     // Layout.gen it works towards
+    int reflow_pos;          // next view index position, -1 = done
+
+    double last_action;      // time of the last edit or move (cursor blink)
+    bool follow_cursor;      // the keyboard moved the cursor, scroll it into view
+} EditorState;
+
+void editor_init(EditorState *ed, Document *doc, MeasureFn measure, void *user);
+void editor_free(EditorState *ed);   // what the state allocated, not the document
+
+// applies one event. returns true when the text, cursor or selection changed.
+bool editor_handle(EditorState *ed, const InputEvent *ev);
+
+// narrowest wrap width a resize leaves
+#define EDITOR_MIN_WRAP 100
+
+// bytes editor_reflow measures per frame, about a few ms
+#define EDITOR_REFLOW_BUDGET (1 << 20)
+
+// pixel height of a loaded block, measured once per edit and layout
+// (cached in the document's BlockMeta)
+int editor_block_height(EditorState *ed, Block *b);
+
+// height the view gives a block without measuring it: from the stored
+// line count while it is not loaded, the last measured height while the
+// layout changed since. the draw walk, hit tests and the view index place
+// off-screen blocks by it, and measure only what is on screen.
+int editor_block_estimate(EditorState *ed, Block *b);
+
+// measures, in document order, about budget bytes of the loaded blocks a
+// new wrap width left on their old heights. blocks above the view scroll
+// it by their change, so what is on screen stays put. call once a frame;
+// true while there is more to do.
+bool editor_reflow(EditorState *ed, int budget);
+
+// from the view index, brought up to date: document y of b's top (the
+// first block's is 0), the block covering document y (before the start
+// the first, past the end the last) and its top, and the height of the
+// whole document. heights are the ones the draw walk takes, gap
+// included, so it can start at the first visible block.
+int editor_block_top(EditorState *ed, Block *b);
+Block* editor_block_at(EditorState *ed, int y, int *top);
+int editor_content_height(EditorState *ed);
+
+// the draw walk covers the view and overscan pixels around it only, the
+// focus is measured here wherever it is: above the view, the view
+// scrolls by its new height so the text on screen stays put. a caret the
+// keyboard moved out of the walk's reach is scrolled to, one within it
+// is left to the walk. call before the walk; no focus, no-op.
+void editor_place_focus(EditorState *ed, int overscan);
+
+// block under view position (x, y) and the byte index there, false if none
+bool editor_hit_test(EditorState *ed, float x, float y, Block **b, int *index);
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * frame statistics
+ * ----------------
+ * where a frame's time goes, and how long typed input takes to reach
+ * the screen. the platform layer stamps the phases in order:
+ *
+ *   input     polling the keyboard & mouse (and the find bar)
+ *   edit      editor_handle over the frame's events
+ *   layout    block heights and placement (the walk minus drawing)
+ *   draw      submitting rects & glyphs of the visible blocks and bars
+ *   present   EndDrawing: buffer swap plus the wait for the target fps
+ *
+ * input latency runs from the time an event was polled (InputEvent.time)
+ * to the return of the EndDrawing that shows its effect. raylib polls
+ * at the end of the previous EndDrawing, so time an event spent queued
+ * in the os before that is not seen.
+ *
+ * heap allocations are counted per frame and subsystem (alloc_stats.h,
+ * zero unless built with -DALLOC_STATS).
+ *
+ * the last FRAME_STATS_HISTORY frames are kept for rolling percentiles;
+ * with a csv attached every frame also becomes one row there.
+ */
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "alloc_stats.h"
+
+#define FRAME_STATS_HISTORY 256
+
+typedef enum {
+    PHASE_INPUT,
+    PHASE_EDIT,
+    PHASE_LAYOUT,
+    PHASE_DRAW,
+    PHASE_PRESENT,
+    PHASE_COUNT
+} FramePhase;
+
+typedef struct {
+    double start;
+    double phase[PHASE_COUNT];   // seconds
+    double input_time;           // oldest event of the frame, < 0 = no input
+    int events;
+    int draw_calls;              // rects & glyphs submitted for the text view
+    int glyphs;                  // of them glyphs
+    AllocSnapshot allocs;        // made during the frame, per subsystem
+} FrameSample;
+
+typedef struct {
+    FrameSample frame;           // the one in flight
+    double mark;                 // end of its last stamped phase
+    AllocSnapshot alloc_start;
+
+    FrameSample history[FRAME_STATS_HISTORY];
+    int count, next;
+    double latency[FRAME_STATS_HISTORY];   // of frames with input, seconds
+    int latency_count, latency_next;
+
+    long long frames;
+    FILE *csv;
+} FrameStats;
+
+typedef struct {
+    int frames;                  // in the window
+    int inputs;                  // frames with input in the window
+    double latency_p50, latency_p99;     // ms
+    double phase[PHASE_COUNT];   // ms, mean over the window
+    int draw_calls, glyphs;      // last frame
+    AllocCount allocs;           // last frame
+    const AllocSnapshot *alloc_subsystems;   // last frame, per subsystem
+    int alloc_frames;            // frames that allocated in the window
+} FrameSummary;
+
+void frame_stats_init(FrameStats *s);
+void frame_stats_free(FrameStats *s);   // closes the csv
+
+// one row per frame from now on. false if path cannot be written.
+bool frame_stats_csv(FrameStats *s, const char *path);
+
+void frame_stats_begin(FrameStats *s, double now);
+
+// charges the time since the previous stamp to phase
+void frame_stats_phase(FrameStats *s, FramePhase phase, double now);
+
+// re-charges seconds already stamped to one phase to another
+void frame_stats_move(FrameStats *s, FramePhase from, FramePhase to, double seconds);
+
+// an event polled at `time` is handled this frame
+void frame_stats_event(FrameStats *s, double time);
+
+// closes the frame (stamp PHASE_PRESENT first)
+void frame_stats_end(FrameStats *s, double now);
+
+void frame_stats_summary(const FrameStats *s, FrameSummary *out);
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * glyph cache
+ * -----------
+ * codepoint -> glyph / advance lookup for layout and drawing.
+ * ascii is a flat table, everything else an open-addressing hash map.
+ * the base font comes from LoadFontEx (ascii set); any other codepoint
+ * is rasterized from the ttf on first use into a growing atlas.
+ *
+ * drawing goes straight to DrawTexturePro: raylib's own DrawTextCodepoint
+ * looks glyphs up with a linear scan.
+ */
+
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include "raylib.h"
+
+typedef struct {
+    int codepoint;       // 0 = empty slot
+    bool dynamic;        // lives in the on-demand atlas, not the base font
+    Rectangle src;       // texture rect, padding included
+    Rectangle dst;       // quad relative to the pen position
+    float advance;       // layout width at the cache size
+} Glyph;
+
+typedef struct {
+    float size;          // draw size, glyphs are rasterized at this size
+    Font base;
+    bool owns_base;
+
+    // ttf for on-demand glyphs (NULL: base font only, others draw as '?')
+    unsigned char *font_data;
+    int font_data_size;
+
+    // on-demand atlas (gray + alpha), shelf packed, grows in height
+    Image atlas;
+    Texture2D atlas_texture;
+    int pack_x, pack_y, row_h;
+    int dirty_y0, dirty_y1;  // rows not uploaded yet
+
+    Glyph ascii[128];
+    Glyph *slots;
+    int cap;
+    int count;
+} GlyphCache;
+
+// font_path NULL (or unreadable) falls back to raylib's default font
+void glyph_cache_init(GlyphCache *gc, const char *font_path, float size);
+void glyph_cache_free(GlyphCache *gc);
+
+// first readable font from a few well-known places, or NULL
+const char* glyph_find_font(void);
+
+const Glyph* glyph_lookup(GlyphCache *gc, int codepoint);
+void glyph_draw(GlyphCache *gc, int codepoint, Vector2 pos, Color tint);
+
+static inline float glyph_advance(GlyphCache *gc, int codepoint) {
+    if (codepoint >= 0 && codepoint < 128 && gc->ascii[codepoint].codepoint != 0) {
+        return gc->ascii[codepoint].advance;
+    }
+    return glyph_lookup(gc, codepoint)->advance;
+}
+
+#endif
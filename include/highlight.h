@@ -0,0 +1,40 @@
+/**
+ * search highlights
+ * -----------------
+ * matches of the find bar's query for the blocks the renderer asks about
+ * (the viewport plus some overscan), never the whole document. results
+ * are cached per block until it is edited (Block.version), a block a
+ * crossing match reads is edited, or the query changes. entries not
+ * asked for during a frame are dropped at highlight_end_frame, so the
+ * cache stays the size of the viewport however large the document is.
+ *
+ * a block lists the matches that start in it, in order. a match that
+ * crosses blocks is always the last one and ends in end_block_id.
+ */
+
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include "block.h"
+
+typedef struct {
+    int start;           // byte offset in the block
+    int end_block_id;    // == the block's id unless the match crosses blocks
+    int end;             // byte offset one past the match in end_block_id
+} Highlight;
+
+typedef struct HighlightCache HighlightCache;
+
+HighlightCache* highlight_create(void);
+void highlight_free(HighlightCache *h);
+
+// SEARCH_* flags, len 0 = nothing to highlight. drops every entry.
+void highlight_set_query(HighlightCache *h, const char *needle, int len, int flags);
+
+// matches starting in b (*out is valid until the end of the frame)
+int highlight_block(HighlightCache *h, Block *b, const Highlight **out);
+
+// forgets blocks not asked for since the previous call
+void highlight_end_frame(HighlightCache *h);
+
+#endif
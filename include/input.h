@@ -0,0 +1,77 @@
+/**
+ * input events
+ * ------------
+ * the editor core never polls a keyboard: the platform layer (raylib in
+ * main.c, a trace or a benchmark elsewhere) turns what happened into a
+ * stream of events and feeds them to editor_handle in order. key events
+ * are presses and auto-repeats alike, the platform decides the repeat
+ * rate. times are in seconds on any monotonic clock.
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdlib.h>
+
+typedef enum {
+    INPUT_CHAR,          // typed codepoint
+    INPUT_KEY,           // editing / navigation key, see InputKey
+    INPUT_PASTE,         // text, borrowed until the event is handled
+    INPUT_MOUSE_PRESS,   // left button went down at (x, y)
+    INPUT_MOUSE_DRAG,    // left button held, pointer at (x, y)
+    INPUT_RESIZE,        // the view is now x by y pixels, text wraps to fit
+} InputType;
+
+typedef enum {
+    INPUT_KEY_LEFT,
+    INPUT_KEY_RIGHT,
+    INPUT_KEY_UP,
+    INPUT_KEY_DOWN,
+    INPUT_KEY_BACKSPACE,
+    INPUT_KEY_DELETE,
+    INPUT_KEY_ENTER,
+    INPUT_KEY_HOME,
+    INPUT_KEY_END,
+    INPUT_KEY_PAGE_UP,
+    INPUT_KEY_PAGE_DOWN,
+} InputKey;
+
+// modifier bits. shift extends the selection with movement keys, ctrl
+// makes left / right / backspace / delete go by words and home / end
+// go to the ends of the document.
+#define INPUT_SHIFT 1
+#define INPUT_CTRL  2
+
+typedef struct {
+    InputType type;
+    int key;             // INPUT_KEY
+    int mods;
+    int codepoint;       // INPUT_CHAR
+    float x, y;          // mouse, window coordinates
+    const char *text;    // INPUT_PASTE
+    int text_len;
+    double time;
+} InputEvent;
+
+// events of one frame, in order
+typedef struct {
+    InputEvent *events;
+    int count;
+    int cap;
+} InputQueue;
+
+static inline void input_push(InputQueue *q, InputEvent ev) {
+    if (q->count == q->cap) {
+        q->cap = q->cap ? q->cap * 2 : 16;
+        q->events = (InputEvent*)realloc(q->events, q->cap * sizeof(InputEvent));
+    }
+    q->events[q->count++] = ev;
+}
+
+static inline void input_free(InputQueue *q) {
+    free(q->events);
+    q->events = NULL;
+    q->count = q->cap = 0;
+}
+
+#endif
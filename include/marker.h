@@ -0,0 +1,70 @@
+/**
+ * position markers
+ * ----------------
+ * bookmarks and internal markers (search hits, diagnostics, other
+ * cursors) that stay on their text while it is edited. a block keeps its
+ * markers sorted by byte offset (Block.markers). an edit inside a block
+ * shifts that block's list in one pass; splits, merges, pastes, range
+ * deletions and replacements hand the markers of the text they move to
+ * the block the text ends up in. an edit costs the markers of the blocks
+ * it touches, never all of them.
+ *
+ * markers are named by small ids, resolved through the document's
+ * MarkerTable: id -> block id (find_block) -> that block's list. a marker
+ * inside deleted text lands where the deletion happened, text typed
+ * right at a marker goes after it.
+ */
+
+#ifndef MARKER_H
+#define MARKER_H
+
+#include <stdbool.h>
+#include "document.h"
+
+typedef struct Marker {
+    int id;
+    int offset;          // byte offset in the block
+} Marker;
+
+typedef struct MarkerTable {
+    int *block_id;       // by marker id: block holding it, -1 = free id
+    char **name;         // by marker id: bookmark name, NULL = internal marker
+    int cap;             // ids handed out so far
+    int *free_ids;
+    int free_count;
+} MarkerTable;
+
+// new marker at (b, offset), name NULL for an internal one. returns its id.
+int marker_add(Document *doc, Block *b, int offset, const char *name);
+void marker_remove(Document *doc, int id);
+
+// block and offset of a marker, NULL when it is gone (its block was
+// dropped without handing it on)
+Block* marker_get(Document *doc, int id, int *offset);
+const char* marker_name(Document *doc, int id);
+int marker_find(Document *doc, const char *name);   // id, -1 = no such bookmark
+
+// first named marker after (b, offset) in document order, wrapping around
+bool marker_next_named(Document *doc, Block *b, int offset, Block **out, int *out_offset);
+
+void marker_table_free(MarkerTable *t);
+
+// ----------------------------------------------------------------------------
+// edits (called by the editing code, not by users of markers)
+// ----------------------------------------------------------------------------
+
+// bytes [at, at + removed) of b were replaced by inserted bytes
+void markers_shift(Block *b, int at, int removed, int inserted);
+
+// text of src from byte from up to to (exclusive) moved to dst at dst_at.
+// collapse = that text was replaced, its markers all land on dst_at.
+// src == dst rewrites the offsets in place. dst's own markers must not
+// lie past where the moved ones land.
+void markers_move(Document *doc, Block *src, int from, int to, Block *dst, int dst_at, bool collapse);
+
+// text from (first, at) up to (last, last_at) was replaced by inserted
+// bytes and the rest of last now follows them in first. call while the
+// blocks in between are still linked.
+void markers_join(Document *doc, Block *first, int at, Block *last, int last_at, int inserted);
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * monospace layout
+ * ----------------
+ * with a fixed-advance font every printable ascii glyph is as wide as
+ * the next, so a visual line holds a fixed number of columns
+ * (Layout.mono_cols) and wrapping is division: a run of n glyphs between
+ * two '\n' takes ceil(n / cols) lines. the text is only scanned for its
+ * '\n' and '\t' bytes, 64 at a time by sse2 / avx2 kernels with a scalar
+ * fallback, and column <-> x is a multiplication. tab stops fall on
+ * whole columns too, so a tab moves the pen to the next multiple of
+ * tab_width.
+ *
+ * the scan also looks for bytes the fixed advance does not cover
+ * (controls, DEL, anything non-ascii). a text holding one is not
+ * handled: each function returns false and render.c takes its general,
+ * glyph by glyph path, as it does for every proportional font.
+ */
+
+#ifndef MONO_H
+#define MONO_H
+
+#include <stdbool.h>
+#include "render.h"
+#include "textscan.h"
+
+// the fast path for a text of len bytes under lo: cols > 0 only for
+// fixed-advance fonts, and below one chunk the general loop is as quick
+static inline bool mono_active(const Layout *lo, int len) {
+    return lo->mono_cols > 0 && len >= 64;
+}
+
+// as layout_line_count
+bool mono_line_count(const Layout *lo, const char *text, int len, int *lines);
+bool mono_line_count_with(ScanKernel kernel, const Layout *lo, const char *text, int len, int *lines);
+
+// as layout_caret
+bool mono_caret(const Layout *lo, const char *text, int len, int index, int *line, float *x);
+
+// as layout_hit_test
+bool mono_hit_test(const Layout *lo, const char *text, int len, float x, float y, bool left_margin, int *index);
+
+// as layout_line_map
+bool mono_line_map(const Layout *lo, const char *text, int len, int *starts, float *end_x, float *x, int *lines);
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * profiling markers
+ * -----------------
+ * PROFILE_SCOPE("name") times the rest of the enclosing block (gcc's
+ * cleanup attribute closes it), PROFILE_BEGIN / PROFILE_END a span that
+ * is not a block. zones go into a ring buffer owned by
+ * the calling thread, so recording takes no lock: the owner writes the
+ * slot, then publishes the new head. profile_dump writes every thread's
+ * recent zones as chrome trace-event json (chrome://tracing, perfetto).
+ * the dump copies a ring while its owner may keep writing, and drops
+ * whatever the owner overwrote meanwhile.
+ *
+ * only with -DPROFILE. otherwise the macros are empty and nothing here
+ * is compiled in. names must be string literals (the ring keeps the
+ * pointer).
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+
+#ifdef PROFILE
+
+#define PROFILE_RING_ZONES 65536   // per thread, oldest overwritten
+
+typedef struct {
+    const char *name;
+    unsigned long long start;   // ns
+} ProfileZone;
+
+ProfileZone profile_begin(const char *name);
+void profile_end(ProfileZone *zone);
+
+// false if path cannot be written
+bool profile_dump(const char *path);
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) \
+    ProfileZone PROFILE_JOIN(profile_zone_, __LINE__) __attribute__((cleanup(profile_end))) = profile_begin(name)
+#define PROFILE_BEGIN(zone, name) ProfileZone zone = profile_begin(name)
+#define PROFILE_END(zone) profile_end(&zone)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_BEGIN(zone, name) ((void)0)
+#define PROFILE_END(zone) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * regular expressions
+ * -------------------
+ * line-oriented: a match never contains '\n', ^ and $ are line anchors.
+ * patterns compile to a thompson nfa; no backtracking anywhere.
+ *
+ *   regex_find_line  lazy dfa over the text, finds the next line with a
+ *                    match. states are built on first use and kept in a
+ *                    cache of bounded size (flushed when full). when the
+ *                    pattern starts with a literal, candidates are found
+ *                    with the simd substring kernel first.
+ *   regex_match      pike vm with capture groups, run only on the lines
+ *                    regex_find_line reported. leftmost-first (perl-like)
+ *                    priorities, empty matches are skipped. when a loop
+ *                    body can match empty, groups and match length may
+ *                    differ from perl.
+ *
+ * syntax: . [] [^] \d \w \s \D \W \S, escapes \n \t \\ etc., groups ()
+ * and (?:), |, * + ? {m} {m,} {m,n} and their lazy forms (*? ...).
+ * '.' and negated classes match whole utf-8 sequences; members of []
+ * outside ascii must be single codepoints (no ranges).
+ */
+
+#ifndef REGEX_H
+#define REGEX_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define REGEX_CACHE_BYTES (1 << 20)    // default dfa state budget
+
+typedef struct Regex Regex;            // compiled program, immutable, shareable
+typedef struct RegexCache RegexCache;  // dfa states & vm buffers, one per thread
+
+// NULL on a bad pattern, the reason goes to error
+Regex* regex_compile(const char *pattern, int len, char *error, int error_size);
+void regex_free(Regex *re);
+int regex_group_count(const Regex *re);   // including group 0
+
+// literal every match starts with (*len = 0 if there is none)
+const char* regex_prefix(const Regex *re, int *len);
+
+RegexCache* regex_cache_create(const Regex *re, size_t max_bytes);
+void regex_cache_free(RegexCache *cache);
+
+// next line of text[from..len) containing a match. from must be a line start.
+bool regex_find_line(RegexCache *cache, const char *text, size_t len, size_t from,
+                     size_t *line_start, size_t *line_end);
+
+// first non-empty match in the line [line_start, line_end) starting at or
+// after from. groups gets 2 offsets for each of the first ngroups groups
+// (-1 = group unset or past the pattern's groups), ngroups >= 1.
+bool regex_match(RegexCache *cache, const char *text, size_t line_start, size_t line_end,
+                 size_t from, int *groups, int ngroups);
+
+#endif
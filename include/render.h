@@ -0,0 +1,115 @@
+/**
+ * layout
+ * ------
+ * how block text breaks into visual lines, shared by drawing, hit
+ * testing and cursor movement. glyphs flow left to right and wrap when
+ * the next one would pass max_width; '\n' starts a new line. a caret
+ * sits where the pen is before the glyph it precedes, so at a wrap it
+ * stays at the end of the upper line. a tab takes the pen to the next
+ * tab stop, tab_width spaces apart; one that does not fit wraps to the
+ * first stop of the next line.
+ *
+ * no raylib here: advances come from a measurement callback (the glyph
+ * cache in the app, anything else in benchmarks and tests), ascii ones
+ * are asked once at layout_init.
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+#include "utf8.h"
+
+// advance of one codepoint in pixels
+typedef float (*MeasureFn)(void *user, int codepoint);
+
+typedef struct {
+    MeasureFn measure;
+    void *user;
+    float ascii[128];
+    float max_width;     // wrap width
+    float spacing;       // added after every glyph
+    int line_height;
+    int pad;             // above and below a block's lines
+    int gap;             // between blocks
+    int tab_width;       // spaces between tab stops
+    float mono;          // advance shared by every printable ascii glyph, 0 if they differ
+    int mono_cols;       // glyphs on a full visual line at that advance, 0: no fast path (mono.h)
+    unsigned gen;        // changes with anything above: measurements cached under another gen are stale
+} Layout;
+
+void layout_init(Layout *lo, MeasureFn measure, void *user, float max_width, int line_height);
+
+// call after changing the fields by hand (new gen, monospace columns again)
+void layout_changed(Layout *lo);
+
+static inline float layout_advance(const Layout *lo, int cp) {
+    if (cp >= 0 && cp < 128) return lo->ascii[cp];
+    return lo->measure(lo->user, cp);
+}
+
+// a glyph of advance w fits with the pen at x. the slack absorbs float
+// noise: a pen that reached x by adding advances and one placed on a tab
+// stop or a column by multiplying must wrap at the same glyph.
+static inline bool layout_fits(const Layout *lo, float x, float w) {
+    return x + w <= lo->max_width + 1.0f / 64;
+}
+
+// advance of a tab with the pen at x: up to the next stop that leaves room
+// for the spacing after it. a pen within half a pixel of a stop is on it.
+static inline float layout_tab(const Layout *lo, float x) {
+    float stop = lo->tab_width * (lo->ascii[' '] + lo->spacing);
+    if (stop <= 0) return lo->ascii[' '];
+    float next = ((int)((x + lo->spacing + 0.5f) / stop) + 1) * stop;
+    return next - x - lo->spacing;
+}
+
+// advance of the codepoint at text[i], *n = its length in bytes
+static inline float layout_width_at(const Layout *lo, const char *text, int len, int i, int *n) {
+    unsigned char c = (unsigned char)text[i];
+    if (c < 0x80) { *n = 1; return lo->ascii[c]; }
+    int cp;
+    *n = utf8_decode(&text[i], (size_t)(len - i), &cp);
+    return lo->measure(lo->user, cp);
+}
+
+// visual lines of text (>= 1), and the pixel height of a block with them
+int layout_line_count(const Layout *lo, const char *text, int len);
+
+static inline int layout_height(const Layout *lo, int lines) {
+    return lines * lo->line_height + lo->pad * 2;
+}
+
+// the whole line structure at once, for moving the caret by lines
+// without measuring again: starts[l] = byte index of line l's first glyph,
+// end_x[l] = caret x at its end (both layout_line_count() entries), x[i] =
+// caret x before byte i on its line (len entries, the bytes of a glyph
+// share its x). tabs need no rescan either: a tab's x is where it starts,
+// the next byte's the stop it reaches. returns the line count.
+int layout_line_map(const Layout *lo, const char *text, int len, int *starts, float *end_x, float *x);
+
+// caret position of byte index
+void layout_caret(const Layout *lo, const char *text, int len, int index, int *line, float *x);
+
+// byte index nearest to (x, y), relative to the first line's top left.
+// left_margin: the pointer is left of the text, pick the line start.
+int layout_hit_test(const Layout *lo, const char *text, int len, float x, float y, bool left_margin);
+
+// glyph by glyph, for drawing
+typedef struct {
+    const Layout *lo;
+    const char *text;
+    int len;
+    int i, n;            // the glyph: text[i .. i + n)
+    int cp;
+    int line;            // where it is drawn
+    float x;
+    float w;             // its advance, 0 for '\n', up to the stop for '\t'
+    int next_line;       // the caret after it
+    float next_x;
+} LayoutIter;
+
+void layout_begin(LayoutIter *it, const Layout *lo, const char *text, int len);
+bool layout_next(LayoutIter *it);
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * scratch memory
+ * --------------
+ * a bump allocator for temporaries of the main thread: copies, tails
+ * and spans an edit or a frame needs for a moment. allocating is a
+ * pointer bump; nothing is freed one by one.
+ *
+ * two lifetimes:
+ *   scope   scratch_begin / scratch_end around an edit, everything
+ *           allocated in between goes at scratch_end (scopes nest)
+ *   frame   whatever is left goes at scratch_frame_reset, which the
+ *           platform layer calls at BeginDrawing
+ *
+ * a request that does not fit the current chunk opens a bigger one.
+ * the reset folds the frame's peak back into a single chunk (up to
+ * SCRATCH_RETAIN_BYTES), so a steady frame loop stops calling malloc.
+ * not thread safe: search and index workers allocate for themselves.
+ */
+
+#ifndef SCRATCH_H
+#define SCRATCH_H
+
+#include <stddef.h>
+
+#define SCRATCH_CHUNK_BYTES (64 << 10)      // first chunk
+#define SCRATCH_RETAIN_BYTES (8 << 20)      // kept across frames at most
+
+typedef struct {
+    int chunk;
+    size_t used;
+} ScratchMark;
+
+// 16-byte aligned, never NULL
+void* scratch_alloc(size_t size);
+
+ScratchMark scratch_begin(void);
+void scratch_end(ScratchMark mark);
+
+void scratch_frame_reset(void);
+
+// bytes in use now, and the most since the last reset
+size_t scratch_used(void);
+size_t scratch_peak(void);
+
+// returns every chunk to the heap (exit)
+void scratch_release(void);
+
+#endif
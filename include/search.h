@@ -0,0 +1,79 @@
+/**
+ * find & replace
+ * --------------
+ * substring search over the block list. the byte kernel filters
+ * candidates on the needle's first and last byte, 32 (avx2) or 16 (sse2)
+ * positions per step, and verifies hits with memcmp. (horspool was slower
+ * than the filter even for 200-byte needles on prose, see search_bench.)
+ *
+ * lazy blocks are scanned straight from the mapping, only blocks that
+ * get replaced are loaded. matches may optionally span blocks: the
+ * boundary between two blocks reads as one SEARCH_BLOCK_SEP.
+ *
+ * with SEARCH_REGEX the needle is a pattern (see regex.h). regex matches
+ * stay inside one line of one block; the replacement may refer to groups
+ * as $0..$9 (or \0..\9), $$ is a literal '$'. patterns may have any
+ * number of groups, only the first ten can be referred to.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "document.h"
+#include "textscan.h"
+#include "regex.h"
+
+#define SEARCH_BLOCK_SEP '\n'
+#define SEARCH_REPL_GROUPS 10   // groups a replacement can refer to, $0..$9
+
+// query flags
+#define SEARCH_CROSS_BLOCKS 1   // allow matches across block boundaries
+#define SEARCH_REGEX        2   // needle is a regular expression
+
+typedef struct {
+    char *needle;
+    int len;
+    int flags;
+    bool cross_blocks;
+    Regex *regex;        // SEARCH_REGEX only
+    RegexCache *cache;   // dfa states for the thread that owns the query
+    char error[64];      // why init failed
+} SearchQuery;
+
+typedef struct {
+    Block *block;        // match start
+    int start;           // byte offset (== block length: starts at the boundary)
+    Block *end_block;    // == block unless the match crosses blocks
+    int end;             // byte offset one past the match in end_block
+    int groups[2 * SEARCH_REPL_GROUPS];  // regex captures, offsets in block
+} SearchMatch;
+
+// false on a bad pattern: q->error says why, q matches nothing (free it anyway)
+bool search_query_init(SearchQuery *q, const char *needle, int len, int flags);
+void search_query_free(SearchQuery *q);
+
+// byte kernel: first occurrence of q's needle in hay, or NULL
+const char* search_find(const SearchQuery *q, const char *hay, size_t len);
+const char* search_find_with(ScanKernel kernel, const SearchQuery *q, const char *hay, size_t len);
+
+// first match starting in b at or after from
+bool search_in_block(const SearchQuery *q, Block *b, int from, SearchMatch *out);
+
+// first match at or after (b, from), wrapping around the document end
+bool search_next(Document *doc, const SearchQuery *q, Block *b, int from, SearchMatch *out);
+
+// is m still a match (the text may have changed since it was found)
+bool search_verify(const SearchQuery *q, const SearchMatch *m);
+
+// replaces one match. blocks a crossing match spans are merged into
+// m->block. returns that block with its cursor after the replacement.
+Block* search_replace(Document *doc, const SearchQuery *q, const SearchMatch *m, const char *repl, int repl_len);
+
+// replaces every match, each affected block is rebuilt once.
+// *focus (may be NULL) is moved along if its block gets merged away.
+// returns the number of replacements.
+int search_replace_all(Document *doc, const SearchQuery *q, const char *repl, int repl_len, Block **focus);
+
+#endif
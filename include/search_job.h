@@ -0,0 +1,69 @@
+/**
+ * background search
+ * -----------------
+ * runs a query over a snapshot of the document on the thread pool.
+ * the snapshot pins the texts as they are (loaded blocks lend their
+ * text, lazy blocks keep pointing into the file mapping) and a block
+ * edited while it is pinned gets a copy to write to (see BlockMeta), so
+ * the document can be edited while the scan runs. hits refer to the
+ * snapshot: resolve them by block id and search_verify before touching
+ * the live document.
+ *
+ * the snapshot borrows the document and its file mapping: free the job
+ * before anything that unmaps it (saves that rewrite the file, save-as,
+ * close) and before the document itself.
+ *
+ * the document is cut into chunks of about SEARCH_CHUNK_BYTES; ranges of
+ * chunks are split among workers by work stealing. search_job_poll
+ * publishes finished chunks in document order, so hits stream out in
+ * order while later chunks are still being scanned.
+ *
+ * flags are the SEARCH_* query flags. a bad pattern gives a job that is
+ * done right away with no hits. with a trigram index (may be NULL)
+ * blocks it rules out are never scanned; edited blocks are re-indexed
+ * on the way.
+ */
+
+#ifndef SEARCH_JOB_H
+#define SEARCH_JOB_H
+
+#include <stdbool.h>
+#include "document.h"
+#include "threadpool.h"
+#include "trigram.h"
+
+#define SEARCH_CHUNK_BYTES (1 << 20)
+
+typedef struct {
+    int block_id;        // live block ids
+    int end_block_id;
+    int start;
+    int end;
+    int block_index;     // snapshot positions
+    int end_block_index;
+} SearchHit;
+
+typedef struct {
+    Block *blocks;       // read-only copies linked in document order
+    int count;
+    BlockMeta *meta;     // pinned under gen until search_snapshot_free
+    unsigned gen;
+} SearchSnapshot;
+
+void search_snapshot(Document *doc, SearchSnapshot *snap);
+void search_snapshot_free(SearchSnapshot *snap);
+
+typedef struct SearchJob SearchJob;
+
+SearchJob* search_job_start(ThreadPool *pool, Document *doc, const char *needle, int len, int flags,
+                            TrigramIndex *index);
+
+// publishes finished chunks (main thread). returns the number of hits
+// available through search_job_hits, *done once the whole snapshot is scanned.
+int search_job_poll(SearchJob *job, bool *done);
+const SearchHit* search_job_hits(const SearchJob *job);
+
+// cancels outstanding work and waits for running tasks
+void search_job_free(SearchJob *job);
+
+#endif
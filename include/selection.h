@@ -0,0 +1,35 @@
+/**
+ * selection
+ * ---------
+ * a selection runs from an anchor (where the click or the first shifted
+ * move happened) to the cursor, possibly across blocks. each block's share
+ * of it lives in the document's BlockMeta as sel_start / sel_len under
+ * the block's handle (-1 = not selected), which is what drawing and
+ * deletion read.
+ */
+
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "document.h"
+
+typedef struct {
+    Block *anchor;       // NULL = no selection
+    int anchor_index;
+} Selection;
+
+// anchors at (b, index)
+void selection_begin(Selection *sel, Block *b, int index);
+
+// drops the anchor and every block's range
+void selection_clear(Selection *sel, Document *doc);
+
+// selects anchor .. (current_hover, current_index), either direction
+void update_selection_range(Document *doc, const Selection *sel, Block *current_hover, int current_index);
+
+// deletes the selected range (merging the blocks it spans). returns the
+// surviving block, with the cursor where the range started, or NULL when
+// nothing was selected.
+Block* delete_selected_text(Document *doc);
+
+#endif
@@ -0,0 +1,25 @@
+/**
+ * simd dispatch helpers
+ * ---------------------
+ * kernels are compiled per instruction set with target attributes and
+ * picked once at runtime, so the binary still runs on older cpus.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdbool.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__)
+#define SIMD_X86 1
+#include <immintrin.h>
+// every avx2 cpu also has popcnt and bmi1
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,popcnt,bmi")))
+
+static inline bool simd_has_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * text import scanner
+ * -------------------
+ * turns a raw buffer into block spans in one pass: CRLF is normalized
+ * to LF in place, a blank line ("\n\n") ends a block, and '\n' inside a
+ * block is counted for the block index. avx2 / sse2 kernels with a
+ * scalar fallback; all three produce identical output.
+ */
+
+#ifndef TEXTSCAN_H
+#define TEXTSCAN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+    size_t start;    // offset in the normalized buffer
+    size_t len;
+    int line_count;  // '\n' count + 1
+} TextSpan;
+
+typedef struct {
+    TextSpan *spans;
+    int count;
+    int cap;
+    size_t len;      // normalized buffer length
+} TextSpans;
+
+typedef enum {
+    SCAN_AUTO = 0,
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+} ScanKernel;
+
+// normalizes data[0..len) in place and fills out (always >= 1 span).
+// out must be zeroed or previously used with text_split.
+void text_split(char *data, size_t len, TextSpans *out);
+void text_split_with(ScanKernel kernel, char *data, size_t len, TextSpans *out);
+void text_split_free(TextSpans *out);
+
+const char* text_split_kernel_name(void);
+
+#endif
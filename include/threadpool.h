@@ -0,0 +1,34 @@
+/**
+ * work-stealing thread pool
+ * -------------------------
+ * every worker owns a deque: it pushes and pops its own tasks at the
+ * back (newest first, cache-warm), idle workers steal from the front of
+ * a victim's deque (oldest, usually the biggest piece of a split range).
+ * tasks submitted from outside the pool are dealt out round-robin.
+ *
+ * tasks belong to a TaskGroup, so one job can be waited on (or torn
+ * down) without draining the whole pool.
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stdbool.h>
+
+typedef struct ThreadPool ThreadPool;
+typedef void (*TaskFn)(void *arg);
+
+typedef struct {
+    int pending;   // submitted and not finished, guarded by the pool
+} TaskGroup;
+
+// threads <= 0: one per cpu
+ThreadPool* pool_create(int threads);
+void pool_destroy(ThreadPool *pool);   // finishes queued tasks first
+int pool_size(const ThreadPool *pool);
+
+// safe to call from inside a task (the task is pushed to the caller's own deque)
+void pool_submit(ThreadPool *pool, TaskGroup *group, TaskFn fn, void *arg);
+void pool_wait(ThreadPool *pool, TaskGroup *group);
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * input traces
+ * ------------
+ * records what the editor core is fed, frame by frame, so a session
+ * can be replayed headless and exactly: the events (after the platform
+ * applied key repeat), the view they were handled in, and every glyph
+ * advance the layout asked for (so wrapping, hit tests and vertical
+ * moves come out the same without the font).
+ *
+ * file (native byte order, little endian on everything we build for):
+ *   header   "TEDTRACE" u32 version, u32 blocks, u64 bytes of the
+ *            starting document, layout params, 128 ascii advances,
+ *            i32 tab width (version 3)
+ *   records  u8 tag, then
+ *     'F'    frame: f64 time, f32 scroll_y, i32 height
+ *     'C'    char: u8 mods, varint codepoint
+ *     'K'    key: u8 mods, u8 key
+ *     'P'    paste: u8 mods, varint length, bytes
+ *     'M'    mouse press: f32 x, f32 y
+ *     'D'    mouse drag: f32 x, f32 y
+ *     'R'    resize: f32 width, f32 height (version 2)
+ *     'G'    glyph advance: varint codepoint, f32 advance
+ *     'E'    end: u64 document hash, u32 blocks
+ * events belong to the frame before them and take its time.
+ *
+ * only editor input is recorded (dropped files as the pastes they
+ * become): find & replace is not, a replay of a session that used it
+ * ends on another document.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include "editor_state.h"
+
+#define TRACE_VERSION 3   // reads 1 and 2 too
+
+// fnv-1a over the block texts, for checking that a replay ended where the recording did
+unsigned long long trace_doc_hash(const Document *doc);
+
+// recording
+typedef struct TraceWriter TraceWriter;
+
+// NULL if path cannot be written. ed's layout and view go in the header.
+TraceWriter* trace_write_open(const char *path, const EditorState *ed);
+void trace_frame(TraceWriter *w, double time, float scroll_y, int height);
+void trace_event(TraceWriter *w, const InputEvent *ev);
+void trace_measure(TraceWriter *w, int codepoint, float advance);   // once per codepoint
+void trace_write_close(TraceWriter *w, const Document *doc);
+
+// replay
+typedef struct {
+    double time;
+    float scroll_y;
+    int height;
+} TraceFrame;
+
+typedef struct TraceReader TraceReader;
+
+// NULL (and *error set) when the file is missing or not a trace
+TraceReader* trace_read_open(const char *path, const char **error);
+
+// starting document shape
+void trace_read_doc_info(const TraceReader *r, unsigned *blocks, unsigned long long *bytes);
+
+// editor_init on doc with the recorded layout and view, measuring from
+// the recorded advances
+void trace_read_init(TraceReader *r, EditorState *ed, Document *doc);
+
+// the next frame and its events (q is cleared first). false at the end.
+bool trace_read_frame(TraceReader *r, TraceFrame *frame, InputQueue *q);
+
+// 'E' record, false if the recording was cut short
+bool trace_read_end(const TraceReader *r, unsigned long long *hash, unsigned *blocks);
+
+void trace_read_close(TraceReader *r);
+
+#endif
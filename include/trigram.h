@@ -0,0 +1,70 @@
+/**
+ * trigram index
+ * -------------
+ * optional posting index for search in very large documents: for every
+ * hashed trigram, the ids of the blocks containing it. a query takes the
+ * trigrams of a literal every match must contain (the needle, or the
+ * literal prefix of a regex), intersects their postings and only the
+ * surviving blocks are scanned.
+ *
+ * postings remember which text they describe: block_touch bumps
+ * Block.version, and a block whose version differs from the indexed one
+ * is always a candidate. such blocks are re-indexed one by one when a
+ * search next walks over them (or all at once by trigram_index_sync),
+ * so the cost follows the edits. stale
+ * postings of edited or deleted blocks are left behind as false
+ * positives; once they outweigh the live ones the index asks for a
+ * rebuild.
+ *
+ * postings are varint-coded id deltas. the memory budget caps buckets
+ * plus postings; blocks that no longer fit stay unindexed and are simply
+ * always scanned.
+ *
+ * the initial build runs on the thread pool over a SearchSnapshot (so it
+ * pins the texts and borrows the file mapping like a search job does).
+ */
+
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "document.h"
+#include "search.h"
+#include "threadpool.h"
+
+#define TRIGRAM_INDEX_BYTES ((size_t)64 << 20)   // default budget
+#define TRIGRAM_MAX_QUERY 8                      // rarest trigrams intersected per query
+
+typedef struct TrigramIndex TrigramIndex;
+
+TrigramIndex* trigram_index_create(size_t max_bytes);
+void trigram_index_free(TrigramIndex *ix);
+size_t trigram_index_bytes(const TrigramIndex *ix);
+
+// (re)indexes one block's text as of its current version
+void trigram_index_add(TrigramIndex *ix, const Block *b);
+
+// postings describe b's current text
+bool trigram_index_current(const TrigramIndex *ix, const Block *b);
+
+// re-indexes every block edited since it was indexed, returns how many
+int trigram_index_sync(TrigramIndex *ix, Document *doc);
+
+// stale postings outweigh live ones
+bool trigram_index_wants_rebuild(const TrigramIndex *ix);
+
+// candidate blocks for q. NULL when the index cannot narrow q (no
+// required literal of 3+ bytes, or matches that may cross blocks).
+typedef struct TrigramFilter TrigramFilter;
+TrigramFilter* trigram_filter(TrigramIndex *ix, const SearchQuery *q);
+bool trigram_filter_has(const TrigramFilter *f, const Block *b);
+void trigram_filter_free(TrigramFilter *f);
+
+// background build
+typedef struct TrigramJob TrigramJob;
+TrigramJob* trigram_job_start(ThreadPool *pool, Document *doc, size_t max_bytes);
+TrigramIndex* trigram_job_take(TrigramJob *job);   // the index once built (then owned by the caller), else NULL
+void trigram_job_free(TrigramJob *job);            // cancels and waits
+
+#endif
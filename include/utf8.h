@@ -0,0 +1,86 @@
+/**
+ * utf-8 validation & counting
+ * ---------------------------
+ * avx2 kernel after the keiser-lemire lookup validator (three nibble
+ * tables classify each byte pair, one pass, no branches per byte), an
+ * sse2 kernel that skips ascii runs 16 bytes at a time, and a scalar
+ * decoder that also serves as the reference and the error reporter.
+ *
+ * invalid input is never rejected: each maximal ill-formed subpart
+ * counts (and later draws) as one U+FFFD.
+ */
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define UTF8_REPLACEMENT 0xFFFD
+
+typedef struct {
+    size_t codepoints;
+    size_t error_count;
+    size_t first_error;  // byte offset, only meaningful if error_count > 0
+} Utf8Info;
+
+bool utf8_validate(const char *data, size_t len);
+size_t utf8_count(const char *data, size_t len);
+
+// validates and counts in one go. offsets of up to max_errors invalid
+// sequences are written to errors (may be NULL).
+Utf8Info utf8_check(const char *data, size_t len, size_t *errors, size_t max_errors);
+
+// decodes one codepoint at s (len > 0 bytes available).
+// returns bytes consumed (>= 1), *cp = UTF8_REPLACEMENT on bad input.
+static inline int utf8_decode(const char *s, size_t len, int *cp) {
+    const unsigned char *u = (const unsigned char*)s;
+    unsigned char c = u[0];
+    if (c < 0x80) { *cp = c; return 1; }
+
+    int need;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF)      { need = 1; *cp = c & 0x1F; }
+    else if (c >= 0xE0 && c <= 0xEF) { need = 2; *cp = c & 0x0F; if (c == 0xE0) lo = 0xA0; if (c == 0xED) hi = 0x9F; }
+    else if (c >= 0xF0 && c <= 0xF4) { need = 3; *cp = c & 0x07; if (c == 0xF0) lo = 0x90; if (c == 0xF4) hi = 0x8F; }
+    else { *cp = UTF8_REPLACEMENT; return 1; }
+
+    // the first continuation has a tighter range (overlongs, surrogates, > U+10FFFF)
+    for (int i = 1; i <= need; i++) {
+        if ((size_t)i >= len || u[i] < lo || u[i] > hi) { *cp = UTF8_REPLACEMENT; return i; }
+        *cp = (*cp << 6) | (u[i] & 0x3F);
+        lo = 0x80; hi = 0xBF;
+    }
+    return need + 1;
+}
+
+// length of the codepoint ending right before s[i] (i > 0).
+// steps back over at most 3 continuation bytes; a stray continuation
+// is treated as its own (invalid) codepoint, matching utf8_decode.
+static inline int utf8_prev_len(const char *s, int i) {
+    int start = i - 1;
+    while (start > 0 && i - start < 4 && ((unsigned char)s[start] & 0xC0) == 0x80) start--;
+    int cp;
+    int n = utf8_decode(&s[start], (size_t)(i - start), &cp);
+    return (start + n == i) ? n : 1;
+}
+
+// writes cp to out (room for 4 bytes), returns bytes written
+static inline int utf8_encode(int cp, char *out) {
+    if (cp < 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) cp = UTF8_REPLACEMENT;
+    if (cp < 0x80)    { out[0] = (char)cp; return 1; }
+    if (cp < 0x800)   { out[0] = (char)(0xC0 | (cp >> 6)); out[1] = (char)(0x80 | (cp & 0x3F)); return 2; }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+#endif
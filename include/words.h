@@ -0,0 +1,45 @@
+/**
+ * word boundaries
+ * ---------------
+ * stops for ctrl+arrow and ctrl+backspace / delete. bytes fall in three
+ * classes: word (letters, digits, '_' and every non-ascii byte, so a
+ * utf-8 sequence is never split), blank (space, tab, '\n', '\r') and
+ * punctuation (the rest). a run of word or punctuation bytes starts
+ * where its class begins and ends where it stops.
+ *
+ * the starts and ends of a text are two bitmaps with one bit per caret
+ * position (len + 1 of them), classified 64 bytes at a time by sse2 /
+ * avx2 kernels with a scalar fallback. a block's bitmaps are cached in
+ * its BlockMeta next to the layout measurements until it is edited, so
+ * a jump is a few bit scans however long the block is.
+ */
+
+#ifndef WORDS_H
+#define WORDS_H
+
+#include <stdint.h>
+#include "block.h"
+#include "textscan.h"
+
+typedef struct {
+    const uint64_t *starts;  // bit i: a word or punctuation run starts at byte i
+    const uint64_t *ends;    // bit i: one ends right before byte i
+    int len;
+} WordBits;
+
+// uint64_t words per bitmap of a text of len bytes
+static inline int word_bits_words(int len) {
+    return len / 64 + 1;
+}
+
+// fills both bitmaps (word_bits_words(len) words each)
+void word_bounds(const char *text, int len, uint64_t *starts, uint64_t *ends);
+void word_bounds_with(ScanKernel kernel, const char *text, int len, uint64_t *starts, uint64_t *ends);
+
+// bitmaps of a block in a document, built on first use after an edit
+WordBits block_words(Block *b);
+
+int word_prev_start(const WordBits *w, int index);   // last start before index, 0 if none
+int word_next_end(const WordBits *w, int index);     // first end after index, len if none
+
+#endif
@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/alloc_stats.h"
+
+static AllocCount counts[ALLOC_SUBSYSTEMS];
+
+static const char *NAMES[ALLOC_SUBSYSTEMS] = {
+    "document", "edit", "file", "search", "index", "glyphs", "ui", "other",
+};
+
+bool alloc_stats_enabled(void) {
+#ifdef ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* alloc_subsystem_name(AllocSubsystem s) {
+    return NAMES[s];
+}
+
+void alloc_stats_snapshot(AllocSnapshot *out) {
+    for (int i = 0; i < ALLOC_SUBSYSTEMS; i++) {
+        out->sub[i].allocs = __atomic_load_n(&counts[i].allocs, __ATOMIC_RELAXED);
+        out->sub[i].frees = __atomic_load_n(&counts[i].frees, __ATOMIC_RELAXED);
+        out->sub[i].bytes = __atomic_load_n(&counts[i].bytes, __ATOMIC_RELAXED);
+    }
+}
+
+AllocCount alloc_stats_since(const AllocSnapshot *before, const AllocSnapshot *after, AllocSnapshot *delta) {
+    AllocCount total = { 0 };
+    for (int i = 0; i < ALLOC_SUBSYSTEMS; i++) {
+        AllocCount d = {
+            after->sub[i].allocs - before->sub[i].allocs,
+            after->sub[i].frees - before->sub[i].frees,
+            after->sub[i].bytes - before->sub[i].bytes,
+        };
+        if (delta != NULL) delta->sub[i] = d;
+        total.allocs += d.allocs;
+        total.frees += d.frees;
+        total.bytes += d.bytes;
+    }
+    return total;
+}
+
+#ifdef ALLOC_STATS
+
+static void count(int sub, size_t bytes) {
+    __atomic_add_fetch(&counts[sub].allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counts[sub].bytes, (long long)bytes, __ATOMIC_RELAXED);
+}
+
+void* alloc_counted_malloc(size_t n, int sub) {
+    count(sub, n);
+    return malloc(n);
+}
+
+void* alloc_counted_calloc(size_t c, size_t n, int sub) {
+    count(sub, c * n);
+    return calloc(c, n);
+}
+
+// realloc(NULL, n) allocates, realloc(p, 0) may free: both count as such
+void* alloc_counted_realloc(void *p, size_t n, int sub) {
+    if (n > 0) count(sub, n);
+    else if (p != NULL) __atomic_add_fetch(&counts[sub].frees, 1, __ATOMIC_RELAXED);
+    return realloc(p, n);
+}
+
+char* alloc_counted_strdup(const char *s, int sub) {
+    count(sub, strlen(s) + 1);
+    return strdup(s);
+}
+
+void alloc_counted_free(void *p, int sub) {
+    if (p != NULL) __atomic_add_fetch(&counts[sub].frees, 1, __ATOMIC_RELAXED);
+    free(p);
+}
+
+#endif
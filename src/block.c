@@ -0,0 +1,364 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/block.h"
+#include "include/docfile.h"
+#include "include/utf8.h"
+#include "include/marker.h"
+#define ALLOC_SUBSYSTEM ALLOC_DOCUMENT
+#include "include/alloc_stats.h"
+
+Block* create_block(int id, char *text_content) {
+    Block *new_block = (Block*)malloc(sizeof(Block));
+    new_block->id = id;
+    new_block->text = strdup(text_content);
+    new_block->text_cap = strlen(text_content) + 1;
+    new_block->next = NULL;
+    new_block->cursor_index = strlen(text_content);
+    new_block->meta = NULL;
+    new_block->handle = -1;
+    new_block->markers = NULL;
+    new_block->marker_count = 0;
+    new_block->marker_cap = 0;
+    new_block->pool = NULL;
+    new_block->src = NULL;
+    new_block->src_len = 0;
+    new_block->file_offset = -1;
+    new_block->hash = 0;
+    new_block->line_count = 1;
+    new_block->dirty = true;
+    new_block->version = 0;
+    new_block->utf8_checked = false;
+    return new_block;
+}
+
+static void lazy_init(Block *b, int id, const char *src, int src_len, int line_count) {
+    b->id = id;
+    b->text = NULL;
+    b->text_cap = 0;
+    b->next = NULL;
+    b->cursor_index = 0;
+    b->meta = NULL;
+    b->handle = -1;
+    b->markers = NULL;
+    b->marker_count = 0;
+    b->marker_cap = 0;
+    b->pool = NULL;
+    b->src = src;
+    b->src_len = src_len;
+    b->file_offset = -1;
+    b->hash = 0;
+    b->line_count = line_count;
+    b->dirty = false;
+    b->version = 0;
+    b->utf8_checked = false;
+}
+
+// block backed by a payload in a mapped file. no copy until block_load.
+Block* create_lazy_block(int id, const char *src, int src_len, int line_count) {
+    Block *new_block = (Block*)malloc(sizeof(Block));
+    lazy_init(new_block, id, src, src_len, line_count);
+    return new_block;
+}
+
+Block* create_lazy_blocks(int count) {
+    BlockPool *pool = (BlockPool*)malloc(sizeof(BlockPool) + (size_t)count * sizeof(Block));
+    pool->live = count;
+    for (int i = 0; i < count; i++) {
+        lazy_init(&pool->blocks[i], 0, NULL, 0, 1);
+        pool->blocks[i].pool = pool;
+    }
+    return pool->blocks;
+}
+
+static void id_remove(BlockMeta *m, const Block *b);
+
+static void reshaped(BlockMeta *m, int entry) {
+    if (m->reshaped_count < BLOCK_META_TOUCHED) m->reshaped[m->reshaped_count] = entry;
+    if (m->reshaped_count <= BLOCK_META_TOUCHED) m->reshaped_count++;
+    m->shape++;
+}
+
+// the text is borrowed by a live snapshot
+static bool text_shared(const Block *b) {
+    const BlockMeta *m = b->meta;
+    return m != NULL && b->text != NULL && m->snap_count > 0
+        && m->text_gen[b->handle] < m->snaps[m->snap_count - 1];
+}
+
+static void text_retire(BlockMeta *m, char *text) {
+    if (m->retired_count == m->retired_cap) {
+        m->retired_cap = m->retired_cap ? m->retired_cap * 2 : 64;
+        m->retired = (BlockRetired*)realloc(m->retired, m->retired_cap * sizeof(BlockRetired));
+    }
+    m->retired[m->retired_count++] = (BlockRetired){ text, m->snaps[m->snap_count - 1] };
+}
+
+void free_block(Block *b) {
+    BlockMeta *m = b->meta;
+    if (text_shared(b)) {
+        text_retire(m, b->text);
+        b->text = NULL;
+    }
+    if (m != NULL) {
+        int h = b->handle;
+        id_remove(m, b);
+        m->block[h] = NULL;
+        m->sel_start[h] = -1;
+        free(m->words[h]);
+        m->words[h] = NULL;
+        m->free_handles[m->free_count++] = h;
+        reshaped(m, -1 - h);
+    }
+    free(b->markers);
+    free(b->text);
+    if (b->pool == NULL) free(b);
+    else if (--b->pool->live == 0) free(b->pool);
+}
+
+void block_load(Block *b) {
+    if (b->text != NULL) return;
+    b->text = (char*)malloc(b->src_len + 1);
+    b->text_cap = b->src_len + 1;
+    memcpy(b->text, b->src, b->src_len);
+    b->text[b->src_len] = '\0';
+    b->src = NULL;
+    // first read of a stored payload: check it against the table. a
+    // damaged one is kept as read but not trusted as stored any more
+    if (b->file_offset >= 0 && docfile_hash(b->text, b->src_len) != b->hash) {
+        b->file_offset = -1;
+        b->dirty = true;
+        if (b->meta != NULL) b->meta->damaged++;
+    }
+    if (b->meta != NULL) b->meta->text_gen[b->handle] = b->meta->snap_gen;
+    block_check_utf8(b);
+    // measured from now on instead of estimated from line_count
+    if (b->meta != NULL) block_meta_touched(b->meta, b->handle);
+}
+
+void block_touch(Block *b) {
+    block_load(b);
+    if (text_shared(b)) {
+        // snapshots keep reading the old text, the edit goes to a copy
+        BlockMeta *m = b->meta;
+        int len = block_len(b);
+        int cap = (b->text_cap > len) ? b->text_cap : len + 1;
+        char *copy = (char*)malloc(cap);
+        memcpy(copy, b->text, len + 1);
+        text_retire(m, b->text);
+        b->text = copy;
+        b->text_cap = cap;
+        m->text_gen[b->handle] = m->snap_gen;
+    }
+    b->dirty = true;
+    b->version++;
+    b->utf8_checked = false;
+    if (b->meta != NULL) {
+        b->meta->len[b->handle] = -1;
+        b->meta->layout_gen[b->handle] = 0;
+        block_meta_touched(b->meta, b->handle);
+    }
+}
+
+int block_len(const Block *b) {
+    if (b->text == NULL) return b->src_len;
+    if (b->meta == NULL) return strlen(b->text);
+    int *len = &b->meta->len[b->handle];
+    if (*len < 0) *len = strlen(b->text);
+    return *len;
+}
+
+void block_reserve(Block *b, int size) {
+    int cap = b->text_cap ? b->text_cap : (int)strlen(b->text) + 1;
+    if (size <= cap) return;
+    int grown = cap + cap / 2;
+    if (grown < 16) grown = 16;
+    if (grown < size) grown = size;
+    b->text = (char*)realloc(b->text, grown);
+    b->text_cap = grown;
+}
+
+void block_insert(Block *b, int at, const char *s, int n) {
+    int len = block_len(b);   // still cached, block_touch drops it
+    block_touch(b);
+    block_reserve(b, len + n + 1);
+    memmove(&b->text[at + n], &b->text[at], len - at + 1);
+    memcpy(&b->text[at], s, n);
+    if (b->meta != NULL) b->meta->len[b->handle] = len + n;
+    if (b->marker_count > 0) markers_shift(b, at, 0, n);
+}
+
+void block_erase(Block *b, int at, int n) {
+    int len = block_len(b);
+    block_touch(b);
+    if (at + n > len) n = len - at;
+    memmove(&b->text[at], &b->text[at + n], len - at - n + 1);
+    if (b->meta != NULL) b->meta->len[b->handle] = len - n;
+    if (b->marker_count > 0) markers_shift(b, at, n, 0);
+}
+
+void block_check_utf8(Block *b) {
+    if (b->utf8_checked) return;
+    const char *text = b->text ? b->text : b->src;
+    Utf8Info info = utf8_check(text, block_len(b), NULL, 0);
+    b->cp_count = (int)info.codepoints;
+    b->utf8_errors = (int)info.error_count;
+    b->utf8_first_error = info.error_count ? (int)info.first_error : -1;
+    b->utf8_checked = true;
+}
+
+// ----------------------------------------------------------------------------
+// metadata
+// ----------------------------------------------------------------------------
+
+static void meta_grow(BlockMeta *m) {
+    int cap = m->cap ? m->cap * 2 : 1024;
+    m->block = (Block**)realloc(m->block, cap * sizeof(Block*));
+    m->len = (int*)realloc(m->len, cap * sizeof(int));
+    m->lines = (int*)realloc(m->lines, cap * sizeof(int));
+    m->height = (int*)realloc(m->height, cap * sizeof(int));
+    m->layout_gen = (unsigned*)realloc(m->layout_gen, cap * sizeof(unsigned));
+    m->words = (uint64_t**)realloc(m->words, cap * sizeof(uint64_t*));
+    m->words_version = (unsigned*)realloc(m->words_version, cap * sizeof(unsigned));
+    m->sel_start = (int*)realloc(m->sel_start, cap * sizeof(int));
+    m->sel_len = (int*)realloc(m->sel_len, cap * sizeof(int));
+    m->free_handles = (int*)realloc(m->free_handles, cap * sizeof(int));
+    m->text_gen = (unsigned*)realloc(m->text_gen, cap * sizeof(unsigned));
+    m->cap = cap;
+}
+
+static inline unsigned id_home(const BlockMeta *m, int id) {
+    return ((unsigned)id * 2654435761u) & (m->id_cap - 1);
+}
+
+static void id_put(BlockMeta *m, int id, int handle) {
+    if ((m->id_count + 1) * 2 > m->id_cap) {
+        BlockIdSlot *old = m->ids;
+        int old_cap = m->id_cap;
+        m->id_cap = old_cap ? old_cap * 2 : 1024;
+        m->ids = (BlockIdSlot*)malloc(m->id_cap * sizeof(BlockIdSlot));
+        for (int i = 0; i < m->id_cap; i++) m->ids[i].handle = -1;
+        m->id_count = 0;
+        for (int i = 0; i < old_cap; i++) {
+            if (old[i].handle != -1) id_put(m, old[i].id, old[i].handle);
+        }
+        free(old);
+    }
+    unsigned mask = m->id_cap - 1;
+    unsigned i = id_home(m, id);
+    while (m->ids[i].handle != -1 && m->ids[i].id != id) i = (i + 1) & mask;
+    if (m->ids[i].handle == -1) m->id_count++;
+    m->ids[i] = (BlockIdSlot){ id, handle };
+}
+
+// backward-shift deletion: later entries of the probe run move up into
+// the hole, so lookups never need tombstones
+static void id_remove(BlockMeta *m, const Block *b) {
+    if (m->id_cap == 0) return;
+    unsigned mask = m->id_cap - 1;
+    unsigned i = id_home(m, b->id);
+    while (m->ids[i].handle != -1 && m->ids[i].id != b->id) i = (i + 1) & mask;
+    // absent, or a later block with the same id took the slot
+    if (m->ids[i].handle != b->handle) return;
+
+    unsigned j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (m->ids[j].handle == -1) break;
+        unsigned k = id_home(m, m->ids[j].id);
+        // leave entries whose home lies cyclically in (i, j]
+        bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays) continue;
+        m->ids[i] = m->ids[j];
+        i = j;
+    }
+    m->ids[i].handle = -1;
+    m->id_count--;
+}
+
+void block_meta_touched(BlockMeta *m, int handle) {
+    // typing touches the same block over and over
+    if (m->touched_count > 0 && m->touched_count <= BLOCK_META_TOUCHED && m->touched[m->touched_count - 1] == handle) return;
+    if (m->touched_count < BLOCK_META_TOUCHED) m->touched[m->touched_count] = handle;
+    // past the list it only counts, so readers know they missed some
+    if (m->touched_count <= BLOCK_META_TOUCHED) m->touched_count++;
+}
+
+Block* block_meta_find(const BlockMeta *m, int id) {
+    if (m->id_cap == 0) return NULL;
+    unsigned mask = m->id_cap - 1;
+    unsigned i = id_home(m, id);
+    while (m->ids[i].handle != -1) {
+        if (m->ids[i].id == id) return m->block[m->ids[i].handle];
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+void block_meta_attach(BlockMeta *m, Block *b) {
+    int h;
+    if (m->free_count > 0) {
+        h = m->free_handles[--m->free_count];
+    } else {
+        if (m->count == m->cap) meta_grow(m);
+        h = m->count++;
+    }
+    b->meta = m;
+    b->handle = h;
+    m->block[h] = b;
+    m->len[h] = (b->text != NULL) ? -1 : b->src_len;
+    m->lines[h] = 0;
+    m->height[h] = 0;
+    m->layout_gen[h] = 0;
+    m->words[h] = NULL;
+    m->words_version[h] = 0;
+    m->sel_start[h] = -1;
+    m->sel_len[h] = 0;
+    m->text_gen[h] = m->snap_gen;
+    reshaped(m, h);
+    id_put(m, b->id, h);
+}
+
+unsigned block_meta_pin(BlockMeta *m) {
+    if (m->snap_count == m->snap_cap) {
+        m->snap_cap = m->snap_cap ? m->snap_cap * 2 : 4;
+        m->snaps = (unsigned*)realloc(m->snaps, m->snap_cap * sizeof(unsigned));
+    }
+    m->snaps[m->snap_count++] = ++m->snap_gen;
+    return m->snap_gen;
+}
+
+void block_meta_unpin(BlockMeta *m, unsigned gen) {
+    int i = 0;
+    while (i < m->snap_count && m->snaps[i] != gen) i++;
+    if (i == m->snap_count) return;
+    memmove(&m->snaps[i], &m->snaps[i + 1], (m->snap_count - i - 1) * sizeof(unsigned));
+    m->snap_count--;
+
+    // a text retired under gen r is read by snapshots up to r
+    int kept = 0;
+    for (int k = 0; k < m->retired_count; k++) {
+        BlockRetired *r = &m->retired[k];
+        if (m->snap_count > 0 && m->snaps[0] <= r->gen) m->retired[kept++] = *r;
+        else free(r->text);
+    }
+    m->retired_count = kept;
+}
+
+void block_meta_free(BlockMeta *m) {
+    for (int k = 0; k < m->retired_count; k++) free(m->retired[k].text);
+    free(m->retired);
+    free(m->snaps);
+    free(m->text_gen);
+    free(m->block);
+    free(m->len);
+    free(m->lines);
+    free(m->height);
+    free(m->layout_gen);
+    free(m->words);
+    free(m->words_version);
+    free(m->sel_start);
+    free(m->sel_len);
+    free(m->free_handles);
+    free(m->ids);
+    memset(m, 0, sizeof(BlockMeta));
+}
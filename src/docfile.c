@@ -0,0 +1,511 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "include/docfile.h"
+#include "include/textscan.h"
+#include "include/profile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#define file_seek _fseeki64
+#define file_tell _ftelli64
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define file_seek fseeko
+#define file_tell ftello
+#endif
+
+#define ALLOC_SUBSYSTEM ALLOC_FILE
+#include "include/alloc_stats.h"
+
+struct DocFile {
+    char *path;
+    bool native;
+    bool trailing_newline;   // plain text: file ended with '\n'
+    bool crlf;               // plain text: lines end in "\r\n", written back that way
+
+    // read-only view of the native file, lazy blocks point into it
+    const char *map;
+    size_t map_size;
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE map_handle;
+#endif
+
+    uint64_t file_size;      // append position for incremental saves
+    uint64_t payload_bytes;  // live payload bytes after the last save
+};
+
+// ============================================================================
+// helpers
+// ============================================================================
+
+uint64_t docfile_hash(const char *data, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int count_lines(const char *text, size_t len) {
+    int lines = 1;
+    for (size_t i = 0; i < len; i++) if (text[i] == '\n') lines++;
+    return lines;
+}
+
+static bool map_file(DocFile *f) {
+#ifdef _WIN32
+    HANDLE h = CreateFileA(f->path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(h, &size) || size.QuadPart == 0) { CloseHandle(h); return false; }
+
+    HANDLE m = CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m == NULL) { CloseHandle(h); return false; }
+
+    void *view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) { CloseHandle(m); CloseHandle(h); return false; }
+
+    f->file_handle = h;
+    f->map_handle = m;
+    f->map = (const char*)view;
+    f->map_size = (size_t)size.QuadPart;
+#else
+    int fd = open(f->path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return false; }
+
+    void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+
+    f->map = (const char*)view;
+    f->map_size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+static void unmap_file(DocFile *f) {
+    if (f->map == NULL) return;
+#ifdef _WIN32
+    UnmapViewOfFile(f->map);
+    CloseHandle(f->map_handle);
+    CloseHandle(f->file_handle);
+#else
+    munmap((void*)f->map, f->map_size);
+#endif
+    f->map = NULL;
+    f->map_size = 0;
+}
+
+// lazy blocks must own their text before the mapping goes away
+static void load_all(Document *doc) {
+    for (Block *b = doc->start; b; b = b->next) block_load(b);
+}
+
+// everything written so far is on disk, not just in the os cache, before
+// anything that points at it (a header, a rename) is written
+static bool sync_file(FILE *out) {
+    if (fflush(out) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(out)) == 0;
+#else
+    return fsync(fileno(out)) == 0;
+#endif
+}
+
+static bool replace_file(const char *tmp, const char *path) {
+#ifdef _WIN32
+    remove(path); // rename does not overwrite on windows
+#endif
+    if (rename(tmp, path) != 0) { remove(tmp); return false; }
+    return true;
+}
+
+static char* tmp_path(const char *path) {
+    char *tmp = (char*)malloc(strlen(path) + 5);
+    sprintf(tmp, "%s.tmp", path);
+    return tmp;
+}
+
+static bool has_native_ext(const char *path) {
+    size_t len = strlen(path), ext = strlen(DOCFILE_EXT);
+    return len >= ext && strcmp(path + len - ext, DOCFILE_EXT) == 0;
+}
+
+// ============================================================================
+// plain text
+// ============================================================================
+
+static bool open_text(Document *doc, DocFile *f) {
+    FILE *in = fopen(f->path, "rb");
+    if (in == NULL) return false;
+
+    file_seek(in, 0, SEEK_END);
+    long long size = file_tell(in);
+    file_seek(in, 0, SEEK_SET);
+    if (size < 0) { fclose(in); return false; }
+
+    char *data = (char*)malloc((size_t)size + 1);
+    size_t len = fread(data, 1, (size_t)size, in);
+    fclose(in);
+
+    // the first line ending decides how every one is written back
+    const char *nl = (const char*)memchr(data, '\n', len);
+    f->crlf = (nl != NULL && nl > data && nl[-1] == '\r');
+
+    // one final newline belongs to the file, not to the last block
+    f->trailing_newline = (len > 0 && data[len - 1] == '\n');
+    if (f->trailing_newline) len -= (len > 1 && data[len - 2] == '\r') ? 2 : 1;
+
+    TextSpans split = {0};
+    text_split(data, len, &split);
+    for (int i = 0; i < split.count; i++) {
+        TextSpan *span = &split.spans[i];
+        data[span->start + span->len] = '\0'; // separator or end of buffer
+        add_block(doc, &data[span->start]);
+        doc->end->line_count = span->line_count;
+        block_check_utf8(doc->end);
+    }
+    text_split_free(&split);
+
+    free(data);
+    return true;
+}
+
+// text with its '\n' written as the file's line ending
+static bool write_lines(FILE *out, const char *text, size_t len, bool crlf) {
+    if (!crlf) return fwrite(text, 1, len, out) == len;
+    while (len > 0) {
+        const char *nl = (const char*)memchr(text, '\n', len);
+        size_t n = nl ? (size_t)(nl - text) : len;
+        if (fwrite(text, 1, n, out) != n) return false;
+        if (nl == NULL) break;
+        if (fwrite("\r\n", 1, 2, out) != 2) return false;
+        text += n + 1;
+        len -= n + 1;
+    }
+    return true;
+}
+
+static bool save_text(Document *doc, DocFile *f) {
+    char *tmp = tmp_path(f->path);
+    FILE *out = fopen(tmp, "wb");
+    if (out == NULL) { free(tmp); return false; }
+
+    bool ok = true;
+    for (Block *b = doc->start; b; b = b->next) {
+        const char *text = b->text ? b->text : b->src;
+        if (!write_lines(out, text, block_len(b), f->crlf)) ok = false;
+        if (b->next && !write_lines(out, "\n\n", 2, f->crlf)) ok = false;
+    }
+    if (f->trailing_newline && !write_lines(out, "\n", 1, f->crlf)) ok = false;
+    if (ok && !sync_file(out)) ok = false;
+    if (fclose(out) != 0) ok = false;
+
+    if (ok) ok = replace_file(tmp, f->path);
+    else remove(tmp);
+    free(tmp);
+    return ok;
+}
+
+// ============================================================================
+// native
+// ============================================================================
+
+// blocks a failed open attached already
+static void drop_blocks(Document *doc) {
+    Block *b = doc->start;
+    while (b != NULL) {
+        Block *next = b->next;
+        free_block(b);
+        b = next;
+    }
+    doc->start = NULL;
+    doc->end = NULL;
+    doc->id_counter = 0;
+}
+
+// the table is checked before anything points into the mapping: payloads
+// lie between the header and the table, ids are unique and within the
+// header's counter, line counts fit their payloads. payload hashes are
+// checked as each payload is first loaded (block_load), so opening does
+// not read every payload.
+static bool open_native(Document *doc, DocFile *f) {
+    DocFileHeader h;
+    memcpy(&h, f->map, sizeof h);
+    if (h.version != DOCFILE_VERSION) return false;
+    if (h.id_counter > INT_MAX || h.block_count > INT_MAX) return false;
+
+    uint64_t table_bytes = (uint64_t)h.block_count * sizeof(DocFileEntry);
+    if (h.table_offset < sizeof(DocFileHeader) || h.table_offset > f->map_size
+        || table_bytes > f->map_size - h.table_offset) return false;
+
+    const char *table = f->map + h.table_offset;
+    for (uint32_t i = 0; i < h.block_count; i++) {
+        DocFileEntry e;
+        memcpy(&e, table + i * sizeof e, sizeof e);
+        if (e.offset < sizeof(DocFileHeader) || e.offset > h.table_offset || e.length > h.table_offset - e.offset) return false;
+        if (e.length >= INT_MAX) return false;
+        if (e.id == 0 || e.id > h.id_counter) return false;
+        if (e.line_count == 0 || e.line_count > e.length + 1) return false;
+    }
+
+    // one allocation for the whole table, the text stays in the mapping
+    Block *blocks = (h.block_count > 0) ? create_lazy_blocks((int)h.block_count) : NULL;
+    for (uint32_t i = 0; i < h.block_count; i++) {
+        DocFileEntry e;
+        memcpy(&e, table + i * sizeof e, sizeof e);
+        if (find_block(doc, (int)e.id) != NULL) {
+            // repeated id
+            for (uint32_t k = i; k < h.block_count; k++) free_block(&blocks[k]);
+            drop_blocks(doc);
+            return false;
+        }
+
+        Block *b = &blocks[i];
+        b->id = (int)e.id;
+        b->src = f->map + e.offset;
+        b->src_len = (int)e.length;
+        b->line_count = (int)e.line_count;
+        b->file_offset = (long long)e.offset;
+        b->hash = e.hash;
+        append_block(doc, b);
+    }
+    doc->id_counter = (int)h.id_counter;
+
+    f->native = true;
+    f->file_size = f->map_size;
+    f->payload_bytes = h.payload_bytes;
+    return true;
+}
+
+static bool write_header(FILE *out, Document *doc, uint32_t count, uint64_t table_offset,
+                         uint64_t payload_bytes, uint64_t file_size) {
+    DocFileHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, DOCFILE_MAGIC, 8);
+    h.version = DOCFILE_VERSION;
+    h.block_count = count;
+    h.id_counter = (uint32_t)doc->id_counter;
+    h.table_offset = table_offset;
+    h.payload_bytes = payload_bytes;
+    h.file_size = file_size;
+
+    if (file_seek(out, 0, SEEK_SET) != 0) return false;
+    return fwrite(&h, sizeof h, 1, out) == 1;
+}
+
+static void commit_entries(Document *doc, const DocFileEntry *entries) {
+    int i = 0;
+    for (Block *b = doc->start; b; b = b->next, i++) {
+        b->file_offset = (long long)entries[i].offset;
+        b->src_len = (int)entries[i].length;
+        b->hash = entries[i].hash;
+        b->line_count = (int)entries[i].line_count;
+        b->dirty = false;
+    }
+}
+
+static uint32_t count_blocks(Document *doc) {
+    uint32_t count = 0;
+    for (Block *b = doc->start; b; b = b->next) count++;
+    return count;
+}
+
+// full rewrite into a fresh file. used for first saves and compaction.
+static bool write_native(Document *doc, DocFile *f) {
+    load_all(doc);
+    unmap_file(f);
+
+    char *tmp = tmp_path(f->path);
+    FILE *out = fopen(tmp, "wb");
+    if (out == NULL) { free(tmp); return false; }
+
+    uint32_t count = count_blocks(doc);
+    DocFileEntry *entries = (DocFileEntry*)malloc((count + 1) * sizeof(DocFileEntry));
+
+    bool ok = write_header(out, doc, 0, 0, 0, 0);
+    uint64_t pos = sizeof(DocFileHeader);
+    int i = 0;
+    for (Block *b = doc->start; b && ok; b = b->next, i++) {
+        size_t len = strlen(b->text);
+        if (fwrite(b->text, 1, len, out) != len) ok = false;
+        entries[i].id = (uint32_t)b->id;
+        entries[i].line_count = (uint32_t)count_lines(b->text, len);
+        entries[i].offset = pos;
+        entries[i].length = len;
+        entries[i].hash = docfile_hash(b->text, len);
+        pos += len;
+    }
+
+    uint64_t payload_bytes = pos - sizeof(DocFileHeader);
+    uint64_t table_offset = pos;
+    if (ok && fwrite(entries, sizeof(DocFileEntry), count, out) != count) ok = false;
+    pos += (uint64_t)count * sizeof(DocFileEntry);
+
+    if (ok) ok = sync_file(out);
+    if (ok) ok = write_header(out, doc, count, table_offset, payload_bytes, pos);
+    if (ok) ok = sync_file(out);
+    if (fclose(out) != 0) ok = false;
+
+    if (ok) ok = replace_file(tmp, f->path);
+    else remove(tmp);
+
+    if (ok) {
+        commit_entries(doc, entries);
+        f->native = true;
+        f->file_size = pos;
+        f->payload_bytes = payload_bytes;
+    }
+    free(entries);
+    free(tmp);
+    return ok;
+}
+
+// appends changed payloads and a new table, leaves clean payloads in place
+static bool append_native(Document *doc, DocFile *f) {
+    FILE *out = fopen(f->path, "r+b");
+    if (out == NULL) return false;
+    if (file_seek(out, (long long)f->file_size, SEEK_SET) != 0) { fclose(out); return false; }
+
+    uint32_t count = count_blocks(doc);
+    DocFileEntry *entries = (DocFileEntry*)malloc((count + 1) * sizeof(DocFileEntry));
+
+    bool ok = true;
+    uint64_t pos = f->file_size;
+    uint64_t payload_bytes = 0;
+    int i = 0;
+    for (Block *b = doc->start; b && ok; b = b->next, i++) {
+        DocFileEntry *e = &entries[i];
+        e->id = (uint32_t)b->id;
+
+        if (!b->dirty && b->file_offset >= 0) {
+            e->offset = (uint64_t)b->file_offset;
+            e->length = (uint64_t)b->src_len;
+            e->hash = b->hash;
+            e->line_count = (uint32_t)b->line_count;
+        } else {
+            size_t len = strlen(b->text);
+            uint64_t hash = docfile_hash(b->text, len);
+            e->length = len;
+            e->hash = hash;
+            e->line_count = (uint32_t)count_lines(b->text, len);
+
+            if (b->file_offset >= 0 && hash == b->hash && (int)len == b->src_len) {
+                e->offset = (uint64_t)b->file_offset; // edited back to the stored text
+            } else {
+                if (fwrite(b->text, 1, len, out) != len) ok = false;
+                e->offset = pos;
+                pos += len;
+            }
+        }
+        payload_bytes += e->length;
+    }
+
+    uint64_t table_offset = pos;
+    if (ok && fwrite(entries, sizeof(DocFileEntry), count, out) != count) ok = false;
+    pos += (uint64_t)count * sizeof(DocFileEntry);
+
+    // the header may only point at payloads and a table already on disk
+    if (ok) ok = sync_file(out);
+    if (ok) ok = write_header(out, doc, count, table_offset, payload_bytes, pos);
+    if (ok) ok = sync_file(out);
+    if (fclose(out) != 0) ok = false;
+
+    if (ok) {
+        commit_entries(doc, entries);
+        f->file_size = pos;
+        f->payload_bytes = payload_bytes;
+    }
+    free(entries);
+    return ok;
+}
+
+// ============================================================================
+// public api
+// ============================================================================
+
+bool docfile_open(Document *doc, const char *path) {
+    PROFILE_SCOPE("docfile_open");
+    DocFile *f = (DocFile*)calloc(1, sizeof(DocFile));
+    f->path = strdup(path);
+
+    bool ok;
+    if (map_file(f) && f->map_size >= sizeof(DocFileHeader) && memcmp(f->map, DOCFILE_MAGIC, 8) == 0) {
+        ok = open_native(doc, f);
+    } else {
+        unmap_file(f);
+        ok = open_text(doc, f);
+    }
+
+    if (!ok) {
+        unmap_file(f);
+        free(f->path);
+        free(f);
+        return false;
+    }
+
+    doc->file = f;
+    if (doc->start == NULL) add_block(doc, "");
+    return true;
+}
+
+bool docfile_save(Document *doc) {
+    PROFILE_SCOPE("docfile_save");
+    DocFile *f = doc->file;
+    if (f == NULL) return false;
+    if (!f->native) return save_text(doc, f);
+
+    // dead payloads and old tables outweigh the live data: compact
+    uint64_t live = sizeof(DocFileHeader) + f->payload_bytes;
+    if (f->file_size == 0 || (f->file_size > 2 * live && f->file_size - live > (1 << 20))) {
+        return write_native(doc, f);
+    }
+    return append_native(doc, f);
+}
+
+bool docfile_save_as(Document *doc, const char *path) {
+    PROFILE_SCOPE("docfile_save_as");
+    if (doc->file != NULL && strcmp(doc->file->path, path) == 0) return docfile_save(doc);
+
+    load_all(doc);
+    bool crlf = doc->file != NULL && doc->file->crlf;
+    docfile_close(doc);
+
+    DocFile *f = (DocFile*)calloc(1, sizeof(DocFile));
+    f->path = strdup(path);
+    f->native = has_native_ext(path);
+    f->trailing_newline = !f->native;
+    f->crlf = crlf && !f->native;
+    doc->file = f;
+
+    // stored offsets refer to the old file
+    for (Block *b = doc->start; b; b = b->next) b->file_offset = -1;
+
+    return f->native ? write_native(doc, f) : save_text(doc, f);
+}
+
+void docfile_close(Document *doc) {
+    DocFile *f = doc->file;
+    if (f == NULL) return;
+    unmap_file(f);
+    free(f->path);
+    free(f);
+    doc->file = NULL;
+}
+
+const char* docfile_path(const Document *doc) {
+    return doc->file ? doc->file->path : NULL;
+}
@@ -0,0 +1,170 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/document.h"
+#include "include/docfile.h"
+#include "include/textscan.h"
+#include "include/scratch.h"
+#include "include/marker.h"
+#define ALLOC_SUBSYSTEM ALLOC_DOCUMENT
+#include "include/alloc_stats.h"
+
+Document* create_document() {
+    Document *doc = (Document*)malloc(sizeof(Document));
+    if (doc == NULL) return NULL;
+    doc->start = NULL;
+    doc->end = NULL;
+    doc->id_counter = 0;
+    memset(&doc->meta, 0, sizeof(BlockMeta));
+    doc->file = NULL;
+    doc->markers = NULL;
+    return doc;
+}
+
+void add_block(Document *doc, char *text) {
+    doc->id_counter++;
+    append_block(doc, create_block(doc->id_counter, text));
+}
+
+// links an already built block at the end (loaders keep their stored ids)
+void append_block(Document *doc, Block *new_block) {
+    block_meta_attach(&doc->meta, new_block);
+    if (doc->start == NULL) {
+        doc->start = new_block;
+        doc->end = new_block;
+    } else {
+        doc->end->next = new_block;
+        doc->end = new_block;
+    }
+}
+
+void insert_block_after(Document *doc, Block *prev_block, char *text) {
+    doc->id_counter++;
+    Block *new_block = create_block(doc->id_counter, text);
+    block_meta_attach(&doc->meta, new_block);
+
+    if (prev_block == NULL) {
+        new_block->next = doc->start;
+        doc->start = new_block;
+        if (doc->end == NULL) doc->end = new_block;
+    } else {
+        new_block->next = prev_block->next;
+        prev_block->next = new_block;
+        if (prev_block == doc->end) doc->end = new_block;
+    }
+}
+
+Block* find_block(Document *doc, int id) {
+    return block_meta_find(&doc->meta, id);
+}
+
+Block* block_before(Document *doc, Block *b) {
+    if (b == doc->start) return NULL;
+    Block *prev = doc->start;
+    while (prev != NULL && prev->next != b) prev = prev->next;
+    return prev;
+}
+
+// unlinks and frees b->next .. last (inclusive), last must follow b
+void remove_blocks_after(Document *doc, Block *b, Block *last) {
+    Block *current = b->next;
+    b->next = last->next;
+    if (last == doc->end) doc->end = b;
+    while (current != b->next) {
+        Block *temp_next = current->next;
+        free_block(current);
+        current = temp_next;
+    }
+}
+
+void free_document(Document *doc) {
+    Block *current = doc->start;
+    while (current != NULL) {
+        Block *temp_next = current->next;
+        free_block(current);
+        current = temp_next;
+    }
+    block_meta_free(&doc->meta);
+    marker_table_free(doc->markers);
+    docfile_close(doc);
+    free(doc);
+}
+
+// ----------------------------------------------------------------------------
+// editing
+// ----------------------------------------------------------------------------
+
+Block* split_block(Document *doc, Block *b, int at) {
+    block_touch(b);
+    insert_block_after(doc, b, &b->text[at]);
+    b->text[at] = '\0';
+    markers_move(doc, b, at + 1, INT_MAX, b->next, 1, false);   // one right at the split stays
+    b->next->cursor_index = 0;
+    return b->next;
+}
+
+Block* merge_with_next(Document *doc, Block *b) {
+    Block *next = b->next;
+    block_touch(b);
+    block_load(next);
+    int len = strlen(b->text);
+    block_reserve(b, len + strlen(next->text) + 1);
+    strcpy(&b->text[len], next->text);
+    markers_move(doc, next, 0, INT_MAX, b, len, false);
+
+    b->next = next->next;
+    if (next == doc->end) doc->end = b;
+    free_block(next);
+    b->cursor_index = len;
+    return b;
+}
+
+// inserts raw text (paste, dropped file) at the cursor. blank lines split
+// it into blocks like an opened file. returns the block holding the cursor.
+Block* insert_text(Document *doc, Block *b, const char *text, size_t len) {
+    // the normalized copy and the cut-off tail are scratch
+    ScratchMark mark = scratch_begin();
+    char *data = (char*)scratch_alloc(len + 1);
+    memcpy(data, text, len);
+    TextSpans split = {0};
+    text_split(data, len, &split);
+
+    // 1. cut the tail off at the cursor
+    block_touch(b);
+    int cut = b->cursor_index;
+    int tail_len = strlen(&b->text[cut]);
+    char *tail_text = (char*)scratch_alloc(tail_len + 1);
+    memcpy(tail_text, &b->text[b->cursor_index], tail_len + 1);
+    b->text[b->cursor_index] = '\0';
+
+    // 2. first span joins the current block, the rest become new blocks
+    Block *curr = b;
+    for (int i = 0; i < split.count; i++) {
+        TextSpan *span = &split.spans[i];
+        data[span->start + span->len] = '\0';
+
+        if (i == 0) {
+            int head_len = strlen(curr->text);
+            block_reserve(curr, head_len + span->len + 1);
+            memcpy(&curr->text[head_len], &data[span->start], span->len + 1);
+        } else {
+            insert_block_after(doc, curr, &data[span->start]);
+            curr = curr->next;
+            curr->line_count = span->line_count;
+        }
+    }
+
+    // 3. reattach the tail after the inserted text
+    block_touch(curr);
+    int curr_len = strlen(curr->text);
+    block_reserve(curr, curr_len + tail_len + 1);
+    memcpy(&curr->text[curr_len], tail_text, tail_len + 1);
+    // markers past the cut follow the tail, one right at it stays in front
+    // of the pasted text
+    markers_move(doc, b, cut + 1, INT_MAX, curr, curr_len + 1, false);
+    curr->cursor_index = curr_len;
+
+    text_split_free(&split);
+    scratch_end(mark);
+    return curr;
+}
@@ -0,0 +1,872 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/editor_state.h"
+#include "include/utf8.h"
+#include "include/words.h"
+#include "include/profile.h"
+#include "include/scratch.h"
+#define ALLOC_SUBSYSTEM ALLOC_EDIT
+#include "include/alloc_stats.h"
+
+void editor_init(EditorState *ed, Document *doc, MeasureFn measure, void *user) {
+    memset(ed, 0, sizeof(EditorState));
+    ed->doc = doc;
+    layout_init(&ed->layout, measure, user, 680, 24);   // an 800 x 600 view until resized
+    ed->top = 20;
+    ed->left = 60;
+    ed->height = 600;
+}
+
+void editor_free(EditorState *ed) {
+    free(ed->view.order);
+    free(ed->view.height);
+    free(ed->view.tree);
+    free(ed->view.pos);
+    free(ed->lines.start);
+    free(ed->lines.end_x);
+    free(ed->lines.x);
+    memset(&ed->view, 0, sizeof(ViewIndex));
+    memset(&ed->lines, 0, sizeof(LineCache));
+}
+
+// ----------------------------------------------------------------------------
+// view
+// ----------------------------------------------------------------------------
+
+static int measure_block(EditorState *ed, Block *b) {
+    const Layout *lo = &ed->layout;
+    BlockMeta *m = b->meta;
+    int h = b->handle;
+    m->lines[h] = layout_line_count(lo, b->text, block_len(b));
+    m->height[h] = layout_height(lo, m->lines[h]);
+    m->layout_gen[h] = lo->gen;
+    return m->height[h];
+}
+
+int editor_block_height(EditorState *ed, Block *b) {
+    const Layout *lo = &ed->layout;
+    BlockMeta *m = b->meta;
+    if (m == NULL) return layout_height(lo, layout_line_count(lo, b->text, block_len(b)));
+    int h = b->handle;
+    if (m->layout_gen[h] != lo->gen) {
+        measure_block(ed, b);
+        block_meta_touched(m, h);
+    }
+    return m->height[h];
+}
+
+int editor_block_estimate(EditorState *ed, Block *b) {
+    const Layout *lo = &ed->layout;
+    if (b->text == NULL) return layout_height(lo, b->line_count);
+    BlockMeta *m = b->meta;
+    // measured under an older layout: good enough until the reflow gets there
+    if (m != NULL && m->layout_gen[b->handle] != 0) return m->height[b->handle];
+    return editor_block_height(ed, b);
+}
+
+bool editor_hit_test(EditorState *ed, float x, float y, Block **out, int *index) {
+    PROFILE_SCOPE("editor_hit_test");
+    const Layout *lo = &ed->layout;
+    // from the block at the top of the view (or at y, above it) on
+    int top;
+    Block *b = editor_block_at(ed, (int)ed->scroll_y - ed->top + (y < 0 ? (int)y : 0), &top);
+    int by = ed->top - (int)ed->scroll_y + top;
+
+    for (; b != NULL && by <= y; b = b->next) {
+        // off screen: the height drawing places it with (estimated from the
+        // stored line count, or the last one measured)
+        int est_height = editor_block_estimate(ed, b);
+        if ((by + est_height + lo->gap < 0 || by > ed->height) && b != ed->focus) {
+            by += est_height + lo->gap;
+            continue;
+        }
+        block_load(b);
+        int len = block_len(b);
+        int height = editor_block_height(ed, b);
+        if (y < by + height + lo->gap) {
+            *out = b;
+            *index = layout_hit_test(lo, b->text, len, x - ed->left, y - (by + lo->pad), x < ed->left);
+            return true;
+        }
+        by += height + lo->gap;
+    }
+    return false;
+}
+
+// the view is width x height window pixels. text wraps short of the right
+// edge by the left margin.
+static void resize(EditorState *ed, float width, float height) {
+    Layout *lo = &ed->layout;
+    ed->height = (int)height;
+    float wrap = width - 2 * ed->left;
+    if (wrap < EDITOR_MIN_WRAP) wrap = EDITOR_MIN_WRAP;
+    if (wrap == lo->max_width) return;
+    lo->max_width = wrap;
+    layout_changed(lo);
+}
+
+// ----------------------------------------------------------------------------
+// view index
+// ----------------------------------------------------------------------------
+
+// what the draw walk advances past b, gap included
+static int walk_height(EditorState *ed, Block *b) {
+    return editor_block_estimate(ed, b) + ed->layout.gap;
+}
+
+static void view_add(ViewIndex *v, int p, int delta) {
+    v->height[p] += delta;
+    for (int i = p + 1; i <= v->slots; i += i & -i) v->tree[i] += delta;
+}
+
+// document y of the block at slot p (the first block's top is 0)
+static int view_top(const ViewIndex *v, int p) {
+    int y = 0;
+    for (int i = p; i > 0; i -= i & -i) y += v->tree[i];
+    return y;
+}
+
+// slot of the last block before slot p, -1 = none
+static int view_before(const ViewIndex *v, int p) {
+    do p--; while (p >= 0 && v->order[p] == NULL);
+    return p;
+}
+
+// fenwick nodes lo + 1 .. lo + w - 1 from the heights. lo is a multiple
+// of w, so they sum slots inside the window only.
+static void tree_fill(ViewIndex *v, int lo, int w) {
+    for (int i = lo + 1; i < lo + w; i++) v->tree[i] = v->height[i - 1];
+    // each node hands its sum on to its parent: O(w)
+    for (int i = lo + 1; i < lo + w; i++) {
+        int parent = i + (i & -i);
+        if (parent < lo + w) v->tree[parent] += v->tree[i];
+    }
+}
+
+static int window_count(const ViewIndex *v, int lo, int w) {
+    int n = 0;
+    for (int s = lo; s < lo + w; s++) n += (v->order[s] != NULL);
+    return n;
+}
+
+// blocks a window of w slots may hold: from 1/8 to all of a leaf
+// window, tightening to 1/4 .. 3/4 for the whole index, so spreading
+// a window out leaves room in each of its halves
+#define VIEW_LEAF 16
+static void window_bounds(const ViewIndex *v, int w, int *min, int *max) {
+    int level = 0, levels = 0;
+    for (int x = VIEW_LEAF; x < w; x *= 2) level++;
+    for (int x = VIEW_LEAF; x < v->slots; x *= 2) levels++;
+    int f = levels ? 64 * level / levels : 64;
+    *min = w / 8 + w * f / 512;
+    *max = w - w * f / 256;
+}
+
+// lays the blocks of the window [lo, lo + w) out evenly again, with b
+// (if any) joining in front of slot at
+static void view_spread(ViewIndex *v, int lo, int w, Block *b, int b_height, int at) {
+    ScratchMark mark = scratch_begin();
+    Block **blocks = (Block**)scratch_alloc((w + 1) * sizeof(Block*));
+    int *heights = (int*)scratch_alloc((w + 1) * sizeof(int));
+    int n = 0;
+    int old = 0;
+    for (int s = lo; s <= lo + w; s++) {
+        if (s == at && b != NULL) {
+            blocks[n] = b;
+            heights[n++] = b_height;
+            b = NULL;
+        }
+        if (s == lo + w) break;
+        if (v->order[s] != NULL) {
+            blocks[n] = v->order[s];
+            heights[n++] = v->height[s];
+        }
+        old += v->height[s];
+        v->order[s] = NULL;
+        v->height[s] = 0;
+    }
+    if (b != NULL) {
+        blocks[n] = b;
+        heights[n++] = b_height;
+    }
+
+    int sum = 0;
+    for (int k = 0; k < n; k++) {
+        int s = lo + (int)((long long)k * w / n);
+        v->order[s] = blocks[k];
+        v->height[s] = heights[k];
+        v->pos[blocks[k]->handle] = s;
+        sum += heights[k];
+    }
+    tree_fill(v, lo, w);
+    // nodes from the window's own up hold it whole
+    for (int i = lo + w; i <= v->slots; i += i & -i) v->tree[i] += sum - old;
+    scratch_end(mark);
+}
+
+// b joins in front of slot at (v->slots = at the end). false when no
+// window has room
+static bool view_insert(EditorState *ed, Block *b, int at) {
+    ViewIndex *v = &ed->view;
+    int height = walk_height(ed, b);
+    int p = view_before(v, at);
+    v->count++;
+    if (p + 1 < at) {
+        v->order[p + 1] = b;
+        v->pos[b->handle] = p + 1;
+        view_add(v, p + 1, height);
+        return true;
+    }
+    int s = (at < v->slots) ? at : p;
+    for (int w = VIEW_LEAF; ; w *= 2) {
+        int lo = s & ~(w - 1);
+        int min, max;
+        window_bounds(v, w, &min, &max);
+        if (window_count(v, lo, w) + 1 <= max) {
+            view_spread(v, lo, w, b, height, at);
+            return true;
+        }
+        if (w == v->slots) return false;
+    }
+}
+
+// a block left slot p. false when the whole index got too empty
+static bool view_thin(ViewIndex *v, int p) {
+    for (int w = VIEW_LEAF; ; w *= 2) {
+        int lo = p & ~(w - 1);
+        int min, max;
+        window_bounds(v, w, &min, &max);
+        if (window_count(v, lo, w) >= min) {
+            if (w > VIEW_LEAF) view_spread(v, lo, w, NULL, 0, -1);
+            return true;
+        }
+        if (w == v->slots) return w == VIEW_LEAF;
+    }
+}
+
+static void view_build(EditorState *ed) {
+    PROFILE_SCOPE("view_build");
+    ViewIndex *v = &ed->view;
+    BlockMeta *m = &ed->doc->meta;
+    int n = 0;
+    for (Block *b = ed->doc->start; b != NULL; b = b->next) n++;
+    // a quarter to half full
+    int slots = VIEW_LEAF;
+    while (slots < 2 * n) slots *= 2;
+    if (slots > v->cap) {
+        v->order = (Block**)realloc(v->order, slots * sizeof(Block*));
+        v->height = (int*)realloc(v->height, slots * sizeof(int));
+        v->tree = (int*)realloc(v->tree, (slots + 1) * sizeof(int));
+        v->cap = slots;
+    }
+    if (m->count > v->pos_cap) {
+        v->pos = (int*)realloc(v->pos, m->count * sizeof(int));
+        v->pos_cap = m->count;
+    }
+    for (int h = 0; h < v->pos_cap; h++) v->pos[h] = -1;
+    memset(v->order, 0, slots * sizeof(Block*));
+    memset(v->height, 0, slots * sizeof(int));
+    v->slots = slots;
+
+    int i = 0;
+    int total = 0;
+    for (Block *b = ed->doc->start; b != NULL; b = b->next, i++) {
+        int s = (int)((long long)i * slots / n);
+        v->order[s] = b;
+        v->pos[b->handle] = s;
+        v->height[s] = walk_height(ed, b);
+        total += v->height[s];
+    }
+    tree_fill(v, 0, slots);
+    v->tree[slots] = total;
+    v->count = n;
+    v->built = true;
+    v->doc = ed->doc;
+    v->shape = m->shape;
+    v->line_height = ed->layout.line_height;
+    v->pad = ed->layout.pad;
+    v->gap = ed->layout.gap;
+    m->reshaped_count = 0;
+    m->touched_count = 0;
+}
+
+// applies the joins and leaves BlockMeta logged since the last look.
+// false when the index has to be laid out again.
+static bool view_reshape(EditorState *ed) {
+    ViewIndex *v = &ed->view;
+    BlockMeta *m = &ed->doc->meta;
+    if (m->count > v->pos_cap) {
+        v->pos = (int*)realloc(v->pos, m->count * sizeof(int));
+        for (int h = v->pos_cap; h < m->count; h++) v->pos[h] = -1;
+        v->pos_cap = m->count;
+    }
+    int n = m->reshaped_count;
+    m->reshaped_count = 0;
+    v->shape = m->shape;
+
+    // leaves first: their slots still hold the freed blocks, nothing may
+    // be moved before they are all emptied
+    int freed[BLOCK_META_TOUCHED];
+    int freed_count = 0;
+    for (int k = 0; k < n; k++) {
+        if (m->reshaped[k] >= 0) continue;
+        int h = -1 - m->reshaped[k];
+        int p = v->pos[h];
+        if (p < 0) continue;   // joined after the last look
+        v->pos[h] = -1;
+        view_add(v, p, -v->height[p]);
+        v->order[p] = NULL;
+        v->count--;
+        freed[freed_count++] = p;
+    }
+    for (int k = 0; k < freed_count; k++) {
+        if (!view_thin(v, freed[k])) return false;
+    }
+
+    // a join goes in front of the next block already in the index
+    for (int k = 0; k < n; k++) {
+        int h = m->reshaped[k];
+        if (h < 0) continue;
+        Block *b = m->block[h];
+        if (b == NULL || v->pos[h] >= 0) continue;   // left again, or in already
+        Block *next = b->next;
+        while (next != NULL && v->pos[next->handle] < 0) next = next->next;
+        if (!view_insert(ed, b, next ? v->pos[next->handle] : v->slots)) return false;
+    }
+    return true;
+}
+
+// brings the index up to date: joins and leaves as they were logged,
+// heights of touched blocks in place. a rebuild (line geometry changed,
+// too much happened since the last look, no room left) is done only
+// when allowed, the index is about to be read. a new wrap width alone
+// does not need one: blocks keep their old heights until measured
+// again, and every measurement is a touch.
+static void view_sync(EditorState *ed, bool rebuild) {
+    ViewIndex *v = &ed->view;
+    BlockMeta *m = &ed->doc->meta;
+    const Layout *lo = &ed->layout;
+    bool stale = !v->built || v->doc != ed->doc || m->reshaped_count > BLOCK_META_TOUCHED
+              || m->touched_count > BLOCK_META_TOUCHED
+              || v->line_height != lo->line_height || v->pad != lo->pad || v->gap != lo->gap;
+    if (!stale && m->reshaped_count > 0 && !view_reshape(ed)) {
+        v->built = false;
+        stale = true;
+    }
+    if (stale) {
+        if (rebuild) view_build(ed);
+        return;
+    }
+    for (int k = 0; k < m->touched_count; k++) {
+        int p = v->pos[m->touched[k]];
+        if (p < 0) continue;
+        int delta = walk_height(ed, v->order[p]) - v->height[p];
+        if (delta != 0) view_add(v, p, delta);
+    }
+    m->touched_count = 0;
+}
+
+// slot of the block covering document y, *top = its top. before the
+// start: the first block, past the end: the last.
+static int view_find(const ViewIndex *v, int y, int *top) {
+    if (y < 0) y = 0;
+    int p = 0;
+    int sum = 0;
+    int step = v->slots;
+    for (; step > 0; step /= 2) {
+        if (p + step <= v->slots && sum + v->tree[p + step] <= y) {
+            p += step;
+            sum += v->tree[p];
+        }
+    }
+    if (p == v->slots || v->order[p] == NULL) {
+        p = view_before(v, p);
+        sum = view_top(v, p);
+    }
+    *top = sum;
+    return p;
+}
+
+// block before b: from the index while the block order in it is current,
+// else by walking the list
+static Block* view_prev(EditorState *ed, Block *b) {
+    ViewIndex *v = &ed->view;
+    if (v->built && v->doc == ed->doc && v->shape == ed->doc->meta.shape) {
+        int p = view_before(v, v->pos[b->handle]);
+        return (p >= 0) ? v->order[p] : NULL;
+    }
+    return block_before(ed->doc, b);
+}
+
+bool editor_reflow(EditorState *ed, int budget) {
+    PROFILE_SCOPE("editor_reflow");
+    const Layout *lo = &ed->layout;
+    if (ed->reflow_gen != lo->gen) {
+        ed->reflow_gen = lo->gen;
+        ed->reflow_pos = 0;
+    }
+    if (ed->reflow_pos < 0) return false;
+    view_sync(ed, true);
+    ViewIndex *v = &ed->view;
+    // document y at the top of the view
+    int view_y = (int)ed->scroll_y - ed->top;
+
+    while (ed->reflow_pos < v->slots && budget > 0) {
+        int p = ed->reflow_pos++;
+        Block *b = v->order[p];
+        budget -= 16;
+        if (b == NULL || b->text == NULL || b->meta->layout_gen[b->handle] == lo->gen) continue;
+        budget -= block_len(b);
+        int old = v->height[p];
+        bool above = view_top(v, p) + old <= view_y;
+        int delta = measure_block(ed, b) + lo->gap - old;
+        if (delta == 0) continue;
+        view_add(v, p, delta);
+        // what is on screen stays put
+        if (above) {
+            ed->scroll_y += delta;
+            view_y += delta;
+        }
+    }
+    if (ed->reflow_pos >= v->slots) ed->reflow_pos = -1;
+    return ed->reflow_pos >= 0;
+}
+
+int editor_block_top(EditorState *ed, Block *b) {
+    view_sync(ed, true);
+    return view_top(&ed->view, ed->view.pos[b->handle]);
+}
+
+Block* editor_block_at(EditorState *ed, int y, int *top) {
+    view_sync(ed, true);
+    return ed->view.order[view_find(&ed->view, y, top)];
+}
+
+int editor_content_height(EditorState *ed) {
+    view_sync(ed, true);
+    return view_top(&ed->view, ed->view.slots);
+}
+
+void editor_place_focus(EditorState *ed, int overscan) {
+    const Layout *lo = &ed->layout;
+    Block *b = ed->focus;
+    // nothing clicked yet
+    if (b == NULL) return;
+    int y = ed->top - (int)ed->scroll_y + editor_block_top(ed, b);
+    int est_height = editor_block_estimate(ed, b);
+    block_load(b);
+    int height = editor_block_height(ed, b);
+    if (y + est_height + lo->gap < 0) {
+        ed->scroll_y += height - est_height;
+        y -= height - est_height;
+    }
+
+    if (!ed->follow_cursor || (y + height + lo->gap >= -overscan && y <= ed->height + overscan)) return;
+    int line;
+    float x;
+    layout_caret(lo, b->text, block_len(b), b->cursor_index, &line, &x);
+    int cy = y + lo->pad + line * lo->line_height;
+    if (cy < 0) ed->scroll_y += cy - 20;
+    else ed->scroll_y += cy + lo->line_height - ed->height + 20;
+}
+
+// ----------------------------------------------------------------------------
+// visual lines
+// ----------------------------------------------------------------------------
+
+static const LineCache* block_lines(EditorState *ed, Block *b) {
+    const Layout *lo = &ed->layout;
+    LineCache *c = &ed->lines;
+    if (c->block == b && c->id == b->id && c->version == b->version && c->gen == lo->gen) return c;
+    block_load(b);
+    editor_block_height(ed, b);
+    int lines = b->meta->lines[b->handle];
+    int len = block_len(b);
+    if (lines > c->cap) {
+        c->cap = (lines > c->cap * 2) ? lines : c->cap * 2;
+        c->start = (int*)realloc(c->start, c->cap * sizeof(int));
+        c->end_x = (float*)realloc(c->end_x, c->cap * sizeof(float));
+    }
+    if (len + 1 > c->x_cap) {
+        c->x_cap = (len + 1 > c->x_cap * 2) ? len + 1 : c->x_cap * 2;
+        c->x = (float*)realloc(c->x, c->x_cap * sizeof(float));
+    }
+    c->count = layout_line_map(lo, b->text, len, c->start, c->end_x, c->x);
+    c->block = b;
+    c->id = b->id;
+    c->version = b->version;
+    c->gen = lo->gen;
+    return c;
+}
+
+// visual line of the caret at index. a caret at a wrap stays at the end
+// of the upper line, like layout_caret puts it.
+static int caret_line(const LineCache *c, const char *text, int index) {
+    int lo = 0, hi = c->count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (c->start[mid] <= index) lo = mid;
+        else hi = mid - 1;
+    }
+    if (lo > 0 && c->start[lo] == index && text[index - 1] != '\n') lo--;
+    return lo;
+}
+
+// first caret position on line l. a caret at a wrap shows at the end of
+// the upper line, so on a wrapped line that is after its first glyph.
+static int line_home(const LineCache *c, const char *text, int len, int l) {
+    int start = c->start[l];
+    if (l == 0 || text[start - 1] == '\n' || start == len) return start;
+    int cp;
+    return start + utf8_decode(&text[start], len - start, &cp);
+}
+
+// last caret position on line l: before its '\n', or where it wraps
+static int line_end(const LineCache *c, const char *text, int len, int l) {
+    if (l + 1 >= c->count) return len;
+    int next = c->start[l + 1];
+    return (text[next - 1] == '\n') ? next - 1 : next;
+}
+
+// caret x of index on line l
+static float caret_x(const LineCache *c, const char *text, int len, int l, int index) {
+    return (index == line_end(c, text, len, l)) ? c->end_x[l] : c->x[index];
+}
+
+// caret position on line l nearest to x, the earlier one on a tie
+static int line_index_at(const LineCache *c, const char *text, int len, int l, float x) {
+    int from = line_home(c, text, len, l);
+    int to = line_end(c, text, len, l);
+    if (from >= to || x >= c->end_x[l]) return to;
+    // first position at or past x; the bytes of a glyph share its x, so
+    // that is where a glyph starts
+    int lo = from, hi = to;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (c->x[mid] < x) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == from) return from;
+    int prev = lo - utf8_prev_len(text, lo);
+    float after = (lo == to) ? c->end_x[l] : c->x[lo];
+    return (x - c->x[prev] <= after - x) ? prev : lo;
+}
+
+// x up / down aim for: the sticky one while the caret has not moved
+// since the last vertical step, else the caret's own
+static float aim_x(EditorState *ed, const LineCache *c, int line) {
+    Block *b = ed->focus;
+    if (ed->sticky_block == b && ed->sticky_version == b->version && ed->sticky_index == b->cursor_index) return ed->sticky_x;
+    return caret_x(c, b->text, block_len(b), line, b->cursor_index);
+}
+
+static void stick(EditorState *ed, float x) {
+    Block *b = ed->focus;
+    ed->sticky_block = b;
+    ed->sticky_version = b->version;
+    ed->sticky_index = b->cursor_index;
+    ed->sticky_x = x;
+}
+
+// document y of the top of the caret's line
+static int caret_y(EditorState *ed, int line) {
+    const Layout *lo = &ed->layout;
+    return view_top(&ed->view, ed->view.pos[ed->focus->handle]) + lo->pad + line * lo->line_height;
+}
+
+// ----------------------------------------------------------------------------
+// keyboard
+// ----------------------------------------------------------------------------
+
+// a plain move drops the selection, a shifted one starts it at the cursor
+static void begin_move(EditorState *ed, bool extend) {
+    if (!extend) selection_clear(&ed->sel, ed->doc);
+    else if (ed->sel.anchor == NULL) selection_begin(&ed->sel, ed->focus, ed->focus->cursor_index);
+}
+
+static void end_move(EditorState *ed, bool extend) {
+    if (extend) update_selection_range(ed->doc, &ed->sel, ed->focus, ed->focus->cursor_index);
+}
+
+// typing over a selection replaces it. all that can be left is the empty
+// range a click marks in the focus block, which must not outlive the edit.
+static bool delete_selection(EditorState *ed) {
+    Block *survivor = delete_selected_text(ed->doc);
+    if (survivor != NULL) ed->focus = survivor;
+    selection_clear(&ed->sel, ed->doc);
+    return survivor != NULL;
+}
+
+static void move_horizontal(EditorState *ed, int dir) {
+    Block *b = ed->focus;
+    int len = block_len(b);
+    if (dir > 0 && b->cursor_index < len) {
+        int cp;
+        b->cursor_index += utf8_decode(&b->text[b->cursor_index], len - b->cursor_index, &cp);
+    }
+    if (dir < 0 && b->cursor_index > 0) b->cursor_index -= utf8_prev_len(b->text, b->cursor_index);
+}
+
+// ctrl+left to the start of the word before the cursor, ctrl+right to
+// the end of the one after it (both stay in the block)
+static void move_word(EditorState *ed, int dir) {
+    Block *b = ed->focus;
+    WordBits w = block_words(b);
+    b->cursor_index = (dir > 0) ? word_next_end(&w, b->cursor_index) : word_prev_start(&w, b->cursor_index);
+}
+
+// keeps the caret's x, moving into the neighbouring block past the first / last line
+static void move_vertical(EditorState *ed, int dir) {
+    Block *b = ed->focus;
+    const LineCache *c = block_lines(ed, b);
+    int line = caret_line(c, b->text, b->cursor_index);
+    float x = aim_x(ed, c, line);
+
+    int target_line = line + dir;
+    if (target_line < 0) {
+        Block *prev = view_prev(ed, b);
+        if (prev != NULL) {
+            b = prev;
+            c = block_lines(ed, b);
+            target_line = c->count - 1;
+        } else {
+            target_line = 0;
+        }
+    } else if (target_line >= c->count) {
+        if (b->next != NULL) {
+            b = b->next;
+            c = block_lines(ed, b);
+            target_line = 0;
+        } else {
+            target_line = c->count - 1;
+        }
+    }
+    b->cursor_index = line_index_at(c, b->text, block_len(b), target_line, x);
+    ed->focus = b;
+    stick(ed, x);
+}
+
+// scrolls just enough to show the caret's line
+static void scroll_to_caret(EditorState *ed) {
+    const Layout *lo = &ed->layout;
+    view_sync(ed, true);
+    Block *b = ed->focus;
+    const LineCache *c = block_lines(ed, b);
+    int y = ed->top - (int)ed->scroll_y + caret_y(ed, caret_line(c, b->text, b->cursor_index));
+    if (y < 0) ed->scroll_y += y;
+    else if (y + lo->line_height > ed->height) ed->scroll_y += y + lo->line_height - ed->height;
+}
+
+// home / end: to the start / end of the caret's visual line.
+// ctrl: of the document.
+static void move_line_edge(EditorState *ed, int dir, bool ctrl) {
+    if (ctrl) {
+        Block *b = (dir < 0) ? ed->doc->start : ed->doc->end;
+        block_load(b);
+        b->cursor_index = (dir < 0) ? 0 : block_len(b);
+        ed->focus = b;
+        scroll_to_caret(ed);
+        return;
+    }
+    Block *b = ed->focus;
+    const LineCache *c = block_lines(ed, b);
+    int line = caret_line(c, b->text, b->cursor_index);
+    int len = block_len(b);
+    b->cursor_index = (dir < 0) ? line_home(c, b->text, len, line) : line_end(c, b->text, len, line);
+}
+
+// page up / down: the caret goes a view height up or down, keeping its
+// x, and the view scrolls as far as it went
+static void move_page(EditorState *ed, int dir) {
+    const Layout *lo = &ed->layout;
+    ViewIndex *v = &ed->view;
+    view_sync(ed, true);
+    Block *b = ed->focus;
+    const LineCache *c = block_lines(ed, b);
+    int line = caret_line(c, b->text, b->cursor_index);
+    float x = aim_x(ed, c, line);
+    int y = caret_y(ed, line);
+
+    // keep a line of the old page in view
+    int page = ed->height - ed->top - lo->line_height;
+    if (page < lo->line_height) page = lo->line_height;
+    int target = y + dir * page;
+    int total = view_top(v, v->slots);
+    if (target < 0) target = 0;
+    if (target >= total) target = total - 1;
+
+    int top;
+    Block *t = v->order[view_find(v, target, &top)];
+    c = block_lines(ed, t);
+    int t_line = (target - top - lo->pad) / lo->line_height;
+    if (target - top < lo->pad) t_line = 0;
+    if (t_line >= c->count) t_line = c->count - 1;
+    t->cursor_index = line_index_at(c, t->text, block_len(t), t_line, x);
+    ed->focus = t;
+    stick(ed, x);
+
+    ed->scroll_y += top + lo->pad + t_line * lo->line_height - y;
+    if (ed->scroll_y < 0) ed->scroll_y = 0;
+}
+
+static void backspace(EditorState *ed) {
+    Block *b = ed->focus;
+    if (b->cursor_index > 0) {
+        int n = utf8_prev_len(b->text, b->cursor_index);
+        block_erase(b, b->cursor_index - n, n);
+        b->cursor_index -= n;
+    } else if (b != ed->doc->start) {
+        // merge with previous block
+        ed->focus = merge_with_next(ed->doc, view_prev(ed, b));
+    }
+}
+
+static void delete_forward(EditorState *ed) {
+    Block *b = ed->focus;
+    int len = block_len(b);
+    if (b->cursor_index >= len) return;
+    int cp;
+    block_erase(b, b->cursor_index, utf8_decode(&b->text[b->cursor_index], len - b->cursor_index, &cp));
+}
+
+// ctrl+backspace / ctrl+delete: up to the word stop ctrl+left / right
+// would reach. at the block start the blocks merge as with backspace.
+static void delete_word(EditorState *ed, int dir) {
+    Block *b = ed->focus;
+    if (dir < 0 && b->cursor_index == 0) {
+        backspace(ed);
+        return;
+    }
+    WordBits w = block_words(b);
+    int at = b->cursor_index;
+    int stop = (dir > 0) ? word_next_end(&w, at) : word_prev_start(&w, at);
+    if (stop == at) return;
+    if (stop < at) {
+        block_erase(b, stop, at - stop);
+        b->cursor_index = stop;
+    } else {
+        block_erase(b, at, stop - at);
+    }
+}
+
+static void handle_key(EditorState *ed, int key, int mods) {
+    bool shift = (mods & INPUT_SHIFT) != 0;
+    bool ctrl = (mods & INPUT_CTRL) != 0;
+    switch (key) {
+    case INPUT_KEY_LEFT:
+    case INPUT_KEY_RIGHT:
+        begin_move(ed, shift);
+        if (ctrl) move_word(ed, key == INPUT_KEY_RIGHT ? 1 : -1);
+        else move_horizontal(ed, key == INPUT_KEY_RIGHT ? 1 : -1);
+        end_move(ed, shift);
+        break;
+    case INPUT_KEY_UP:
+    case INPUT_KEY_DOWN:
+        begin_move(ed, shift);
+        move_vertical(ed, key == INPUT_KEY_DOWN ? 1 : -1);
+        end_move(ed, shift);
+        break;
+    case INPUT_KEY_HOME:
+    case INPUT_KEY_END:
+        begin_move(ed, shift);
+        move_line_edge(ed, key == INPUT_KEY_END ? 1 : -1, ctrl);
+        end_move(ed, shift);
+        break;
+    case INPUT_KEY_PAGE_UP:
+    case INPUT_KEY_PAGE_DOWN:
+        begin_move(ed, shift);
+        move_page(ed, key == INPUT_KEY_PAGE_DOWN ? 1 : -1);
+        end_move(ed, shift);
+        break;
+    case INPUT_KEY_BACKSPACE:
+    case INPUT_KEY_DELETE:
+        // a selection goes first, alone
+        if (delete_selection(ed)) break;
+        if (ctrl) delete_word(ed, key == INPUT_KEY_DELETE ? 1 : -1);
+        else if (key == INPUT_KEY_BACKSPACE) backspace(ed);
+        else delete_forward(ed);
+        break;
+    case INPUT_KEY_ENTER:
+        delete_selection(ed);
+        if (shift) {
+            // soft break inside the block
+            block_insert(ed->focus, ed->focus->cursor_index, "\n", 1);
+            ed->focus->cursor_index++;
+        } else {
+            // hard enter: the rest of the block moves to a new one
+            ed->focus = split_block(ed->doc, ed->focus, ed->focus->cursor_index);
+        }
+        break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// events
+// ----------------------------------------------------------------------------
+
+static bool is_vertical(const InputEvent *ev) {
+    if (ev->type != INPUT_KEY) return false;
+    return ev->key == INPUT_KEY_UP || ev->key == INPUT_KEY_DOWN
+        || ev->key == INPUT_KEY_PAGE_UP || ev->key == INPUT_KEY_PAGE_DOWN;
+}
+
+bool editor_handle(EditorState *ed, const InputEvent *ev) {
+    // anything but a vertical move drops the column those aim for
+    if (!is_vertical(ev)) ed->sticky_block = NULL;
+
+    if (ev->type == INPUT_RESIZE) {
+        resize(ed, ev->x, ev->y);
+        return false;
+    }
+
+    if (ev->type == INPUT_MOUSE_PRESS || ev->type == INPUT_MOUSE_DRAG) {
+        Block *b;
+        int index;
+        if (!editor_hit_test(ed, ev->x, ev->y, &b, &index)) return false;
+        if (ev->type == INPUT_MOUSE_PRESS) {
+            ed->focus = b;
+            selection_begin(&ed->sel, b, index);
+            ed->last_action = ev->time;
+        } else if (ed->sel.anchor == NULL) {
+            return false;
+        }
+        b->cursor_index = index;
+        update_selection_range(ed->doc, &ed->sel, b, index);
+        return true;
+    }
+
+    if (ed->focus == NULL) return false;
+    Block *prev_focus = ed->focus;
+    int prev_cursor = ed->focus->cursor_index;
+    block_load(ed->focus);
+
+    switch (ev->type) {
+    case INPUT_CHAR: {
+        if ((ev->codepoint < 32 && ev->codepoint != '\t') || ev->codepoint == 127) return false;
+        delete_selection(ed);
+        char utf8[4];
+        int n = utf8_encode(ev->codepoint, utf8);
+        block_insert(ed->focus, ed->focus->cursor_index, utf8, n);
+        ed->focus->cursor_index += n;
+        break;
+    }
+    case INPUT_PASTE:
+        if (ev->text_len == 0) return false;
+        delete_selection(ed);
+        ed->focus = insert_text(ed->doc, ed->focus, ev->text, (size_t)ev->text_len);
+        break;
+    case INPUT_KEY:
+        handle_key(ed, ev->key, ev->mods);
+        break;
+    default:
+        return false;
+    }
+
+    // edits and loads update the view index as they go, once it exists
+    if (ed->view.built) view_sync(ed, false);
+
+    // reset blink on any interaction
+    ed->last_action = ev->time;
+    if (ed->focus != prev_focus || ed->focus->cursor_index != prev_cursor) ed->follow_cursor = true;
+    return true;
+}
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/frame_stats.h"
+#define ALLOC_SUBSYSTEM ALLOC_UI
+#include "include/alloc_stats.h"
+
+static const char *PHASE_NAMES[PHASE_COUNT] = { "input", "edit", "layout", "draw", "present" };
+
+void frame_stats_init(FrameStats *s) {
+    memset(s, 0, sizeof(FrameStats));
+    s->frame.input_time = -1;
+}
+
+void frame_stats_free(FrameStats *s) {
+    if (s->csv != NULL) fclose(s->csv);
+    s->csv = NULL;
+}
+
+bool frame_stats_csv(FrameStats *s, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return false;
+    if (s->csv != NULL) fclose(s->csv);
+    s->csv = f;
+    fprintf(f, "frame,start_s,events,latency_ms");
+    for (int p = 0; p < PHASE_COUNT; p++) fprintf(f, ",%s_ms", PHASE_NAMES[p]);
+    fprintf(f, ",draw_calls,glyphs,allocs,alloc_bytes");
+    for (int a = 0; a < ALLOC_SUBSYSTEMS; a++) fprintf(f, ",allocs_%s", alloc_subsystem_name(a));
+    fprintf(f, "\n");
+    return true;
+}
+
+void frame_stats_begin(FrameStats *s, double now) {
+    memset(&s->frame, 0, sizeof(FrameSample));
+    s->frame.start = now;
+    s->frame.input_time = -1;
+    s->mark = now;
+    alloc_stats_snapshot(&s->alloc_start);
+}
+
+void frame_stats_phase(FrameStats *s, FramePhase phase, double now) {
+    s->frame.phase[phase] += now - s->mark;
+    s->mark = now;
+}
+
+void frame_stats_move(FrameStats *s, FramePhase from, FramePhase to, double seconds) {
+    s->frame.phase[from] -= seconds;
+    s->frame.phase[to] += seconds;
+}
+
+void frame_stats_event(FrameStats *s, double time) {
+    if (s->frame.input_time < 0 || time < s->frame.input_time) s->frame.input_time = time;
+    s->frame.events++;
+}
+
+void frame_stats_end(FrameStats *s, double now) {
+    FrameSample *f = &s->frame;
+    AllocSnapshot alloc_end;
+    alloc_stats_snapshot(&alloc_end);
+    AllocCount allocs = alloc_stats_since(&s->alloc_start, &alloc_end, &f->allocs);
+    double latency = (f->input_time >= 0) ? now - f->input_time : -1;
+
+    s->history[s->next] = *f;
+    s->next = (s->next + 1) % FRAME_STATS_HISTORY;
+    if (s->count < FRAME_STATS_HISTORY) s->count++;
+    if (latency >= 0) {
+        s->latency[s->latency_next] = latency;
+        s->latency_next = (s->latency_next + 1) % FRAME_STATS_HISTORY;
+        if (s->latency_count < FRAME_STATS_HISTORY) s->latency_count++;
+    }
+
+    if (s->csv != NULL) {
+        fprintf(s->csv, "%lld,%.6f,%d,", s->frames, f->start, f->events);
+        if (latency >= 0) fprintf(s->csv, "%.3f", latency * 1000.0);
+        for (int p = 0; p < PHASE_COUNT; p++) fprintf(s->csv, ",%.3f", f->phase[p] * 1000.0);
+        fprintf(s->csv, ",%d,%d,%lld,%lld", f->draw_calls, f->glyphs, allocs.allocs, allocs.bytes);
+        for (int a = 0; a < ALLOC_SUBSYSTEMS; a++) fprintf(s->csv, ",%lld", f->allocs.sub[a].allocs);
+        fprintf(s->csv, "\n");
+    }
+    s->frames++;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void frame_stats_summary(const FrameStats *s, FrameSummary *out) {
+    memset(out, 0, sizeof(FrameSummary));
+    out->frames = s->count;
+    out->inputs = s->latency_count;
+    if (s->latency_count > 0) {
+        double sorted[FRAME_STATS_HISTORY];
+        int n = s->latency_count;
+        memcpy(sorted, s->latency, n * sizeof(double));
+        qsort(sorted, n, sizeof(double), cmp_double);
+        out->latency_p50 = sorted[(int)(0.5 * (n - 1) + 0.5)] * 1000.0;
+        out->latency_p99 = sorted[(int)(0.99 * (n - 1) + 0.5)] * 1000.0;
+    }
+    if (s->count == 0) return;
+    for (int i = 0; i < s->count; i++) {
+        for (int p = 0; p < PHASE_COUNT; p++) out->phase[p] += s->history[i].phase[p];
+        AllocSnapshot none = { 0 };
+        if (alloc_stats_since(&none, &s->history[i].allocs, NULL).allocs > 0) out->alloc_frames++;
+    }
+    for (int p = 0; p < PHASE_COUNT; p++) out->phase[p] = out->phase[p] * 1000.0 / s->count;
+    const FrameSample *last = &s->history[(s->next + FRAME_STATS_HISTORY - 1) % FRAME_STATS_HISTORY];
+    out->draw_calls = last->draw_calls;
+    out->glyphs = last->glyphs;
+    AllocSnapshot none = { 0 };
+    out->allocs = alloc_stats_since(&none, &last->allocs, NULL);
+    out->alloc_subsystems = &last->allocs;
+}
@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/glyph_cache.h"
+#include "include/rlgl.h"
+#define ALLOC_SUBSYSTEM ALLOC_GLYPHS
+#include "include/alloc_stats.h"
+
+#define ATLAS_WIDTH 512
+#define ATLAS_MAX_HEIGHT 4096
+#define ATLAS_PAD 2
+
+static unsigned int hash_cp(int cp) {
+    return (unsigned int)cp * 2654435761u;
+}
+
+static Glyph* slot_for(GlyphCache *gc, int cp) {
+    unsigned int mask = (unsigned int)gc->cap - 1;
+    unsigned int i = hash_cp(cp) & mask;
+    while (gc->slots[i].codepoint != 0 && gc->slots[i].codepoint != cp) i = (i + 1) & mask;
+    return &gc->slots[i];
+}
+
+static void grow_slots(GlyphCache *gc) {
+    Glyph *old = gc->slots;
+    int old_cap = gc->cap;
+    gc->cap = old_cap ? old_cap * 2 : 256;
+    gc->slots = (Glyph*)calloc(gc->cap, sizeof(Glyph));
+    for (int i = 0; i < old_cap; i++) {
+        if (old[i].codepoint != 0) *slot_for(gc, old[i].codepoint) = old[i];
+    }
+    free(old);
+}
+
+static Glyph* store(GlyphCache *gc, Glyph g) {
+    if (g.codepoint < 128) {
+        gc->ascii[g.codepoint] = g;
+        return &gc->ascii[g.codepoint];
+    }
+    if ((gc->count + 1) * 10 > gc->cap * 7) grow_slots(gc);
+    Glyph *s = slot_for(gc, g.codepoint);
+    if (s->codepoint == 0) gc->count++;
+    *s = g;
+    return s;
+}
+
+// same quad & advance DrawTextCodepoint / MeasureTextEx would use
+static Glyph base_glyph(GlyphCache *gc, int index) {
+    Font f = gc->base;
+    float scale = gc->size / (float)f.baseSize;
+    float pad = (float)f.glyphPadding;
+    Rectangle r = f.recs[index];
+    GlyphInfo info = f.glyphs[index];
+
+    Glyph g = { 0 };
+    g.codepoint = info.value;
+    g.src = (Rectangle){ r.x - pad, r.y - pad, r.width + 2*pad, r.height + 2*pad };
+    g.dst = (Rectangle){ (info.offsetX - pad)*scale, (info.offsetY - pad)*scale, g.src.width*scale, g.src.height*scale };
+    g.advance = (info.advanceX != 0) ? info.advanceX*scale : (r.width + info.offsetX)*scale;
+    return g;
+}
+
+// ----------------------------------------------------------------------------
+// on-demand atlas
+// ----------------------------------------------------------------------------
+
+static bool atlas_grow(GlyphCache *gc) {
+    int h = gc->atlas.height * 2;
+    if (h > ATLAS_MAX_HEIGHT) return false;
+
+    // queued quads still point at the old texture
+    rlDrawRenderBatchActive();
+    ImageResizeCanvas(&gc->atlas, gc->atlas.width, h, 0, 0, BLANK);
+    UnloadTexture(gc->atlas_texture);
+    gc->atlas_texture = LoadTextureFromImage(gc->atlas);
+    gc->dirty_y0 = gc->dirty_y1 = 0;
+    return true;
+}
+
+// reserves a w x h cell (shelf packing), returns false when the atlas is full
+static bool atlas_alloc(GlyphCache *gc, int w, int h, int *x, int *y) {
+    if (gc->atlas.data == NULL) {
+        gc->atlas = GenImageColor(ATLAS_WIDTH, ATLAS_WIDTH, BLANK);
+        ImageFormat(&gc->atlas, PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA);
+        memset(gc->atlas.data, 0, (size_t)gc->atlas.width * gc->atlas.height * 2);
+        gc->atlas_texture = LoadTextureFromImage(gc->atlas);
+    }
+    if (w > gc->atlas.width) return false;
+
+    if (gc->pack_x + w > gc->atlas.width) {
+        gc->pack_x = 0;
+        gc->pack_y += gc->row_h;
+        gc->row_h = 0;
+    }
+    while (gc->pack_y + h > gc->atlas.height) {
+        if (!atlas_grow(gc)) return false;
+    }
+
+    *x = gc->pack_x;
+    *y = gc->pack_y;
+    gc->pack_x += w;
+    if (h > gc->row_h) gc->row_h = h;
+    return true;
+}
+
+static void atlas_upload(GlyphCache *gc) {
+    if (gc->dirty_y1 <= gc->dirty_y0) return;
+    unsigned char *rows = (unsigned char*)gc->atlas.data + (size_t)gc->dirty_y0 * gc->atlas.width * 2;
+    Rectangle rec = { 0, (float)gc->dirty_y0, (float)gc->atlas.width, (float)(gc->dirty_y1 - gc->dirty_y0) };
+    UpdateTextureRec(gc->atlas_texture, rec, rows);
+    gc->dirty_y0 = gc->dirty_y1 = 0;
+}
+
+// rasterizes one codepoint from the ttf. NULL if the font has no glyph for it.
+static Glyph* rasterize(GlyphCache *gc, int cp) {
+    if (gc->font_data == NULL) return NULL;
+
+    GlyphInfo *info = LoadFontData(gc->font_data, gc->font_data_size, (int)gc->size, &cp, 1, FONT_DEFAULT);
+    if (info == NULL) return NULL;
+
+    Image img = info[0].image;
+    bool blank = (img.data == NULL || img.width == 0 || img.height == 0);
+    if (blank && info[0].advanceX == 0) { UnloadFontData(info, 1); return NULL; }
+
+    Glyph g = { 0 };
+    g.codepoint = cp;
+    g.dynamic = true;
+    g.advance = (info[0].advanceX != 0) ? (float)info[0].advanceX : (float)(img.width + info[0].offsetX);
+
+    if (!blank) {
+        int w = img.width + 2*ATLAS_PAD, h = img.height + 2*ATLAS_PAD;
+        int x, y;
+        if (!atlas_alloc(gc, w, h, &x, &y)) {
+            TraceLog(LOG_WARNING, "glyph atlas full, U+%04X drawn as '?'", cp);
+            UnloadFontData(info, 1);
+            return NULL;
+        }
+
+        // glyph bitmaps are 8-bit coverage, the atlas is white + alpha
+        unsigned char *dst = (unsigned char*)gc->atlas.data;
+        const unsigned char *src = (const unsigned char*)img.data;
+        for (int row = 0; row < img.height; row++) {
+            unsigned char *out = &dst[((size_t)(y + ATLAS_PAD + row) * gc->atlas.width + x + ATLAS_PAD) * 2];
+            for (int col = 0; col < img.width; col++) {
+                out[col*2] = 255;
+                out[col*2 + 1] = src[row*img.width + col];
+            }
+        }
+        if (gc->dirty_y1 <= gc->dirty_y0) { gc->dirty_y0 = y; gc->dirty_y1 = y + h; }
+        else {
+            if (y < gc->dirty_y0) gc->dirty_y0 = y;
+            if (y + h > gc->dirty_y1) gc->dirty_y1 = y + h;
+        }
+
+        g.src = (Rectangle){ (float)x, (float)y, (float)w, (float)h };
+        g.dst = (Rectangle){ (float)(info[0].offsetX - ATLAS_PAD), (float)(info[0].offsetY - ATLAS_PAD), (float)w, (float)h };
+    }
+
+    UnloadFontData(info, 1);
+    return store(gc, g);
+}
+
+// ----------------------------------------------------------------------------
+// api
+// ----------------------------------------------------------------------------
+
+const char* glyph_find_font(void) {
+    const char *env = getenv("TEXT_EDITOR_FONT");
+    if (env != NULL && FileExists(env)) return env;
+
+    static const char *candidates[] = {
+        "resources/font.ttf",
+        "C:/Windows/Fonts/malgun.ttf",
+        "C:/Windows/Fonts/arial.ttf",
+        "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+        "/usr/share/fonts/TTF/DejaVuSans.ttf",
+    };
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        if (FileExists(candidates[i])) return candidates[i];
+    }
+    return NULL;
+}
+
+void glyph_cache_init(GlyphCache *gc, const char *font_path, float size) {
+    memset(gc, 0, sizeof(*gc));
+    gc->size = size;
+    gc->base = GetFontDefault();
+
+    if (font_path != NULL) {
+        Font f = LoadFontEx(font_path, (int)size, NULL, 0);
+        if (f.texture.id != 0 && f.texture.id != GetFontDefault().texture.id) {
+            gc->base = f;
+            gc->owns_base = true;
+            gc->font_data = LoadFileData(font_path, &gc->font_data_size);
+        } else {
+            TraceLog(LOG_WARNING, "font %s: load failed, using default font", font_path);
+        }
+    }
+
+    grow_slots(gc);
+    for (int i = 0; i < gc->base.glyphCount; i++) {
+        if (gc->base.glyphs[i].value > 0) store(gc, base_glyph(gc, i));
+    }
+
+    // '?' stands in for anything the fonts can't draw
+    if (gc->ascii['?'].codepoint == 0) {
+        gc->ascii['?'] = base_glyph(gc, GetGlyphIndex(gc->base, '?'));
+        gc->ascii['?'].codepoint = '?';
+    }
+}
+
+void glyph_cache_free(GlyphCache *gc) {
+    if (gc->owns_base) UnloadFont(gc->base);
+    if (gc->font_data != NULL) UnloadFileData(gc->font_data);
+    if (gc->atlas.data != NULL) {
+        UnloadTexture(gc->atlas_texture);
+        UnloadImage(gc->atlas);
+    }
+    free(gc->slots);
+    memset(gc, 0, sizeof(*gc));
+}
+
+const Glyph* glyph_lookup(GlyphCache *gc, int codepoint) {
+    if (codepoint >= 0 && codepoint < 128) {
+        if (gc->ascii[codepoint].codepoint != 0) return &gc->ascii[codepoint];
+        return &gc->ascii['?'];  // control characters are never drawn
+    }
+
+    Glyph *g = slot_for(gc, codepoint);
+    if (g->codepoint == codepoint) return g;
+
+    g = rasterize(gc, codepoint);
+    if (g != NULL) return g;
+
+    // remember the miss so the ttf isn't searched again every frame
+    Glyph missing = gc->ascii['?'];
+    missing.codepoint = codepoint;
+    return store(gc, missing);
+}
+
+void glyph_draw(GlyphCache *gc, int codepoint, Vector2 pos, Color tint) {
+    const Glyph *g = glyph_lookup(gc, codepoint);
+    if (codepoint == ' ' || g->src.width <= 0) return;  // blank
+
+    Texture2D tex = gc->base.texture;
+    if (g->dynamic) {
+        atlas_upload(gc);
+        tex = gc->atlas_texture;
+    }
+    Rectangle dst = { pos.x + g->dst.x, pos.y + g->dst.y, g->dst.width, g->dst.height };
+    DrawTexturePro(tex, g->src, dst, (Vector2){ 0, 0 }, 0.0f, tint);
+}
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/highlight.h"
+#include "include/search.h"
+#define ALLOC_SUBSYSTEM ALLOC_SEARCH
+#include "include/alloc_stats.h"
+
+typedef struct {
+    int id;
+    unsigned key;        // versions of the blocks the matches were read from
+    unsigned frame;      // last frame it was asked for
+    Highlight *spans;
+    int count;
+} Entry;
+
+struct HighlightCache {
+    SearchQuery query;
+    int reach;           // blocks after the first one a match can read
+
+    Entry *entries;      // in the order they were asked for
+    int count, cap;
+    int hint;            // where the next lookup starts
+    unsigned frame;
+};
+
+HighlightCache* highlight_create(void) {
+    HighlightCache *h = (HighlightCache*)calloc(1, sizeof(HighlightCache));
+    search_query_init(&h->query, "", 0, 0);
+    h->frame = 1;
+    return h;
+}
+
+static void drop_entries(HighlightCache *h) {
+    for (int i = 0; i < h->count; i++) free(h->entries[i].spans);
+    h->count = 0;
+    h->hint = 0;
+}
+
+void highlight_free(HighlightCache *h) {
+    if (h == NULL) return;
+    drop_entries(h);
+    free(h->entries);
+    search_query_free(&h->query);
+    free(h);
+}
+
+void highlight_set_query(HighlightCache *h, const char *needle, int len, int flags) {
+    drop_entries(h);
+    search_query_free(&h->query);
+    search_query_init(&h->query, needle, len, flags);
+
+    // a crossing literal reads one more block per separator it contains
+    h->reach = 0;
+    if (h->query.cross_blocks && h->query.regex == NULL) {
+        for (int i = 0; i < h->query.len; i++) h->reach += (h->query.needle[i] == SEARCH_BLOCK_SEP);
+    }
+}
+
+static unsigned key_of(const HighlightCache *h, const Block *b) {
+    unsigned key = b->version;
+    const Block *n = b->next;
+    for (int i = 0; i < h->reach && n != NULL; i++, n = n->next) {
+        key = key * 31 + (unsigned)n->id * 2654435761u + n->version;
+    }
+    return key;
+}
+
+static Entry* lookup(HighlightCache *h, int id) {
+    // blocks are asked for in document order, frame after frame
+    for (int k = 0; k < h->count; k++) {
+        int i = (h->hint + k) % h->count;
+        if (h->entries[i].id == id) {
+            h->hint = i + 1;
+            return &h->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void compute(HighlightCache *h, Entry *e, Block *b) {
+    free(e->spans);
+    e->spans = NULL;
+    e->count = 0;
+    int cap = 0;
+    SearchMatch m;
+    int from = 0;
+    while (search_in_block(&h->query, b, from, &m)) {
+        if (e->count == cap) {
+            cap = cap ? cap * 2 : 8;
+            e->spans = (Highlight*)realloc(e->spans, cap * sizeof(Highlight));
+        }
+        e->spans[e->count++] = (Highlight){ m.start, m.end_block->id, m.end };
+        if (m.end_block != b) break;  // later matches would start inside it
+        from = m.end;
+    }
+}
+
+int highlight_block(HighlightCache *h, Block *b, const Highlight **out) {
+    *out = NULL;
+    if (h->query.len == 0) return 0;
+
+    unsigned key = key_of(h, b);
+    Entry *e = lookup(h, b->id);
+    if (e == NULL) {
+        if (h->count == h->cap) {
+            h->cap = h->cap ? h->cap * 2 : 64;
+            h->entries = (Entry*)realloc(h->entries, h->cap * sizeof(Entry));
+        }
+        e = &h->entries[h->count++];
+        *e = (Entry){ b->id, key, 0, NULL, 0 };
+        compute(h, e, b);
+        h->hint = h->count;
+    } else if (e->key != key) {
+        e->key = key;
+        compute(h, e, b);
+    }
+    e->frame = h->frame;
+    *out = e->spans;
+    return e->count;
+}
+
+void highlight_end_frame(HighlightCache *h) {
+    int kept = 0;
+    for (int i = 0; i < h->count; i++) {
+        if (h->entries[i].frame == h->frame) h->entries[kept++] = h->entries[i];
+        else free(h->entries[i].spans);
+    }
+    h->count = kept;
+    h->hint = 0;
+    h->frame++;
+}
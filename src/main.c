@@ -2,727 +2,892 @@
  * text editor in c (raylib)
  * -------------------------
  * organization:
- * 1. includes & structs
- * 2. prototypes
- * 3. selection logic (core)
- * 4. memory management
- * 5. input processing
- * 6. selection state
- * 7. main loop & rendering
+ * 1. includes & globals
+ * 2. platform input (raylib -> editor events)
+ * 3. find & replace bar
+ * 4. main loop & rendering
+ *
+ * the editor core is headless and lives elsewhere: blocks & document
+ * list in block.c / document.c, selection in selection.c, layout in
+ * render.c, editing through input events in editor_state.c.
+ * file loading & saving in docfile.c, glyphs in glyph_cache.c,
+ * search in search.c, match highlights in highlight.c, input traces in
+ * trace.c, frame timing in frame_stats.c, bookmarks in marker.c.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "include/raylib.h"
+#include "include/document.h"
+#include "include/docfile.h"
+#include "include/editor_state.h"
+#include "include/utf8.h"
+#include "include/glyph_cache.h"
+#include "include/search.h"
+#include "include/search_job.h"
+#include "include/threadpool.h"
+#include "include/trigram.h"
+#include "include/highlight.h"
+#include "include/trace.h"
+#include "include/frame_stats.h"
+#include "include/profile.h"
+#include "include/scratch.h"
+#include "include/marker.h"
+#define ALLOC_SUBSYSTEM ALLOC_UI
+#include "include/alloc_stats.h"
 
 // ============================================================================
-// 1. data & prototypes
+// 1. includes & globals
 // ============================================================================
 
-typedef struct Block {
-    int id;
-    char *text;
-    int cursor_index;
-    struct Block *next; 
-    
-    // selection state (-1 = none)
-    int sel_start;
-    int sel_len;        
-} Block;
-
-typedef struct {
-    Block *start;
-    Block *end;
-    int id_counter;
-} Document;
-
-Block *anchor_block = NULL; 
-int anchor_index = 0;
-
-void update_selection_range(Document *doc, Block *current_hover, int current_index);
-Block* delete_selected_text(Document *doc);
+EditorState editor;
+GlyphCache glyphs;
+ThreadPool *workers = NULL;
+TrigramIndex *trigrams = NULL;    // search index, NULL until built (or disabled)
+TrigramJob *trigram_job = NULL;
+HighlightCache *highlights = NULL;  // find bar matches around the viewport
+TraceWriter *recorder = NULL;       // input trace, when TEXT_EDITOR_TRACE names a file
+FrameStats stats;                   // phase times & input latency (f12 shows them)
+bool show_stats = false;
 
 // ============================================================================
-// 2. core logic: selection & memory surgery
+// 2. platform input (raylib -> editor events)
 // ============================================================================
 
-// deletes selected range. returns surviving block to update focus.
-Block* delete_selected_text(Document *doc) {
-    Block *b = doc->start;
-    Block *first = NULL;
-    Block *last = NULL;
-    bool has_selection = false;
-
-    // find selection bounds
-    while (b != NULL) {
-        if (b->sel_start != -1) {
-            if (first == NULL) first = b;
-            last = b;
-            if (b->sel_len > 0) has_selection = true;
-        }
-        b = b->next;
+// layout measures through the glyph cache (and a recording keeps the
+// advances, the replay has no font)
+static float measure_glyph(void *user, int codepoint) {
+    float advance = glyph_advance((GlyphCache*)user, codepoint);
+    if (recorder != NULL) trace_measure(recorder, codepoint, advance);
+    return advance;
+}
+
+// bad utf-8 is kept and drawn as U+FFFD, but reported up front
+static void warn_invalid_utf8(const char *text, size_t len) {
+    size_t bad[8];
+    Utf8Info info = utf8_check(text, len, bad, 8);
+    for (size_t i = 0; i < info.error_count && i < 8; i++) {
+        TraceLog(LOG_WARNING, "inserted text: invalid utf-8 at byte %zu", bad[i]);
     }
+}
 
-    // ignore 0-length selection (cursor only)
-    if (first != NULL && first == last && first->sel_len == 0) return NULL;
-    if (first != last && first != NULL) has_selection = true;
-    if (!has_selection) return NULL;
-
-    // scenario: single block (simple memmove)
-    if (first == last) {
-        int text_len = strlen(first->text);
-        int remove_len = first->sel_len;
-        
-        // safety clamp
-        if (first->sel_start + remove_len > text_len) {
-            remove_len = text_len - first->sel_start;
-        }
+// held keys repeat on our own schedule: after `delay`, then every `rate`.
+// keys sharing *next share the schedule.
+static bool key_fires(int key, double now, double *next, double delay, double rate) {
+    if (IsKeyPressed(key)) { *next = now + delay; return true; }
+    if (IsKeyDown(key) && now > *next) { *next = now + rate; return true; }
+    return false;
+}
 
-        memmove(&first->text[first->sel_start], 
-                &first->text[first->sel_start + remove_len], 
-                text_len - (first->sel_start + remove_len) + 1);
-        
-        first->cursor_index = first->sel_start;
-        first->sel_start = -1; 
-        first->sel_len = 0;
-        return first; 
+static void poll_keyboard(InputQueue *q, double now) {
+    static double next_horiz_time = 0;
+    static double next_vert_time = 0;
+    static double next_del_time = 0;
+    static double next_page_time = 0;
+    static double next_tab_time = 0;
+
+    bool is_shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+    bool is_ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+    InputEvent ev = { .type = INPUT_KEY, .mods = (is_shift ? INPUT_SHIFT : 0) | (is_ctrl ? INPUT_CTRL : 0), .time = now };
+
+    // horizontal navigation
+    if (key_fires(KEY_RIGHT, now, &next_horiz_time, 0.4, 0.04)) { ev.key = INPUT_KEY_RIGHT; input_push(q, ev); }
+    if (key_fires(KEY_LEFT, now, &next_horiz_time, 0.4, 0.04)) { ev.key = INPUT_KEY_LEFT; input_push(q, ev); }
+
+    // character insertion
+    int key = GetCharPressed();
+    while (key > 0) {
+        input_push(q, (InputEvent){ .type = INPUT_CHAR, .codepoint = key, .mods = ev.mods, .time = now });
+        key = GetCharPressed();
     }
 
-    // scenario: multi-block (complex merge)
-    
-    // 1. save tail from last block
-    int tail_start = last->sel_len;
-    if (tail_start > (int)strlen(last->text)) tail_start = strlen(last->text);
-    char *tail_text = strdup(&last->text[tail_start]);
-
-    // 2. delete intermediate nodes manually
-    Block *block_after_selection = last->next;
-    Block *curr = first->next;
-    
-    while (curr != NULL && curr != block_after_selection) {
-        Block *next_node = curr->next;
-        free(curr->text);
-        free(curr);
-        curr = next_node;
+    // tab is a key, not a char: GetCharPressed never reports it
+    if (key_fires(KEY_TAB, now, &next_tab_time, 0.5, 0.05)) {
+        input_push(q, (InputEvent){ .type = INPUT_CHAR, .codepoint = '\t', .mods = ev.mods, .time = now });
     }
 
-    // 3. merge tail into first block
-    first->text[first->sel_start] = '\0';
-    int first_len = strlen(first->text);
-    int tail_len = strlen(tail_text);
-    
-    first->text = (char*)realloc(first->text, first_len + tail_len + 1);
-    strcat(first->text, tail_text);
-    free(tail_text);
-
-    // 4. reconnect list
-    first->next = block_after_selection;
-    if (block_after_selection == NULL) doc->end = first;
-
-    first->cursor_index = first->sel_start;
-    first->sel_start = -1; 
-    first->sel_len = 0;
-    return first;
+    // paste (ctrl+v)
+    if (is_ctrl && IsKeyPressed(KEY_V)) {
+        const char *clip = GetClipboardText();
+        if (clip != NULL && clip[0] != '\0') {
+            int len = strlen(clip);
+            warn_invalid_utf8(clip, len);
+            input_push(q, (InputEvent){ .type = INPUT_PASTE, .text = clip, .text_len = len, .mods = ev.mods, .time = now });
+        }
+    }
+
+    // enter (shift: soft break)
+    if (IsKeyPressed(KEY_ENTER)) { ev.key = INPUT_KEY_ENTER; input_push(q, ev); }
+
+    // backspace / delete
+    if (key_fires(KEY_BACKSPACE, now, &next_del_time, 0.5, 0.05)) { ev.key = INPUT_KEY_BACKSPACE; input_push(q, ev); }
+    if (key_fires(KEY_DELETE, now, &next_del_time, 0.5, 0.05)) { ev.key = INPUT_KEY_DELETE; input_push(q, ev); }
+
+    // vertical navigation
+    if (key_fires(KEY_UP, now, &next_vert_time, 0.4, 0.05)) { ev.key = INPUT_KEY_UP; input_push(q, ev); }
+    if (key_fires(KEY_DOWN, now, &next_vert_time, 0.4, 0.05)) { ev.key = INPUT_KEY_DOWN; input_push(q, ev); }
+
+    // line / document ends (ctrl), pages
+    if (IsKeyPressed(KEY_HOME)) { ev.key = INPUT_KEY_HOME; input_push(q, ev); }
+    if (IsKeyPressed(KEY_END)) { ev.key = INPUT_KEY_END; input_push(q, ev); }
+    if (key_fires(KEY_PAGE_UP, now, &next_page_time, 0.4, 0.08)) { ev.key = INPUT_KEY_PAGE_UP; input_push(q, ev); }
+    if (key_fires(KEY_PAGE_DOWN, now, &next_page_time, 0.4, 0.08)) { ev.key = INPUT_KEY_PAGE_DOWN; input_push(q, ev); }
+}
+
+// click places the cursor and anchors a selection, dragging extends it
+static void poll_mouse(InputQueue *q, double now) {
+    InputType type;
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) type = INPUT_MOUSE_PRESS;
+    else if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) type = INPUT_MOUSE_DRAG;
+    else return;
+    Vector2 mouse = GetMousePosition();
+    input_push(q, (InputEvent){ .type = type, .x = mouse.x, .y = mouse.y, .time = now });
 }
 
 // ============================================================================
-// 3. list management
+// 3. find & replace bar
 // ============================================================================
 
-Document* create_document() {
-    Document *doc = (Document*)malloc(sizeof(Document));
-    if (doc == NULL) return NULL;
-    doc->start = NULL;
-    doc->end = NULL;
-    doc->id_counter = 0;
-    return doc;
+// opened files get a trigram index, built in the background, so repeated
+// searches only scan blocks that can match. TEXT_EDITOR_INDEX_MB sets
+// its memory budget, 0 turns it off.
+static size_t index_budget(void) {
+    const char *env = getenv("TEXT_EDITOR_INDEX_MB");
+    return env ? (size_t)atoi(env) << 20 : TRIGRAM_INDEX_BYTES;
 }
 
-Block* create_block(int id, char *text_content) {
-    Block *new_block = (Block*)malloc(sizeof(Block));
-    new_block->id = id;
-    new_block->text = strdup(text_content);
-    new_block->next = NULL;
-    new_block->cursor_index = strlen(text_content);
-    new_block->sel_start = -1;
-    new_block->sel_len = 0;
-    return new_block;
+static void start_indexing(Document *doc) {
+    trigram_job_free(trigram_job);
+    trigram_job = (index_budget() > 0) ? trigram_job_start(workers, doc, index_budget()) : NULL;
 }
 
-void add_block(Document *doc, char *text) {
-    doc->id_counter++;
-    Block *new_block = create_block(doc->id_counter, text);
-    if (doc->start == NULL) {
-        doc->start = new_block;
-        doc->end = new_block;
-    } else {
-        doc->end->next = new_block;
-        doc->end = new_block;
+static void poll_indexing(Document *doc) {
+    if (trigram_job == NULL) {
+        if (trigrams != NULL && trigram_index_wants_rebuild(trigrams)) start_indexing(doc);
+        return;
     }
+    TrigramIndex *ix = trigram_job_take(trigram_job);
+    if (ix == NULL) return;
+    trigram_index_free(trigrams);
+    trigrams = ix;
+    trigram_job_free(trigram_job);
+    trigram_job = NULL;
+    TraceLog(LOG_INFO, "search index ready (%zu KB)", trigram_index_bytes(trigrams) >> 10);
 }
 
-void insert_block_after(Document *doc, Block *prev_block, char *text) {
-    doc->id_counter++;
-    Block *new_block = create_block(doc->id_counter, text);
+// ctrl+f find, ctrl+h find & replace. enter / f3 = next, enter in the
+// replace field replaces the current match, ctrl+enter replaces all,
+// ctrl+b toggles matching across blocks (\n in the query is the break
+// between two blocks, \\ a backslash), ctrl+r toggles regex patterns
+// (the replacement may use $1..$9), tab switches fields, esc closes.
+// matches around the viewport are highlighted right away. the total
+// count runs in the background on the worker pool once the query has
+// been left alone for SEARCH_COUNT_DELAY, so typing a query does not
+// start (and cancel) a scan of the whole document per keystroke. its
+// first hit is selected as soon as it streams in.
+#define SEARCH_COUNT_DELAY 0.2   // seconds
+typedef struct {
+    bool open;
+    bool replace_mode;
+    int field;               // 0 = find, 1 = replace
+    char text[2][256];
+    char needle[256];        // the query searched for, text[0] unescaped
+    int needle_len;
+    bool cross_blocks;
+    bool regex;
+    bool has_match;
+    SearchMatch match;       // currently selected match
+    char status[64];
+
+    SearchJob *job;          // background scan of the current query
+    int hit_count;
+    bool scanning;
+    bool jumped;             // first streamed hit already selected
+    bool count_pending;      // query changed, count starts at query_time + SEARCH_COUNT_DELAY
+    double query_time;
+} FindBar;
+
+static int query_flags(const FindBar *fb) {
+    return (fb->cross_blocks ? SEARCH_CROSS_BLOCKS : 0) | (fb->regex ? SEARCH_REGEX : 0);
+}
 
-    if (prev_block == NULL) {
-        new_block->next = doc->start;
-        doc->start = new_block;
-        if (doc->end == NULL) doc->end = new_block;
-    } else {
-        new_block->next = prev_block->next;
-        prev_block->next = new_block;
-        if (prev_block == doc->end) doc->end = new_block;
+// across blocks, a plain query spells the block break \n (the field
+// takes no control characters); a regex has its own escapes
+static void needle_update(FindBar *fb) {
+    const char *t = fb->text[0];
+    int n = 0;
+    for (int i = 0; t[i] != '\0'; i++) {
+        char c = t[i];
+        if (fb->cross_blocks && !fb->regex && c == '\\' && (t[i + 1] == 'n' || t[i + 1] == '\\')) {
+            c = (t[++i] == 'n') ? SEARCH_BLOCK_SEP : '\\';
+        }
+        fb->needle[n++] = c;
     }
+    fb->needle[n] = '\0';
+    fb->needle_len = n;
 }
 
-void free_document(Document *doc) {
-    Block *current = doc->start;
-    while (current != NULL) {
-        Block *temp_next = current->next; 
-        free(current->text); 
-        free(current);       
-        current = temp_next;
+static void stop_search(FindBar *fb) {
+    search_job_free(fb->job);
+    fb->job = NULL;
+    fb->scanning = false;
+    fb->count_pending = false;
+}
+
+static void restart_search(Document *doc, FindBar *fb, bool jump) {
+    stop_search(fb);
+    fb->hit_count = 0;
+    fb->jumped = !jump;
+    int len = fb->needle_len;
+    highlight_set_query(highlights, fb->needle, len, query_flags(fb));
+    if (len == 0) return;
+    if (fb->regex) {
+        // report a bad pattern instead of counting nothing
+        SearchQuery q;
+        bool ok = search_query_init(&q, fb->needle, len, query_flags(fb));
+        if (!ok) snprintf(fb->status, sizeof(fb->status), "%s", q.error);
+        search_query_free(&q);
+        if (!ok) return;
     }
-    free(doc);
+    fb->job = search_job_start(workers, doc, fb->needle, len, query_flags(fb), trigrams);
+    fb->scanning = true;
 }
 
-// ============================================================================
-// 4. input logic
-// ============================================================================
+static void select_match(Document *doc, const SearchMatch *m, Block **focus) {
+    block_load(m->block);
+    block_load(m->end_block);
+    selection_begin(&editor.sel, m->block, m->start);
+    m->end_block->cursor_index = m->end;
+    update_selection_range(doc, &editor.sel, m->end_block, m->end);
+    *focus = m->end_block;
+}
 
-Block* update_typing(Document *doc, Block *b, double *last_action_time){ 
-    double now = GetTime();
-    int maxWidth = 680;
+static bool find_next(Document *doc, FindBar *fb, Block **focus) {
+    SearchQuery q;
+    bool valid = search_query_init(&q, fb->needle, fb->needle_len, query_flags(fb));
 
-    // reset blink on any interaction
-    if (IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_LEFT) || 
-        IsKeyDown(KEY_UP) || IsKeyDown(KEY_DOWN) || 
-        IsKeyDown(KEY_BACKSPACE) || IsKeyDown(KEY_DELETE) ||
-        IsKeyDown(KEY_ENTER)) {
-        *last_action_time = now;
+    Block *from = fb->has_match ? fb->match.end_block : (*focus ? *focus : doc->start);
+    int from_index = fb->has_match ? fb->match.end : from->cursor_index;
+    fb->has_match = q.len > 0 && search_next(doc, &q, from, from_index, &fb->match);
+
+    if (fb->has_match) {
+        select_match(doc, &fb->match, focus);
+        fb->status[0] = '\0';
+    } else {
+        snprintf(fb->status, sizeof(fb->status), "%s", valid ? "no matches" : q.error);
     }
+    search_query_free(&q);
+    return fb->has_match;
+}
 
-    // --- SHIFT STATE ---
-    bool is_shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
-    bool moved = false; // flag to trigger selection update
+// highlights follow the query at once, the count waits (see above)
+static void query_edited(FindBar *fb) {
+    stop_search(fb);
+    fb->hit_count = 0;
+    fb->jumped = false;
+    fb->count_pending = true;
+    fb->query_time = GetTime();
+    needle_update(fb);
+    highlight_set_query(highlights, fb->needle, fb->needle_len, query_flags(fb));
+}
 
-    // 1. Setup Anchor (Start Selection)
-    if (is_shift && anchor_block == NULL) {
-        anchor_block = b;
-        anchor_index = b->cursor_index;
+// picks up streamed hits. returns true when it selected one.
+static bool poll_search(Document *doc, FindBar *fb, Block **focus) {
+    if (fb->count_pending && GetTime() - fb->query_time >= SEARCH_COUNT_DELAY) {
+        restart_search(doc, fb, true);
     }
+    if (fb->job == NULL) return false;
+    bool done;
+    fb->hit_count = search_job_poll(fb->job, &done);
+    fb->scanning = !done;
+    if (fb->jumped || fb->hit_count == 0) return false;
+
+    // hits describe the snapshot, check them against the live text
+    const SearchHit *h = &search_job_hits(fb->job)[0];
+    SearchQuery q;
+    search_query_init(&q, fb->needle, fb->needle_len, query_flags(fb));
+    SearchMatch m = { .block = find_block(doc, h->block_id), .start = h->start,
+                      .end_block = find_block(doc, h->end_block_id), .end = h->end };
+    bool valid = m.block != NULL && m.end_block != NULL && search_verify(&q, &m);
+    search_query_free(&q);
+
+    fb->jumped = true;
+    if (!valid) return false;
+    fb->match = m;
+    fb->has_match = true;
+    fb->status[0] = '\0';
+    select_match(doc, &m, focus);
+    return true;
+}
 
-    // 2. Clear Selection (If moving without Shift)
-    // We check this inside the movement blocks to avoid clearing just by pressing keys without moving
-    
-    // ------------------------------------------------------------------------
-    // Horizontal Navigation
-    // ------------------------------------------------------------------------
-    static double next_horiz_time = 0; 
-    bool move_r = false;
-    bool move_l = false;
-
-    if (IsKeyPressed(KEY_RIGHT)) { move_r = true; next_horiz_time = now + 0.4; }
-    else if (IsKeyDown(KEY_RIGHT) && now > next_horiz_time) { move_r = true; next_horiz_time = now + 0.04; }
-
-    if (IsKeyPressed(KEY_LEFT)) { move_l = true; next_horiz_time = now + 0.4; }
-    else if (IsKeyDown(KEY_LEFT) && now > next_horiz_time) { move_l = true; next_horiz_time = now + 0.04; }
-    
-    if (move_r || move_l) {
-        if (!is_shift) { // Clear selection if moving without shift
-            anchor_block = NULL;
-            for (Block *t = doc->start; t; t = t->next) { t->sel_start = -1; t->sel_len = 0; }
-        }
-        
-        if (move_r && b->cursor_index < (int)strlen(b->text)) b->cursor_index++;
-        if (move_l && b->cursor_index > 0) b->cursor_index--;
-        
-        moved = true;
-    }
+// returns true when the focus / selection moved
+bool update_find_bar(Document *doc, FindBar *fb, Block **focus) {
+    bool is_ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+    char *field = fb->text[fb->field];
+    int len = strlen(field);
+    bool query_changed = false;
 
-    // ------------------------------------------------------------------------
-    // Character Insertion (Type to replace selection)
-    // ------------------------------------------------------------------------
     int key = GetCharPressed();
     while (key > 0) {
-        if (key >= 32 && key <= 125) {
-            // If text is selected, delete it before typing
-            Block *survivor = delete_selected_text(doc);
-            if (survivor) b = survivor;
-
-            int len = strlen(b->text);
-            b->text = (char*)realloc(b->text, len + 2);
-            memmove(&b->text[b->cursor_index + 1], &b->text[b->cursor_index], len - b->cursor_index + 1);
-            b->text[b->cursor_index] = (char)key;
-            b->cursor_index++;
-            *last_action_time = now;
-            
-            // Clear anchor after typing
-            anchor_block = NULL;
+        char utf8[4];
+        int n = utf8_encode(key, utf8);
+        if (key >= 32 && key != 127 && len + n < (int)sizeof(fb->text[0])) {
+            memcpy(&field[len], utf8, n);
+            len += n;
+            field[len] = '\0';
+            fb->has_match = false;
+            query_changed |= (fb->field == 0);
         }
         key = GetCharPressed();
     }
 
-    // ------------------------------------------------------------------------
-    // Shift+Enter (Soft Break)
-    // ------------------------------------------------------------------------
-    if (IsKeyPressed(KEY_ENTER) && (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT))) {
-        // Delete selection if exists
-        Block *survivor = delete_selected_text(doc);
-        if (survivor) b = survivor;
-
-        int len = strlen(b->text);
-        b->text = (char*)realloc(b->text, len + 2);
-        memmove(&b->text[b->cursor_index + 1], &b->text[b->cursor_index], len - b->cursor_index + 1);
-        b->text[b->cursor_index] = '\n';
-        b->cursor_index++;
-        anchor_block = NULL;
+    if ((IsKeyPressed(KEY_BACKSPACE) || IsKeyPressedRepeat(KEY_BACKSPACE)) && len > 0) {
+        field[len - utf8_prev_len(field, len)] = '\0';
+        fb->has_match = false;
+        query_changed |= (fb->field == 0);
     }
-
-    // ------------------------------------------------------------------------
-    // Backspace / Delete
-    // ------------------------------------------------------------------------
-    static double next_del_time = 0;
-    bool do_back = false; 
-    bool do_del = false;
-
-    if (IsKeyPressed(KEY_BACKSPACE)) { do_back = true; next_del_time = now + 0.5; }
-    else if (IsKeyDown(KEY_BACKSPACE) && now > next_del_time) { do_back = true; next_del_time = now + 0.05; }
-
-    if (IsKeyPressed(KEY_DELETE)) { do_del = true; next_del_time = now + 0.5; }
-    else if (IsKeyDown(KEY_DELETE) && now > next_del_time) { do_del = true; next_del_time = now + 0.05; }
-
-    // try selection delete first
-    if (do_back || do_del) {
-        Block *survivor = delete_selected_text(doc);
-        if (survivor != NULL) {
-            *last_action_time = now;
-            anchor_block = NULL; // Clear anchor after delete
-            return survivor; 
-        }
+    if (IsKeyPressed(KEY_TAB) && fb->replace_mode) fb->field = 1 - fb->field;
+    if (is_ctrl && IsKeyPressed(KEY_B)) {
+        fb->cross_blocks = !fb->cross_blocks;
+        fb->has_match = false;
+        query_changed = true;
     }
-
-    // fallback: normal backspace
-    if (do_back) {
-        if (b->cursor_index > 0) {
-            int len = strlen(b->text);
-            memmove(&b->text[b->cursor_index - 1], &b->text[b->cursor_index], len - b->cursor_index + 1);
-            b->cursor_index--;
-        } 
-        else if (b->cursor_index == 0 && b != doc->start) {
-            // merge with previous block
-            Block *prev = doc->start;
-            while (prev->next != b) prev = prev->next;
-            
-            int prev_len = strlen(prev->text);
-            prev->text = (char*)realloc(prev->text, prev_len + strlen(b->text) + 1);
-            strcat(prev->text, b->text);
-            
-            prev->next = b->next;
-            if (b == doc->end) doc->end = prev;
-            free(b->text); 
-            free(b);
-            
-            prev->cursor_index = prev_len;
-            return prev;
-        }
+    if (is_ctrl && IsKeyPressed(KEY_R)) {
+        fb->regex = !fb->regex;
+        fb->has_match = false;
+        query_changed = true;
     }
-
-    if (do_del && b->cursor_index < (int)strlen(b->text)) {
-        int len = strlen(b->text);
-        memmove(&b->text[b->cursor_index], &b->text[b->cursor_index + 1], len - b->cursor_index);
+    if (query_changed) {
+        fb->status[0] = '\0';
+        query_edited(fb);
     }
 
-    // ------------------------------------------------------------------------
-    // Vertical Navigation
-    // ------------------------------------------------------------------------
-    static double next_vert_time = 0;
-    int dir = 0; 
-    bool proc_y = false;
-
-    if (IsKeyPressed(KEY_UP)) { dir = -1; proc_y = true; next_vert_time = now + 0.4; }
-    else if (IsKeyDown(KEY_UP) && now > next_vert_time) { dir = -1; proc_y = true; next_vert_time = now + 0.05; }
-
-    if (IsKeyPressed(KEY_DOWN)) { dir = 1; proc_y = true; next_vert_time = now + 0.4; }
-    else if (IsKeyDown(KEY_DOWN) && now > next_vert_time) { dir = 1; proc_y = true; next_vert_time = now + 0.05; }
+    bool enter = IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_KP_ENTER);
+    if (!enter && !IsKeyPressed(KEY_F3)) return poll_search(doc, fb, focus);
+
+    if (fb->field == 1 && enter && is_ctrl) {
+        // replace all
+        SearchQuery q;
+        search_query_init(&q, fb->needle, fb->needle_len, query_flags(fb));
+        selection_clear(&editor.sel, doc);
+        int count = (q.len > 0) ? search_replace_all(doc, &q, fb->text[1], strlen(fb->text[1]), focus) : 0;
+        search_query_free(&q);
+        fb->has_match = false;
+        snprintf(fb->status, sizeof(fb->status), "%d replaced", count);
+        restart_search(doc, fb, false);
+        return true;
+    }
 
-    if (proc_y) {
-        if (!is_shift) { // Clear selection if moving without shift
-            anchor_block = NULL;
-            for (Block *t = doc->start; t; t = t->next) { t->sel_start = -1; t->sel_len = 0; }
+    if (fb->field == 1 && enter && fb->has_match) {
+        SearchQuery q;
+        search_query_init(&q, fb->needle, fb->needle_len, query_flags(fb));
+        bool still_there = search_verify(&q, &fb->match);
+
+        if (still_there) {
+            selection_clear(&editor.sel, doc);
+            Block *b = search_replace(doc, &q, &fb->match, fb->text[1], strlen(fb->text[1]));
+            search_query_free(&q);
+            *focus = b;
+            fb->has_match = false;
+            restart_search(doc, fb, false);
+            if (!find_next(doc, fb, focus)) *focus = b;
+            return true;
         }
-        
-        moved = true; // Mark as moved to update selection later
-
-        int current_line = 0; 
-        float desired_x = 0; 
-        float scan_x = 0;
-        int scan_line = 0;
-        
-        // find current visual position
-        for (int i = 0; i < b->cursor_index; i++) {
-            float w = MeasureTextEx(GetFontDefault(), (char[2]){b->text[i], '\0'}, 20, 1.0f).x;
-            if (b->text[i] == '\n' || scan_x + w > maxWidth) { 
-                scan_line++; 
-                scan_x = 0; 
-                if (b->text[i] == '\n') continue; 
-            }
-            scan_x += w + 1.0f;
-        }
-        current_line = scan_line;
-        desired_x = scan_x;
-
-        // calc total lines in block
-        int total_lines_in_block = 0;
-        {
-            float tx = 0; int tl = 0;
-            for (int i = 0; b->text[i] != '\0'; i++) {
-                float w = MeasureTextEx(GetFontDefault(), (char[2]){b->text[i], '\0'}, 20, 1.0f).x;
-                if (b->text[i] == '\n' || tx + w > maxWidth) { tl++; tx = 0; if (b->text[i] == '\n') continue; }
-                tx += w + 1.0f;
-            }
-            total_lines_in_block = tl;
-        }
-
-        int target_line = current_line + dir;
-
-        // handle block switching
-        if (target_line < 0) {
-            Block *prev = NULL;
-            if (b != doc->start) {
-                prev = doc->start;
-                while (prev->next != b) prev = prev->next;
-            }
+        search_query_free(&q);
+    }
 
-            if (prev != NULL) {
-                b = prev; 
-                int prev_lines = 0;
-                float tx = 0; 
-                for (int i = 0; b->text[i] != '\0'; i++) {
-                    float w = MeasureTextEx(GetFontDefault(), (char[2]){b->text[i], '\0'}, 20, 1.0f).x;
-                    if (b->text[i] == '\n' || tx + w > maxWidth) { prev_lines++; tx = 0; if (b->text[i] == '\n') continue; }
-                    tx += w + 1.0f;
-                }
-                target_line = prev_lines; 
-            } else {
-                target_line = 0; 
-            }
-        }
-        else if (target_line > total_lines_in_block) {
-            if (b->next != NULL) {
-                b = b->next; 
-                target_line = 0; 
-            } else {
-                target_line = total_lines_in_block; 
-            }
-        }
+    return find_next(doc, fb, focus);
+}
 
-        // apply position
-        int best_index = b->cursor_index; 
-        float min_dist = 100000.0f;
-        scan_line = 0; 
-        scan_x = 0;
-        
-        if (strlen(b->text) == 0) best_index = 0;
-        else {
-            bool found_line = false;
-            int len = strlen(b->text);
-            for (int i = 0; i <= len; i++) {
-                if (scan_line == target_line) {
-                    found_line = true;
-                    float dist = (desired_x > scan_x) ? (desired_x - scan_x) : (scan_x - desired_x);
-                    if (dist < min_dist) { min_dist = dist; best_index = i; }
-                }
-                else if (scan_line > target_line) break;
-
-                if (i < len) {
-                    char c = b->text[i];
-                    float w = MeasureTextEx(GetFontDefault(), (char[2]){c, '\0'}, 20, 1.0f).x;
-                    if (c == '\n' || scan_x + w > maxWidth) { 
-                        scan_line++; 
-                        scan_x = 0; 
-                        if (c == '\n') continue; 
-                    }
-                    scan_x += w + 1.0f;
-                }
-            }
-            if (!found_line && target_line >= scan_line) best_index = len;
-        }
-        b->cursor_index = best_index;
-        *last_action_time = now;
+static float draw_string(const char *s, float x, float y, Color tint) {
+    int len = strlen(s);
+    int n = 1;
+    for (int i = 0; i < len; i += n) {
+        int cp = (unsigned char)s[i];
+        n = (cp < 0x80) ? 1 : utf8_decode(&s[i], len - i, &cp);
+        glyph_draw(&glyphs, cp, (Vector2){ (float)(int)x, (float)(int)y }, tint);
+        x += glyph_advance(&glyphs, cp) + 1.0f;
     }
+    return x;
+}
 
-    // --- UPDATE SELECTION IF SHIFT IS HELD ---
-    if (is_shift && moved && anchor_block != NULL) {
-        update_selection_range(doc, b, b->cursor_index);
+void draw_find_bar(const FindBar *fb) {
+    int rows = fb->replace_mode ? 2 : 1;
+    int h = rows * 26 + 8;
+    int top = GetScreenHeight() - h;
+    DrawRectangle(0, top, GetScreenWidth(), h, (Color){ 235, 235, 235, 255 });
+    DrawLine(0, top, GetScreenWidth(), top, LIGHTGRAY);
+
+    static const char *labels[2] = { "find:", "replace:" };
+    for (int r = 0; r < rows; r++) {
+        float y = top + 4 + r * 26;
+        draw_string(labels[r], 10, y + 2, DARKGRAY);
+        float end = draw_string(fb->text[r], 100, y + 2, BLACK);
+        if (r == fb->field) DrawRectangle((int)end, (int)y + 2, 2, 20, BLACK);
     }
 
-    return b;
+    char info[96];
+    char count[32] = "";
+    if (fb->job != NULL || fb->count_pending) {
+        snprintf(count, sizeof(count), "%d%s ", fb->hit_count, (fb->scanning || fb->count_pending) ? "..." : "");
+    }
+    snprintf(info, sizeof(info), "%s%s%s%s", fb->regex ? "[regex] " : "", fb->cross_blocks ? "[across blocks] " : "", count, fb->status);
+    draw_string(info, GetScreenWidth() - 260, top + 6, GRAY);
 }
 
 // ============================================================================
-// 5. selection state
+// 4. main loop & rendering
 // ============================================================================
 
-void update_selection_range(Document *doc, Block *current_hover, int current_index) {
-    if (anchor_block == NULL || current_hover == NULL) return;
+#define SELECTION_COLOR (Color){ 100, 200, 255, 150 }
+#define HIGHLIGHT_COLOR (Color){ 255, 230, 120, 255 }
+#define BOOKMARK_COLOR  (Color){ 90, 140, 230, 255 }
 
-    // reset all
-    Block *b = doc->start;
-    while (b != NULL) {
-        b->sel_start = -1;
-        b->sel_len = 0;
-        b = b->next;
+// background rects of consecutive glyphs on one visual line, drawn as one
+typedef struct {
+    bool open;
+    int x0, x1, y;
+} RectRun;
+
+static void run_flush(RectRun *r, int h, Color c) {
+    if (r->open) {
+        DrawRectangle(r->x0, r->y, r->x1 - r->x0, h, c);
+        stats.frame.draw_calls++;
     }
+    r->open = false;
+}
 
-    // define order (start -> end)
-    Block *start_b = anchor_block;
-    int start_i = anchor_index;
-    Block *end_b = current_hover;
-    int end_i = current_index;
-
-    // check inversion (backwards drag)
-    if (start_b != end_b) {
-        Block *check = doc->start;
-        bool found_end_first = false;
-        while (check != NULL) {
-            if (check == end_b) { found_end_first = true; break; }
-            if (check == start_b) break;
-            check = check->next;
-        }
-        if (found_end_first) {
-            start_b = current_hover; start_i = current_index;
-            end_b = anchor_block;    end_i = anchor_index;
-        }
+static void run_add(RectRun *r, int x, int y, int w, int h, Color c) {
+    if (r->open && r->y == y) { r->x1 = x + w; return; }
+    run_flush(r, h, c);
+    *r = (RectRun){ true, x, x + w, y };
+}
+
+// rolling numbers of the last frames, top right
+static void draw_stats_overlay(const FrameStats *s) {
+    FrameSummary sum;
+    frame_stats_summary(s, &sum);
+    char lines[4][160];
+    snprintf(lines[0], sizeof(lines[0]), "latency p50 %.1f  p99 %.1f ms (%d inputs)", sum.latency_p50, sum.latency_p99, sum.inputs);
+    snprintf(lines[1], sizeof(lines[1]), "in %.2f  edit %.2f  layout %.2f  draw %.2f  present %.2f",
+             sum.phase[PHASE_INPUT], sum.phase[PHASE_EDIT], sum.phase[PHASE_LAYOUT], sum.phase[PHASE_DRAW], sum.phase[PHASE_PRESENT]);
+    snprintf(lines[2], sizeof(lines[2]), "draw calls %d  glyphs %d", sum.draw_calls, sum.glyphs);
+    if (!alloc_stats_enabled()) {
+        snprintf(lines[3], sizeof(lines[3]), "allocs: build with -DALLOC_STATS");
     } else {
-        if (start_i > end_i) { int t = start_i; start_i = end_i; end_i = t; }
+        // last frame by subsystem, and how many recent frames allocated at all
+        int n = snprintf(lines[3], sizeof(lines[3]), "allocs %lld (%lld B) in %d/%d frames ",
+                         sum.allocs.allocs, sum.allocs.bytes, sum.alloc_frames, sum.frames);
+        for (int a = 0; a < ALLOC_SUBSYSTEMS && n < (int)sizeof(lines[3]); a++) {
+            long long c = sum.alloc_subsystems->sub[a].allocs;
+            if (c > 0) n += snprintf(&lines[3][n], sizeof(lines[3]) - n, " %s %lld", alloc_subsystem_name(a), c);
+        }
     }
 
-    // apply range
-    Block *curr = start_b;
-    bool finished = false;
-    
-    while (curr != NULL && !finished) {
-        int len = strlen(curr->text);
-        
-        if (curr == end_b) finished = true;
-
-        if (curr == start_b && curr == end_b) {
-            curr->sel_start = start_i;
-            curr->sel_len = end_i - start_i;
-        } 
-        else if (curr == start_b) {
-            curr->sel_start = start_i;
-            curr->sel_len = len - start_i;
-        } 
-        else if (curr == end_b) {
-            curr->sel_start = 0;
-            curr->sel_len = end_i;
-        } 
-        else {
-            curr->sel_start = 0;
-            curr->sel_len = len;
-        }
-        curr = curr->next;
+    int w = 470, x = GetScreenWidth() - w - 10;
+    DrawRectangle(x, 10, w, 4 * 22 + 8, (Color){ 30, 30, 30, 210 });
+    for (int i = 0; i < 4; i++) draw_string(lines[i], x + 8, 14 + i * 22, RAYWHITE);
+}
+
+// search highlights are looked up while walking blocks in document order.
+// a match crossing blocks keeps the following ones lit up to (block_id, end).
+typedef struct {
+    int block_id;        // -1 = none
+    int end;
+} HighlightCarry;
+
+// matches starting in b, returns the offset b is lit up to from its start
+static int highlight_walk(HighlightCarry *carry, Block *b, const Highlight **hl, int *count) {
+    int lit_until = -1;
+    if (carry->block_id == b->id) {
+        lit_until = carry->end;
+        carry->block_id = -1;
+    } else if (carry->block_id != -1) {
+        lit_until = block_len(b) + 1;
     }
+    *count = highlight_block(highlights, b, hl);
+    if (*count > 0 && (*hl)[*count - 1].end_block_id != b->id) {
+        *carry = (HighlightCarry){ (*hl)[*count - 1].end_block_id, (*hl)[*count - 1].end };
+    }
+    return lit_until;
 }
 
-// ============================================================================
-// 6. main loop & rendering
-// ============================================================================
+// off screen: blocks within the overscan get their highlights ahead of
+// scrolling (the draw walk reaches no farther)
+static void highlight_skip(HighlightCarry *carry, Block *b) {
+    const Highlight *hl;
+    int count;
+    highlight_walk(carry, b, &hl, &count);
+}
 
-int main() {
+// ctrl+f2: a bookmark at the cursor goes away, else one is added there
+static void toggle_bookmark(Document *doc, Block *b) {
+    static int added = 0;
+    for (int i = 0; i < b->marker_count; i++) {
+        const Marker *m = &b->markers[i];
+        if (m->offset == b->cursor_index && marker_name(doc, m->id) != NULL) {
+            marker_remove(doc, m->id);
+            return;
+        }
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "bookmark %d", ++added);
+    marker_add(doc, b, b->cursor_index, name);
+}
+
+int main(int argc, char **argv) {
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(800, 600, "text editor in c");
+    SetWindowMinSize(320, 200);
     SetTargetFPS(60);
+    SetExitKey(KEY_NULL);  // esc closes the find bar first
+    workers = pool_create(0);
+    highlights = highlight_create();
+    glyph_cache_init(&glyphs, glyph_find_font(), 20);
 
+    // usage: app [file]. plain text, or native when saved as .tdoc
+    const char *file_path = (argc > 1) ? argv[1] : NULL;
     Document *my_doc = create_document();
-    add_block(my_doc, "click here to edit...");
-    Block *block_focus = NULL;
+    if (file_path == NULL || !docfile_open(my_doc, file_path)) {
+        if (file_path != NULL) TraceLog(LOG_WARNING, "cannot open %s", file_path);
+        add_block(my_doc, "click here to edit...");
+    } else {
+        start_indexing(my_doc);
+    }
 
-    double last_action_time = GetTime();
+    // loaded blocks were checked on the way in
+    for (Block *b = my_doc->start; b; b = b->next) {
+        if (b->utf8_checked && b->utf8_errors > 0) {
+            TraceLog(LOG_WARNING, "block %d: %d invalid utf-8 sequence(s), first at byte %d",
+                     b->id, b->utf8_errors, b->utf8_first_error);
+        }
+    }
+
+    editor_init(&editor, my_doc, measure_glyph, &glyphs);
+    // TEXT_EDITOR_TAB_WIDTH=n spaces between tab stops (4)
+    const char *tab_width = getenv("TEXT_EDITOR_TAB_WIDTH");
+    if (tab_width != NULL && atoi(tab_width) > 0) {
+        editor.layout.tab_width = atoi(tab_width);
+        layout_changed(&editor.layout);
+    }
+    editor_handle(&editor, &(InputEvent){ .type = INPUT_RESIZE, .x = GetScreenWidth(), .y = GetScreenHeight() });
+    editor.last_action = GetTime();
+    InputQueue events = { 0 };
+
+    // TEXT_EDITOR_TRACE=path records the session for bench/trace_replay
+    const char *trace_path = getenv("TEXT_EDITOR_TRACE");
+    if (trace_path != NULL && trace_path[0] != '\0') {
+        recorder = trace_write_open(trace_path, &editor);
+        if (recorder == NULL) TraceLog(LOG_WARNING, "cannot write trace %s", trace_path);
+    }
+    FindBar find = { 0 };
+    int damaged_reported = 0;
+
+    // TEXT_EDITOR_FRAME_CSV=path writes the frame statistics, one row per frame
+    frame_stats_init(&stats);
+    const char *csv_path = getenv("TEXT_EDITOR_FRAME_CSV");
+    if (csv_path != NULL && csv_path[0] != '\0' && !frame_stats_csv(&stats, csv_path)) {
+        TraceLog(LOG_WARNING, "cannot write frame csv %s", csv_path);
+    }
 
     while (!WindowShouldClose()) {
-        if (block_focus != NULL) {
-            block_focus = update_typing(my_doc, block_focus, &last_action_time);
-            
-            // HARD ENTER: Split block logic
-            if (IsKeyPressed(KEY_ENTER) && !IsKeyDown(KEY_LEFT_SHIFT) && !IsKeyDown(KEY_RIGHT_SHIFT)) {
-                
-                // 1. clean selection
-                Block *survivor = delete_selected_text(my_doc);
-                if (survivor != NULL) block_focus = survivor;
-
-                // 2. prepare text move
-                int split_index = block_focus->cursor_index;
-                char *text_moving_down = &block_focus->text[split_index];
-
-                // 3. insert new block
-                insert_block_after(my_doc, block_focus, text_moving_down);
-
-                // 4. cut current block
-                block_focus->text[split_index] = '\0';
-                
-                // 5. move focus
-                block_focus = block_focus->next;
-                block_focus->cursor_index = 0; 
-                last_action_time = GetTime();
-            }
+        PROFILE_SCOPE("frame");
+        frame_stats_begin(&stats, GetTime());
+        PROFILE_BEGIN(input_zone, "input");
+        bool is_ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+        editor.follow_cursor = false;
+        poll_indexing(my_doc);
+
+        if (IsKeyPressed(KEY_F12)) show_stats = !show_stats;
+#ifdef PROFILE
+        // f11 writes the recent markers of every thread (chrome://tracing, perfetto)
+        if (IsKeyPressed(KEY_F11)) {
+            if (profile_dump("profile.json")) TraceLog(LOG_INFO, "profile written to profile.json");
+            else TraceLog(LOG_WARNING, "cannot write profile.json");
+        }
+#endif
+        if (IsKeyPressed(KEY_ESCAPE)) {
+            if (!find.open) break;
+            find.open = false;
+            stop_search(&find);
         }
 
-        BeginDrawing();
-        ClearBackground(RAYWHITE);
-
-        Block *current = my_doc->start;
-        int y = 20;
-        int fontSize = 20, lineHeight = 24, maxWidth = 680; 
+        // find / replace (ctrl+f, ctrl+h)
+        if (is_ctrl && (IsKeyPressed(KEY_F) || IsKeyPressed(KEY_H))) {
+            find.open = true;
+            find.replace_mode = IsKeyPressed(KEY_H);
+            find.field = 0;
+            find.has_match = false;
+            find.status[0] = '\0';
+            while (GetCharPressed() > 0) { } // the shortcut letter is not part of the query
+            restart_search(my_doc, &find, false);
+        }
+        if (find.open && update_find_bar(my_doc, &find, &editor.focus)) {
+            editor.last_action = GetTime();
+            editor.follow_cursor = true;
+        }
 
-        while (current != NULL) {
-            int pad = 4;
-            int gap = 2;
+        // save (ctrl+s)
+        if (is_ctrl && IsKeyPressed(KEY_S)) {
+            stop_search(&find); // the snapshots may point into the mapping
+            bool indexing = (trigram_job != NULL);
+            trigram_job_free(trigram_job);
+            trigram_job = NULL;
+            bool saved = (my_doc->file != NULL)
+                ? docfile_save(my_doc)
+                : docfile_save_as(my_doc, file_path ? file_path : "untitled" DOCFILE_EXT);
+            if (saved) TraceLog(LOG_INFO, "saved %s", docfile_path(my_doc));
+            else TraceLog(LOG_WARNING, "save failed");
+            if (indexing) start_indexing(my_doc);
+            if (find.open) restart_search(my_doc, &find, false);
+        }
 
-            // ----------------------------------------------------------------
-            // a. height calculation (simulation)
-            // ----------------------------------------------------------------
-            int vis_lines = 1; float x_count = 0;
-            for (int i = 0; current->text[i] != '\0'; i++) {
-                char c = current->text[i];
-                if (c == '\n') { vis_lines++; x_count = 0; continue; } // skip \n measurement
-
-                float w = MeasureTextEx(GetFontDefault(), (char[2]){c, '\0'}, (float)fontSize, 1.0f).x;
-                if (x_count + w > maxWidth) { vis_lines++; x_count = 0; } 
-                x_count += w + 1.0f; 
+        // bookmarks: ctrl+f2 toggles one at the cursor, f2 jumps to the next
+        if (IsKeyPressed(KEY_F2) && editor.focus != NULL && !find.open) {
+            Block *b;
+            int offset;
+            if (is_ctrl) {
+                toggle_bookmark(my_doc, editor.focus);
+            } else if (marker_next_named(my_doc, editor.focus, editor.focus->cursor_index, &b, &offset)) {
+                block_load(b);
+                selection_clear(&editor.sel, my_doc);
+                editor.focus = b;
+                b->cursor_index = offset;
+                editor.last_action = GetTime();
+                editor.follow_cursor = true;
             }
-            int b_height = (vis_lines * lineHeight) + (pad * 2);
-            Rectangle b_area = {0, (float)y, 800, (float)(b_height + gap)};
-            bool mouse_above = CheckCollisionPointRec(GetMousePosition(), b_area);
-
-            // ----------------------------------------------------------------
-            // b. mouse interaction
-            // ----------------------------------------------------------------
-            Vector2 mouse = GetMousePosition();
-            float local_mouse_x = mouse.x - 60;
-            float local_mouse_y = mouse.y - (y + pad);
-            int char_index_under_mouse = 0;
-
-            // find char index under mouse
-            {
-                int sim_line = 0; float sim_x = 0;
-                int text_len = strlen(current->text);
-                float min_dist = 100000.0f;
-                bool is_left_margin = (mouse.x < 60);
-
-                for (int i = 0; i <= text_len; i++) {
-                    float line_top = sim_line * lineHeight;
-                    float line_bottom = line_top + lineHeight;
-                    bool mouse_on_this_line = (local_mouse_y >= line_top && local_mouse_y < line_bottom);
-                    if (i == text_len && local_mouse_y >= line_bottom) mouse_on_this_line = true;
-
-                    if (mouse_on_this_line) {
-                        if (is_left_margin && sim_x == 0) { char_index_under_mouse = i; break; }
-                        float dist = (local_mouse_x > sim_x) ? (local_mouse_x - sim_x) : (sim_x - local_mouse_x);
-                        if (dist < min_dist) { min_dist = dist; char_index_under_mouse = i; }
-                    }
+        }
 
-                    if (i < text_len) {
-                        char c = current->text[i];
-                        if (c == '\n') { sim_line++; sim_x = 0; continue; } 
-                        
-                        float w = MeasureTextEx(GetFontDefault(), (char[2]){c, '\0'}, (float)fontSize, 1.0f).x;
-                        if (sim_x + w > maxWidth) { sim_line++; sim_x = 0; }
-                        sim_x += w + 1.0f;
-                    }
-                }
+        // keyboard & mouse go through the editor core as events
+        // (the find bar reads the keyboard itself while open)
+        double now = GetTime();
+        events.count = 0;
+        if (IsWindowResized()) input_push(&events, (InputEvent){ .type = INPUT_RESIZE, .x = GetScreenWidth(), .y = GetScreenHeight(), .time = now });
+        if (editor.focus != NULL && !find.open) poll_keyboard(&events, now);
+        poll_mouse(&events, now);
+
+        // dropped files go in as pastes at the cursor, so they replace the
+        // selection and are recorded like any other input. the texts are
+        // borrowed until the events are handled.
+        FilePathList dropped = { 0 };
+        unsigned char **drop_data = NULL;
+        if (IsFileDropped()) {
+            dropped = LoadDroppedFiles();
+            drop_data = (unsigned char**)calloc(dropped.count, sizeof(unsigned char*));
+            if (editor.focus == NULL) {
+                editor.focus = my_doc->end;
+                block_load(editor.focus);
+                editor.focus->cursor_index = block_len(editor.focus);
             }
-
-            // handle clicks & drags
-            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && mouse_above) {
-                block_focus = current;
-                last_action_time = GetTime();
-                current->cursor_index = char_index_under_mouse;
-                anchor_block = current;
-                anchor_index = char_index_under_mouse;
-                update_selection_range(my_doc, current, char_index_under_mouse);
+            for (unsigned int i = 0; i < dropped.count; i++) {
+                int size = 0;
+                drop_data[i] = LoadFileData(dropped.paths[i], &size);
+                if (drop_data[i] == NULL || size == 0) continue;
+                warn_invalid_utf8((const char*)drop_data[i], (size_t)size);
+                input_push(&events, (InputEvent){ .type = INPUT_PASTE, .text = (const char*)drop_data[i], .text_len = size, .time = now });
             }
-            if (IsMouseButtonDown(MOUSE_LEFT_BUTTON) && anchor_block != NULL) {
-                 if (mouse_above) {
-                    current->cursor_index = char_index_under_mouse; 
-                    update_selection_range(my_doc, current, char_index_under_mouse);
-                 }
+        }
+        if (recorder != NULL) {
+            trace_frame(recorder, now, editor.scroll_y, editor.height);
+            for (int i = 0; i < events.count; i++) trace_event(recorder, &events.events[i]);
+        }
+        for (int i = 0; i < events.count; i++) frame_stats_event(&stats, events.events[i].time);
+        frame_stats_phase(&stats, PHASE_INPUT, GetTime());
+        PROFILE_END(input_zone);
+        PROFILE_BEGIN(edit_zone, "edit");
+        for (int i = 0; i < events.count; i++) editor_handle(&editor, &events.events[i]);
+        if (drop_data != NULL) {
+            for (unsigned int i = 0; i < dropped.count; i++) {
+                if (drop_data[i] != NULL) UnloadFileData(drop_data[i]);
             }
+            free(drop_data);
+            UnloadDroppedFiles(dropped);
+        }
+        // off-screen blocks catch up with a new wrap width a slice a frame
+        editor_reflow(&editor, EDITOR_REFLOW_BUDGET);
+        frame_stats_phase(&stats, PHASE_EDIT, GetTime());
+        PROFILE_END(edit_zone);
 
+        scratch_frame_reset();
+        BeginDrawing();
+        ClearBackground(RAYWHITE);
+
+        const Layout *lo = &editor.layout;
+        int fontSize = 20, lineHeight = lo->line_height, pad = lo->pad, gap = lo->gap;
+        int left = editor.left;
+        int screen_h = GetScreenHeight();
+        editor.scroll_y -= GetMouseWheelMove() * lineHeight * 3;
+        if (editor.scroll_y < 0) editor.scroll_y = 0;
+
+        int overscan = screen_h;
+        HighlightCarry carry = { -1, 0 };
+        double draw_time = 0;   // of visible blocks, the rest of the walk is layout
+        PROFILE_BEGIN(view_zone, "layout");
+        editor_place_focus(&editor, overscan);
+
+        // the walk covers the view and the overscan around it, starting at
+        // the first block there (placed by the view index)
+        int first_top;
+        Block *current = editor_block_at(&editor, (int)editor.scroll_y - editor.top - overscan, &first_top);
+        int y = editor.top - (int)editor.scroll_y + first_top;
+
+        while (current != NULL && y <= screen_h + overscan) {
             // ----------------------------------------------------------------
-            // c. rendering (text & selection)
+            // a. height calculation (simulation)
             // ----------------------------------------------------------------
-            int current_line = 0; float x_offset = 0;
-            Vector2 cur_pos = { 60, (float)y + pad };
-            
-            // fix for empty block selection
-            if (strlen(current->text) == 0) {
-                if (current->sel_start != -1) DrawRectangle(60, y + pad, 10, lineHeight, (Color){100, 200, 255, 150});
-                cur_pos = (Vector2){ 60, (float)(y + pad) };
+            int est_height = editor_block_estimate(&editor, current);
+
+            // off screen: only the height matters, estimated from the stored
+            // line count or the last one measured, so unloaded blocks stay
+            // unloaded (focus still tracks its cursor)
+            if ((y + est_height + gap < 0 || y > screen_h) && current != editor.focus) {
+                if (find.open) highlight_skip(&carry, current);
+                y += est_height + gap;
+                current = current->next;
+                continue;
             }
+            block_load(current);
+            int text_len = block_len(current);
+            int b_height = editor_block_height(&editor, current);
 
-            for (int i = 0; current->text[i] != '\0'; i++) {
-                if (i == current->cursor_index) {
-                    cur_pos = (Vector2){ (float)((int)(60 + x_offset)), (float)((int)(y + pad + (current_line * lineHeight))) };
-                }
+            // ----------------------------------------------------------------
+            // b. rendering (backgrounds, text & cursor)
+            // ----------------------------------------------------------------
+            PROFILE_SCOPE("draw_block");
+            double draw_start = GetTime();
+            const Highlight *hl = NULL;
+            int hl_count = 0;
+            int lit_until = find.open ? highlight_walk(&carry, current, &hl, &hl_count) : -1;
+            int sel_start = my_doc->meta.sel_start[current->handle];
+            int sel_len = my_doc->meta.sel_len[current->handle];
+
+            // search highlights, then the selection over them. one rect per
+            // visual line each (a lit highlight run is drawn before the
+            // selection run that may cover it).
+            if (text_len == 0) {
+                // fix for empty block selection
+                if (lit_until > 0) DrawRectangle(left, y + pad, 10, lineHeight, HIGHLIGHT_COLOR);
+                if (sel_start != -1) DrawRectangle(left, y + pad, 10, lineHeight, SELECTION_COLOR);
+                stats.frame.draw_calls += (lit_until > 0) + (sel_start != -1);
+            } else if (lit_until > 0 || hl_count > 0 || sel_start != -1) {
+                RectRun lit_run = { 0 }, sel_run = { 0 };
+                int k = 0;
+                LayoutIter it;
+                layout_begin(&it, lo, current->text, text_len);
+                while (layout_next(&it)) {
+                    int i = it.i;
+                    while (k < hl_count && hl[k].start <= i) {
+                        int end = (hl[k].end_block_id == current->id) ? hl[k].end : text_len;
+                        if (end > lit_until) lit_until = end;
+                        k++;
+                    }
+                    bool lit = (i < lit_until);
+                    bool sel = sel_start != -1 && i >= sel_start && i < sel_start + sel_len;
 
-                char c = current->text[i];
+                    // newlines get a 5px marker
+                    int rect_w = (it.cp == '\n') ? 5 : (int)it.w + 1;
+                    int px = (int)(left + it.x), py = y + pad + it.line * lineHeight;
 
-                // handle newline (skip measurement)
-                if (c == '\n') {
-                    if (current->sel_start != -1 && i >= current->sel_start && i < current->sel_start + current->sel_len) {
-                            DrawRectangle(60 + x_offset, y + pad + (current_line * lineHeight), 5, lineHeight, (Color){100, 200, 255, 150});
-                    }
-                    current_line++; 
-                    x_offset = 0;
-                    if (i + 1 == current->cursor_index) {
-                        cur_pos = (Vector2){ 60, (float)((int)(y + pad + (current_line * lineHeight))) };
+                    if (!lit) run_flush(&lit_run, lineHeight, HIGHLIGHT_COLOR);
+                    if (!sel && sel_run.open) {
+                        run_flush(&lit_run, lineHeight, HIGHLIGHT_COLOR);
+                        run_flush(&sel_run, lineHeight, SELECTION_COLOR);
                     }
-                    continue; 
+                    if (lit) run_add(&lit_run, px, py, rect_w, lineHeight, HIGHLIGHT_COLOR);
+                    if (sel) run_add(&sel_run, px, py, rect_w, lineHeight, SELECTION_COLOR);
                 }
+                run_flush(&lit_run, lineHeight, HIGHLIGHT_COLOR);
+                run_flush(&sel_run, lineHeight, SELECTION_COLOR);
+            }
 
-                // handle normal char
-                float w = MeasureTextEx(GetFontDefault(), (char[2]){c, '\0'}, (float)fontSize, 1.0f).x;
-                if (x_offset + w > maxWidth) {
-                    current_line++; 
-                    x_offset = 0;
+            // text, and where the cursor goes
+            Vector2 cur_pos = { (float)left, (float)(y + pad) };
+            LayoutIter it;
+            layout_begin(&it, lo, current->text, text_len);
+            while (layout_next(&it)) {
+                if (it.cp != '\n' && it.cp != '\t') {
+                    Vector2 pos = { (float)((int)(left + it.x)), (float)(y + pad + it.line * lineHeight) };
+                    glyph_draw(&glyphs, it.cp, pos, BLACK);
+                    stats.frame.glyphs++;
                 }
-
-                Vector2 pos = { (float)((int)(60 + x_offset)), (float)((int)(y + pad + (current_line * lineHeight))) };
-
-                // selection bg
-                if (current->sel_start != -1) {
-                    if (i >= current->sel_start && i < current->sel_start + current->sel_len) {
-                        DrawRectangle((int)pos.x, (int)pos.y, (int)w + 1, lineHeight, (Color){100, 200, 255, 150});
-                    }
+                if (it.i + it.n == current->cursor_index) {
+                    cur_pos = (Vector2){ (float)((int)(left + it.next_x)), (float)(y + pad + it.next_line * lineHeight) };
                 }
+            }
 
-                // draw char
-                DrawTextEx(GetFontDefault(), (char[2]){c, '\0'}, pos, (float)fontSize, 1.0f, BLACK);
-                x_offset += w + 1.0f;
+            // bookmarks, in the gutter
+            for (int i = 0; i < current->marker_count; i++) {
+                const Marker *m = &current->markers[i];
+                if (marker_name(my_doc, m->id) == NULL) continue;
+                int line;
+                float x;
+                layout_caret(lo, current->text, text_len, m->offset, &line, &x);
+                DrawCircle(left - 12, y + pad + line * lineHeight + lineHeight / 2, 4, BOOKMARK_COLOR);
+                stats.frame.draw_calls++;
+            }
 
-                if (i + 1 == current->cursor_index) {
-                    cur_pos = (Vector2){ (float)((int)(60 + x_offset)), (float)((int)(y + pad + (current_line * lineHeight))) };
-                }
+            // keep keyboard-moved cursor in view
+            if (current == editor.focus && editor.follow_cursor) {
+                if (cur_pos.y < 0) editor.scroll_y += cur_pos.y - 20;
+                else if (cur_pos.y + lineHeight > screen_h) editor.scroll_y += cur_pos.y + lineHeight - screen_h + 20;
             }
 
             // draw blinking cursor
-            if (current == block_focus) {
-                double time_since_action = GetTime() - last_action_time;
+            if (current == editor.focus) {
+                double time_since_action = GetTime() - editor.last_action;
                 bool show_cursor = (time_since_action < 0.6) || ((int)(GetTime() * 2) % 2 == 0);
                 if (show_cursor) DrawRectangle((int)cur_pos.x, (int)cur_pos.y, 2, fontSize, BLACK);
+                stats.frame.draw_calls += show_cursor;
             }
+            draw_time += GetTime() - draw_start;
 
             // next block jump
             y += b_height + gap;
             current = current->next;
         }
+
+        // clamp scroll to content
+        float content_h = editor.top + editor_content_height(&editor);
+        if (editor.scroll_y > content_h - screen_h + 20) editor.scroll_y = content_h - screen_h + 20;
+        if (editor.scroll_y < 0) editor.scroll_y = 0;
+        frame_stats_phase(&stats, PHASE_LAYOUT, GetTime());
+        PROFILE_END(view_zone);
+        frame_stats_move(&stats, PHASE_LAYOUT, PHASE_DRAW, draw_time);
+
+        // stored payloads are checked as they load (scrolling, editing)
+        if (my_doc->meta.damaged > damaged_reported) {
+            TraceLog(LOG_WARNING, "%s: %d block(s) do not match their stored hash",
+                     docfile_path(my_doc), my_doc->meta.damaged);
+            damaged_reported = my_doc->meta.damaged;
+        }
+
+        if (find.open) {
+            highlight_end_frame(highlights);
+            draw_find_bar(&find);
+        }
+        if (show_stats) draw_stats_overlay(&stats);
+        stats.frame.draw_calls += stats.frame.glyphs;
+        frame_stats_phase(&stats, PHASE_DRAW, GetTime());
+
+        PROFILE_BEGIN(present_zone, "present");
         EndDrawing();
+        PROFILE_END(present_zone);
+        frame_stats_phase(&stats, PHASE_PRESENT, GetTime());
+        frame_stats_end(&stats, GetTime());
     }
+    stop_search(&find);
+    trace_write_close(recorder, my_doc);
+    frame_stats_free(&stats);
+    input_free(&events);
+    highlight_free(highlights);
+    trigram_job_free(trigram_job);
+    trigram_index_free(trigrams);
+    pool_destroy(workers);
+    editor_free(&editor);
     free_document(my_doc);
+    glyph_cache_free(&glyphs);
+    scratch_release();
     CloseWindow();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,190 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/marker.h"
+#define ALLOC_SUBSYSTEM ALLOC_DOCUMENT
+#include "include/alloc_stats.h"
+
+// first marker of b at or past offset
+static int lower_bound(const Block *b, int offset) {
+    int lo = 0, hi = b->marker_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (b->markers[mid].offset < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void reserve(Block *b, int count) {
+    if (count <= b->marker_cap) return;
+    int cap = b->marker_cap ? b->marker_cap * 2 : 4;
+    while (cap < count) cap *= 2;
+    b->markers = (Marker*)realloc(b->markers, cap * sizeof(Marker));
+    b->marker_cap = cap;
+}
+
+// ----------------------------------------------------------------------------
+// table
+// ----------------------------------------------------------------------------
+
+static MarkerTable* table_of(Document *doc) {
+    if (doc->markers == NULL) doc->markers = (MarkerTable*)calloc(1, sizeof(MarkerTable));
+    return doc->markers;
+}
+
+static bool live(const MarkerTable *t, int id) {
+    return t != NULL && id >= 0 && id < t->cap && t->block_id[id] != -1;
+}
+
+int marker_add(Document *doc, Block *b, int offset, const char *name) {
+    MarkerTable *t = table_of(doc);
+    int id;
+    if (t->free_count > 0) {
+        id = t->free_ids[--t->free_count];
+    } else {
+        id = t->cap++;
+        t->block_id = (int*)realloc(t->block_id, t->cap * sizeof(int));
+        t->name = (char**)realloc(t->name, t->cap * sizeof(char*));
+        t->free_ids = (int*)realloc(t->free_ids, t->cap * sizeof(int));
+    }
+    t->block_id[id] = b->id;
+    t->name[id] = name ? strdup(name) : NULL;
+
+    // after markers already at the same offset
+    int i = lower_bound(b, offset + 1);
+    reserve(b, b->marker_count + 1);
+    memmove(&b->markers[i + 1], &b->markers[i], (b->marker_count - i) * sizeof(Marker));
+    b->markers[i] = (Marker){ id, offset };
+    b->marker_count++;
+    return id;
+}
+
+void marker_remove(Document *doc, int id) {
+    MarkerTable *t = doc->markers;
+    if (!live(t, id)) return;
+    Block *b = find_block(doc, t->block_id[id]);
+    if (b != NULL) {
+        for (int i = 0; i < b->marker_count; i++) {
+            if (b->markers[i].id != id) continue;
+            memmove(&b->markers[i], &b->markers[i + 1], (b->marker_count - i - 1) * sizeof(Marker));
+            b->marker_count--;
+            break;
+        }
+    }
+    free(t->name[id]);
+    t->name[id] = NULL;
+    t->block_id[id] = -1;
+    t->free_ids[t->free_count++] = id;
+}
+
+Block* marker_get(Document *doc, int id, int *offset) {
+    MarkerTable *t = doc->markers;
+    if (!live(t, id)) return NULL;
+    Block *b = find_block(doc, t->block_id[id]);
+    if (b == NULL) return NULL;
+    for (int i = 0; i < b->marker_count; i++) {
+        if (b->markers[i].id == id) {
+            *offset = b->markers[i].offset;
+            return b;
+        }
+    }
+    return NULL;
+}
+
+const char* marker_name(Document *doc, int id) {
+    return live(doc->markers, id) ? doc->markers->name[id] : NULL;
+}
+
+int marker_find(Document *doc, const char *name) {
+    MarkerTable *t = doc->markers;
+    if (t == NULL) return -1;
+    for (int id = 0; id < t->cap; id++) {
+        if (t->block_id[id] != -1 && t->name[id] != NULL && strcmp(t->name[id], name) == 0) return id;
+    }
+    return -1;
+}
+
+static int first_named(const MarkerTable *t, const Block *b, int from) {
+    for (int i = from; i < b->marker_count; i++) {
+        if (t->name[b->markers[i].id] != NULL) return i;
+    }
+    return -1;
+}
+
+bool marker_next_named(Document *doc, Block *b, int offset, Block **out, int *out_offset) {
+    MarkerTable *t = doc->markers;
+    if (t == NULL) return false;
+    int i = first_named(t, b, lower_bound(b, offset + 1));
+    Block *cur = b;
+    // the rest of the document, then around from the start up to b itself
+    while (i < 0) {
+        cur = (cur->next != NULL) ? cur->next : doc->start;
+        i = first_named(t, cur, 0);
+        if (cur == b) break;
+    }
+    if (i < 0) return false;
+    *out = cur;
+    *out_offset = cur->markers[i].offset;
+    return true;
+}
+
+void marker_table_free(MarkerTable *t) {
+    if (t == NULL) return;
+    for (int id = 0; id < t->cap; id++) free(t->name[id]);
+    free(t->block_id);
+    free(t->name);
+    free(t->free_ids);
+    free(t);
+}
+
+// ----------------------------------------------------------------------------
+// edits
+// ----------------------------------------------------------------------------
+
+void markers_shift(Block *b, int at, int removed, int inserted) {
+    int i = lower_bound(b, removed > 0 ? at : at + 1);
+    for (; i < b->marker_count; i++) {
+        Marker *m = &b->markers[i];
+        if (m->offset < at + removed) m->offset = at;
+        else m->offset += inserted - removed;
+    }
+}
+
+void markers_move(Document *doc, Block *src, int from, int to, Block *dst, int dst_at, bool collapse) {
+    if (src->marker_count == 0) return;
+    int i = lower_bound(src, from);
+    int j = (to == INT_MAX) ? src->marker_count : lower_bound(src, to);
+    if (i == j) return;
+
+    if (src == dst) {
+        for (int k = i; k < j; k++) {
+            Marker *m = &src->markers[k];
+            m->offset = collapse ? dst_at : dst_at + m->offset - from;
+        }
+        return;
+    }
+
+    int n = j - i;
+    reserve(dst, dst->marker_count + n);
+    MarkerTable *t = doc->markers;
+    for (int k = i; k < j; k++) {
+        Marker m = src->markers[k];
+        m.offset = collapse ? dst_at : dst_at + m.offset - from;
+        dst->markers[dst->marker_count++] = m;
+        if (t != NULL) t->block_id[m.id] = dst->id;
+    }
+    memmove(&src->markers[i], &src->markers[j], (src->marker_count - j) * sizeof(Marker));
+    src->marker_count -= n;
+}
+
+void markers_join(Document *doc, Block *first, int at, Block *last, int last_at, int inserted) {
+    if (first == last) {
+        if (first->marker_count > 0) markers_shift(first, at, last_at - at, inserted);
+        return;
+    }
+    markers_move(doc, first, at, INT_MAX, first, at, true);
+    for (Block *b = first->next; b != last; b = b->next) markers_move(doc, b, 0, INT_MAX, first, at, true);
+    markers_move(doc, last, 0, last_at, first, at, true);
+    markers_move(doc, last, last_at, INT_MAX, first, at + inserted, false);
+}
@@ -0,0 +1,347 @@
+#include <stdint.h>
+#include "include/mono.h"
+#include "include/simd.h"
+
+// ----------------------------------------------------------------------------
+// scan
+// ----------------------------------------------------------------------------
+
+// n <= 64 bytes into bits of '\n', of '\t' and of bytes the fixed advance
+// does not cover (other controls, DEL, non-ascii)
+static void chunk_scalar(const char *p, int n, uint64_t *nl, uint64_t *tab, uint64_t *odd) {
+    uint64_t l = 0, t = 0, o = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)p[i];
+        if (c == '\n') l |= 1ull << i;
+        else if (c == '\t') t |= 1ull << i;
+        else if (c < ' ' || c >= 127) o |= 1ull << i;
+    }
+    *nl = l;
+    *tab = t;
+    *odd = o;
+}
+
+#ifdef SIMD_X86
+
+// bytes >= 0x80 compare as negative, so "below ' '" catches them too
+static void chunk_sse2(const char *p, uint64_t *nl, uint64_t *tab, uint64_t *odd) {
+    const __m128i vnl = _mm_set1_epi8('\n'), vtab = _mm_set1_epi8('\t');
+    const __m128i space = _mm_set1_epi8(' '), del = _mm_set1_epi8(127);
+    uint64_t l = 0, t = 0, o = 0;
+    for (int q = 0; q < 4; q++) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + q * 16));
+        __m128i is_nl = _mm_cmpeq_epi8(v, vnl);
+        __m128i is_tab = _mm_cmpeq_epi8(v, vtab);
+        __m128i bad = _mm_or_si128(_mm_andnot_si128(_mm_or_si128(is_nl, is_tab), _mm_cmplt_epi8(v, space)),
+                                   _mm_cmpeq_epi8(v, del));
+        l |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_nl) << (16 * q);
+        t |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_tab) << (16 * q);
+        o |= (uint64_t)(uint16_t)_mm_movemask_epi8(bad) << (16 * q);
+    }
+    *nl = l;
+    *tab = t;
+    *odd = o;
+}
+
+SIMD_TARGET_AVX2
+static void chunk_avx2(const char *p, uint64_t *nl, uint64_t *tab, uint64_t *odd) {
+    const __m256i vnl = _mm256_set1_epi8('\n'), vtab = _mm256_set1_epi8('\t');
+    const __m256i space = _mm256_set1_epi8(' '), del = _mm256_set1_epi8(127);
+    uint64_t l = 0, t = 0, o = 0;
+    for (int q = 0; q < 2; q++) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + q * 32));
+        __m256i is_nl = _mm256_cmpeq_epi8(v, vnl);
+        __m256i is_tab = _mm256_cmpeq_epi8(v, vtab);
+        __m256i bad = _mm256_or_si256(_mm256_andnot_si256(_mm256_or_si256(is_nl, is_tab), _mm256_cmpgt_epi8(space, v)),
+                                      _mm256_cmpeq_epi8(v, del));
+        l |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_nl) << (32 * q);
+        t |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_tab) << (32 * q);
+        o |= (uint64_t)(uint32_t)_mm256_movemask_epi8(bad) << (32 * q);
+    }
+    *nl = l;
+    *tab = t;
+    *odd = o;
+}
+
+#endif
+
+static ScanKernel best_kernel(void) {
+    static ScanKernel best = SCAN_AUTO;
+    if (best == SCAN_AUTO) {
+#ifdef SIMD_X86
+        best = simd_has_avx2() ? SCAN_AVX2 : SCAN_SSE2;
+#else
+        best = SCAN_SCALAR;
+#endif
+    }
+    return best;
+}
+
+// the '\n' and '\t' positions of a text in order, checking every chunk it
+// passes for bytes the fast path does not cover
+typedef struct {
+    ScanKernel kernel;
+    const char *text;
+    int len;
+    int base;            // offset of the chunk in the bits below
+    uint64_t stops;      // its '\n' and '\t' bits not handed out yet
+    uint64_t tabs;       // the '\t' ones
+} StopIter;
+
+static void stops_begin(StopIter *it, ScanKernel kernel, const char *text, int len) {
+    if (kernel == SCAN_AUTO) kernel = best_kernel();
+#ifdef SIMD_X86
+    if (kernel == SCAN_AVX2 && best_kernel() != SCAN_AVX2) kernel = SCAN_SSE2;
+#else
+    kernel = SCAN_SCALAR;
+#endif
+    it->kernel = kernel;
+    it->text = text;
+    it->len = len;
+    it->base = -64;
+    it->stops = 0;
+    it->tabs = 0;
+}
+
+// next '\n' or '\t' in *at (*tab: which), len past the last one. false on
+// a byte the fast path does not cover.
+static bool stops_next(StopIter *it, int *at, bool *tab) {
+    while (it->stops == 0) {
+        if (it->base + 64 >= it->len) {
+            *at = it->len;
+            *tab = false;
+            return true;
+        }
+        it->base += 64;
+        const char *p = it->text + it->base;
+        int n = it->len - it->base;
+        uint64_t nl, odd;
+#ifdef SIMD_X86
+        if (n >= 64 && it->kernel == SCAN_AVX2) chunk_avx2(p, &nl, &it->tabs, &odd);
+        else if (n >= 64 && it->kernel == SCAN_SSE2) chunk_sse2(p, &nl, &it->tabs, &odd);
+        else
+#endif
+        chunk_scalar(p, n < 64 ? n : 64, &nl, &it->tabs, &odd);
+        if (odd != 0) return false;
+        it->stops = nl | it->tabs;
+    }
+    int k = __builtin_ctzll(it->stops);
+    *at = it->base + k;
+    *tab = (it->tabs >> k) & 1;
+    it->stops &= it->stops - 1;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// columns
+// ----------------------------------------------------------------------------
+
+// the pen in whole columns: x = col * step. col runs 0 .. cols, a glyph
+// fits while the column it ends on is <= cols.
+typedef struct {
+    int line;
+    int col;
+} Pen;
+
+static inline float step_of(const Layout *lo) {
+    return lo->mono + lo->spacing;
+}
+
+// after k more glyphs that are not tabs
+static inline Pen pen_glyphs(const Layout *lo, Pen p, int k) {
+    int cols = lo->mono_cols;
+    if (p.col + k <= cols) {
+        p.col += k;
+        return p;
+    }
+    // the rest fill whole lines below, the last one gets 1 .. cols
+    int rest = k - (cols - p.col);
+    int full = (rest - 1) / cols;
+    p.line += 1 + full;
+    p.col = rest - full * cols;
+    return p;
+}
+
+// a tab ends on the next multiple of tab_width. false when one stop is
+// wider than a line: the general path wraps those.
+static inline bool pen_tab(const Layout *lo, Pen *p) {
+    int tw = lo->tab_width;
+    if (tw > lo->mono_cols) return false;
+    int end = (p->col / tw + 1) * tw;
+    if (end <= lo->mono_cols) {
+        p->col = end;
+    } else {
+        p->line++;
+        p->col = tw;
+    }
+    return true;
+}
+
+// past a '\n' or '\t' at the end of a run of glyphs
+static inline bool pen_stop(const Layout *lo, Pen *p, bool tab) {
+    if (tab) return pen_tab(lo, p);
+    p->line++;
+    p->col = 0;
+    return true;
+}
+
+bool mono_line_count_with(ScanKernel kernel, const Layout *lo, const char *text, int len, int *lines) {
+    StopIter it;
+    stops_begin(&it, kernel, text, len);
+    Pen p = { 0, 0 };
+    int start = 0;
+    for (;;) {
+        int at;
+        bool tab;
+        if (!stops_next(&it, &at, &tab)) return false;
+        p = pen_glyphs(lo, p, at - start);
+        if (at >= len) break;
+        if (!pen_stop(lo, &p, tab)) return false;
+        start = at + 1;
+    }
+    *lines = p.line + 1;
+    return true;
+}
+
+bool mono_line_count(const Layout *lo, const char *text, int len, int *lines) {
+    return mono_line_count_with(SCAN_AUTO, lo, text, len, lines);
+}
+
+bool mono_caret(const Layout *lo, const char *text, int len, int index, int *line, float *x) {
+    if (index > len) index = len;
+    StopIter it;
+    stops_begin(&it, SCAN_AUTO, text, len);
+    Pen p = { 0, 0 };
+    int start = 0;
+    for (;;) {
+        int at;
+        bool tab;
+        if (!stops_next(&it, &at, &tab)) return false;
+        if (at >= index) break;
+        p = pen_glyphs(lo, p, at - start);
+        if (!pen_stop(lo, &p, tab)) return false;
+        start = at + 1;
+    }
+    // a caret at a wrap stays at the end of the upper line
+    p = pen_glyphs(lo, p, index - start);
+    *line = p.line;
+    *x = p.col * step_of(lo);
+    return true;
+}
+
+bool mono_hit_test(const Layout *lo, const char *text, int len, float x, float y, bool left_margin, int *index) {
+    // above the first line nothing matches, layout_hit_test gives 0
+    if (y < 0) {
+        *index = 0;
+        return true;
+    }
+    int cols = lo->mono_cols;
+    float step = step_of(lo);
+    int want = (int)(y / lo->line_height);
+    int best = -1;
+    float best_dist = 0;
+    StopIter it;
+    stops_begin(&it, SCAN_AUTO, text, len);
+    Pen p = { 0, 0 };
+    int start = 0;
+    for (;;) {
+        int at;
+        bool tab;
+        if (!stops_next(&it, &at, &tab)) return false;
+        // carets start + k, k = 0 .. n, over a run of n glyphs from p: the
+        // columns p.col .. cols on p.line, then 1 .. cols on each line below
+        int n = at - start;
+        Pen end = pen_glyphs(lo, p, n);
+        if (want >= p.line && want <= end.line) {
+            int k0, c0, c1;
+            if (want == p.line) {
+                k0 = 0;
+                c0 = p.col;
+                c1 = (want == end.line) ? end.col : cols;
+            } else {
+                k0 = (cols - p.col) + (want - p.line - 1) * cols;
+                c0 = 1;
+                c1 = (want == end.line) ? end.col : cols;
+            }
+            if (left_margin && c0 == 0) {
+                *index = start;
+                return true;
+            }
+            // nearest column, the earlier one on a tie
+            float t = x / step - 0.5f;
+            int c = c0;
+            if (t >= c1) c = c1;
+            else if (t > c0) {
+                c = (int)t;
+                if (c < t) c++;
+            }
+            float dist = (x > c * step) ? (x - c * step) : (c * step - x);
+            if (best < 0 || dist < best_dist) {
+                best = start + k0 + (c - (want == p.line ? p.col : 0));
+                best_dist = dist;
+            }
+        }
+        // the line is done, or the text: inside a tab the caret snaps to
+        // whichever side was nearer
+        if (end.line > want && best >= 0) break;
+        if (at >= len) break;
+        p = end;
+        if (!pen_stop(lo, &p, tab)) return false;
+        if (p.line > want && best >= 0) break;
+        start = at + 1;
+    }
+    // below the last line
+    *index = (best >= 0) ? best : len;
+    return true;
+}
+
+bool mono_line_map(const Layout *lo, const char *text, int len, int *starts, float *end_x, float *x, int *lines) {
+    StopIter it;
+    stops_begin(&it, SCAN_AUTO, text, len);
+    int cols = lo->mono_cols;
+    float step = step_of(lo);
+    Pen p = { 0, 0 };
+    int start = 0;
+    starts[0] = 0;
+    for (;;) {
+        int at;
+        bool tab;
+        if (!stops_next(&it, &at, &tab)) return false;
+        // glyph k is drawn at column p.col + k until the line is full, then
+        // the rest wrap at every multiple of cols
+        int n = at - start;
+        int first = (cols - p.col < n) ? cols - p.col : n;
+        for (int k = 0; k < first; k++) x[start + k] = (p.col + k) * step;
+        if (first < n) {
+            end_x[p.line] = cols * step;
+            for (int k = first; k < n; k++) {
+                int r = k - first;
+                if (r % cols == 0) {
+                    if (r > 0) end_x[p.line + r / cols] = cols * step;
+                    starts[p.line + 1 + r / cols] = start + k;
+                }
+                x[start + k] = (r % cols) * step;
+            }
+        }
+        p = pen_glyphs(lo, p, n);
+        if (at >= len) break;
+        Pen before = p;
+        if (!pen_stop(lo, &p, tab)) return false;
+        if (!tab) {
+            x[at] = before.col * step;
+            end_x[before.line] = before.col * step;
+            starts[p.line] = at + 1;
+        } else if (p.line != before.line) {
+            // a tab that does not fit starts the next line
+            end_x[before.line] = before.col * step;
+            starts[p.line] = at;
+            x[at] = 0;
+        } else {
+            x[at] = before.col * step;
+        }
+        start = at + 1;
+    }
+    end_x[p.line] = p.col * step;
+    *lines = p.line + 1;
+    return true;
+}
@@ -0,0 +1,107 @@
+#include "include/profile.h"
+
+#ifdef PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+typedef struct {
+    const char *name;
+    unsigned long long start, dur;
+} Zone;
+
+typedef struct Ring {
+    Zone zones[PROFILE_RING_ZONES];
+    unsigned long long head;     // zones ever written (release by the owner)
+    int tid;
+    struct Ring *next;           // registry, pushed once, never removed
+} Ring;
+
+static Ring *rings = NULL;
+static int ring_count = 0;
+static _Thread_local Ring *my_ring = NULL;
+
+static unsigned long long now_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (unsigned long long)((double)t.QuadPart * 1e9 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// first zone of a thread: a ring of its own, linked in without a lock
+static Ring* thread_ring(void) {
+    Ring *r = (Ring*)calloc(1, sizeof(Ring));
+    r->tid = __atomic_add_fetch(&ring_count, 1, __ATOMIC_RELAXED);
+    Ring *head = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+    do {
+        r->next = head;
+    } while (!__atomic_compare_exchange_n(&rings, &head, r, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    my_ring = r;
+    return r;
+}
+
+ProfileZone profile_begin(const char *name) {
+    return (ProfileZone){ name, now_ns() };
+}
+
+void profile_end(ProfileZone *zone) {
+    unsigned long long end = now_ns();
+    Ring *r = my_ring ? my_ring : thread_ring();
+    unsigned long long h = r->head;
+    Zone *z = &r->zones[h % PROFILE_RING_ZONES];
+    __atomic_store_n(&z->name, zone->name, __ATOMIC_RELAXED);
+    __atomic_store_n(&z->start, zone->start, __ATOMIC_RELAXED);
+    __atomic_store_n(&z->dur, end - zone->start, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+bool profile_dump(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return false;
+    Zone *copy = (Zone*)malloc(sizeof(Zone) * PROFILE_RING_ZONES);
+    bool first = true;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (Ring *r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        unsigned long long h1 = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        unsigned long long from = (h1 > PROFILE_RING_ZONES) ? h1 - PROFILE_RING_ZONES : 0;
+        for (unsigned long long i = from; i < h1; i++) {
+            Zone *z = &r->zones[i % PROFILE_RING_ZONES];
+            Zone *c = &copy[i - from];
+            c->name = __atomic_load_n(&z->name, __ATOMIC_RELAXED);
+            c->start = __atomic_load_n(&z->start, __ATOMIC_RELAXED);
+            c->dur = __atomic_load_n(&z->dur, __ATOMIC_RELAXED);
+        }
+        // slots the owner reused while we copied are torn, and so may be
+        // the slot of zone h2, which it can be writing right now
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        unsigned long long h2 = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+        unsigned long long valid = (h2 + 1 > PROFILE_RING_ZONES) ? h2 + 1 - PROFILE_RING_ZONES : 0;
+        if (valid < from) valid = from;
+
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                first ? "" : ",\n", r->tid, r->tid);
+        first = false;
+        for (unsigned long long i = valid; i < h1; i++) {
+            const Zone *c = &copy[i - from];
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    c->name, r->tid, c->start / 1000.0, c->dur / 1000.0);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    free(copy);
+    return fclose(f) == 0;
+}
+
+#endif
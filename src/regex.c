@@ -0,0 +1,996 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/regex.h"
+#include "include/search.h"
+#include "include/utf8.h"
+#define ALLOC_SUBSYSTEM ALLOC_SEARCH
+#include "include/alloc_stats.h"
+
+#define MAX_PROGRAM 10000
+#define MAX_REPEAT 1000
+
+typedef enum { OP_SET, OP_SPLIT, OP_JMP, OP_SAVE, OP_BOL, OP_EOL, OP_MATCH } Op;
+
+typedef struct {
+    int op;
+    int x;   // SET: set index, SPLIT / JMP: target (preferred), SAVE: slot
+    int y;   // SPLIT: second target
+} Inst;
+
+typedef struct {
+    unsigned char bits[32];
+} ByteSet;
+
+struct Regex {
+    Inst *prog;
+    int len;
+    ByteSet *sets;
+    int nsets;
+    int groups;                    // including group 0
+    unsigned char class_of[256];   // byte -> equivalence class
+    int nclasses;
+    char *prefix;                  // literal every match starts with
+    int prefix_len;
+};
+
+static inline bool set_has(const ByteSet *s, unsigned char b) {
+    return (s->bits[b >> 3] >> (b & 7)) & 1;
+}
+
+static inline void set_add(ByteSet *s, unsigned char b) {
+    s->bits[b >> 3] |= (unsigned char)(1 << (b & 7));
+}
+
+// the fixed sets every '.' / negated class uses for non-ascii codepoints
+enum { SET_LEAD2, SET_LEAD3, SET_LEAD4, SET_CONT, SET_FIXED };
+
+// ============================================================================
+// parser
+// ============================================================================
+
+typedef enum { N_EMPTY, N_SET, N_CONCAT, N_ALT, N_REPEAT, N_GROUP, N_BOL, N_EOL } NodeType;
+
+typedef struct {
+    NodeType type;
+    int a, b;          // children
+    int set;           // N_SET
+    bool multibyte;    // N_SET: also any non-ascii codepoint
+    int min, max;      // N_REPEAT (max -1 = unbounded)
+    bool greedy;
+    int cap;           // N_GROUP (-1 = non-capturing)
+} Node;
+
+typedef struct {
+    const char *p;
+    const char *end;
+    Node *nodes;
+    int count, cap;
+    ByteSet *sets;
+    int nsets, sets_cap;
+    int groups;
+    char *error;
+    int error_size;
+    bool failed;
+} Parser;
+
+static int fail(Parser *ps, const char *msg) {
+    if (!ps->failed) snprintf(ps->error, ps->error_size, "%s", msg);
+    ps->failed = true;
+    return -1;
+}
+
+static int new_node(Parser *ps, NodeType type) {
+    if (ps->count == ps->cap) {
+        ps->cap = ps->cap ? ps->cap * 2 : 64;
+        ps->nodes = (Node*)realloc(ps->nodes, ps->cap * sizeof(Node));
+    }
+    Node *n = &ps->nodes[ps->count];
+    memset(n, 0, sizeof(*n));
+    n->type = type;
+    n->a = n->b = -1;
+    n->cap = -1;
+    return ps->count++;
+}
+
+static int new_set(Parser *ps) {
+    if (ps->nsets == ps->sets_cap) {
+        ps->sets_cap = ps->sets_cap ? ps->sets_cap * 2 : 16;
+        ps->sets = (ByteSet*)realloc(ps->sets, ps->sets_cap * sizeof(ByteSet));
+    }
+    memset(&ps->sets[ps->nsets], 0, sizeof(ByteSet));
+    return ps->nsets++;
+}
+
+static int binary(Parser *ps, NodeType type, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    int n = new_node(ps, type);
+    ps->nodes[n].a = a;
+    ps->nodes[n].b = b;
+    return n;
+}
+
+static int byte_node(Parser *ps, unsigned char c) {
+    int n = new_node(ps, N_SET);
+    ps->nodes[n].set = new_set(ps);
+    set_add(&ps->sets[ps->nodes[n].set], c);
+    return n;
+}
+
+// one codepoint as a sequence of byte nodes
+static int literal_node(Parser *ps, const char *s, int n) {
+    int node = -1;
+    for (int i = 0; i < n; i++) node = binary(ps, N_CONCAT, node, byte_node(ps, (unsigned char)s[i]));
+    return node;
+}
+
+// \d \w \s (and negations) into set. returns false if c is not a class letter.
+static bool class_escape(ByteSet *set, char c, bool *negated) {
+    ByteSet tmp = { { 0 } };
+    switch (c | 0x20) {
+    case 'd':
+        for (int b = '0'; b <= '9'; b++) set_add(&tmp, b);
+        break;
+    case 'w':
+        for (int b = 0; b < 128; b++) {
+            if ((b >= '0' && b <= '9') || (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || b == '_') set_add(&tmp, b);
+        }
+        break;
+    case 's':
+        set_add(&tmp, ' '); set_add(&tmp, '\t'); set_add(&tmp, '\r'); set_add(&tmp, '\f'); set_add(&tmp, '\v');
+        break;
+    default:
+        return false;
+    }
+    *negated = (c >= 'A' && c <= 'Z');
+    for (int b = 0; b < 128; b++) {
+        if (set_has(&tmp, b) != *negated) set_add(set, b);
+    }
+    return true;
+}
+
+static int escape_byte(Parser *ps, char c) {
+    switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case '0': return '\0';
+    case 'x': {
+        int v = 0;
+        for (int k = 0; k < 2; k++) {
+            if (ps->p >= ps->end) return fail(ps, "bad \\x escape");
+            char h = *ps->p++;
+            int d = (h >= '0' && h <= '9') ? h - '0' : ((h | 0x20) >= 'a' && (h | 0x20) <= 'f') ? (h | 0x20) - 'a' + 10 : -1;
+            if (d < 0) return fail(ps, "bad \\x escape");
+            v = v * 16 + d;
+        }
+        return v;
+    }
+    default:
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) return fail(ps, "unknown escape");
+        return (unsigned char)c;
+    }
+}
+
+static int parse_alt(Parser *ps);
+
+static int parse_class(Parser *ps) {
+    bool negate = false;
+    if (ps->p < ps->end && *ps->p == '^') { negate = true; ps->p++; }
+
+    int node = new_node(ps, N_SET);
+    int set = new_set(ps);
+    ps->nodes[node].set = set;
+    int others = -1;   // non-ascii members, as alternatives
+    bool first = true;
+    bool multibyte = false;
+
+    while (ps->p < ps->end && (*ps->p != ']' || first)) {
+        first = false;
+        int lo;
+        unsigned char c = (unsigned char)*ps->p;
+
+        if (c == '\\' && ps->p + 1 < ps->end) {
+            ps->p += 2;
+            bool neg;
+            if (class_escape(&ps->sets[set], ps->p[-1], &neg)) {
+                if (neg) multibyte = true;
+                continue;
+            }
+            lo = escape_byte(ps, ps->p[-1]);
+            if (lo < 0) return -1;
+        } else if (c >= 0x80) {
+            int cp;
+            int n = utf8_decode(ps->p, ps->end - ps->p, &cp);
+            if (negate) return fail(ps, "non-ascii in negated class");
+            if (ps->p + n < ps->end && ps->p[n] == '-' && ps->p + n + 1 < ps->end && ps->p[n + 1] != ']') {
+                return fail(ps, "non-ascii class ranges are not supported");
+            }
+            others = binary(ps, N_ALT, others, literal_node(ps, ps->p, n));
+            ps->p += n;
+            continue;
+        } else {
+            lo = c;
+            ps->p++;
+        }
+
+        int hi = lo;
+        if (ps->p + 1 < ps->end && *ps->p == '-' && ps->p[1] != ']') {
+            ps->p++;
+            unsigned char d = (unsigned char)*ps->p;
+            if (d == '\\' && ps->p + 1 < ps->end) {
+                ps->p += 2;
+                hi = escape_byte(ps, ps->p[-1]);
+                if (hi < 0) return -1;
+            } else if (d >= 0x80) {
+                return fail(ps, "non-ascii class ranges are not supported");
+            } else {
+                hi = d;
+                ps->p++;
+            }
+            if (hi < lo) return fail(ps, "bad class range");
+        }
+        for (int b = lo; b <= hi; b++) set_add(&ps->sets[set], (unsigned char)b);
+    }
+    if (ps->p >= ps->end) return fail(ps, "missing ]");
+    ps->p++;
+
+    ByteSet *s = &ps->sets[set];
+    if (negate) {
+        for (int b = 0; b < 32; b++) s->bits[b] = (b < 16) ? (unsigned char)~s->bits[b] : 0;
+        multibyte = true;
+    }
+    ps->nodes[node].multibyte = multibyte;
+    return binary(ps, N_ALT, node, others);
+}
+
+static int parse_atom(Parser *ps) {
+    unsigned char c = (unsigned char)*ps->p;
+    switch (c) {
+    case '(': {
+        ps->p++;
+        int cap = -1;
+        if (ps->end - ps->p >= 2 && ps->p[0] == '?' && ps->p[1] == ':') {
+            ps->p += 2;
+        } else {
+            cap = ps->groups++;
+        }
+        int inner = parse_alt(ps);
+        if (ps->failed) return -1;
+        if (ps->p >= ps->end || *ps->p != ')') return fail(ps, "missing )");
+        ps->p++;
+        int n = new_node(ps, N_GROUP);
+        ps->nodes[n].a = inner;
+        ps->nodes[n].cap = cap;
+        return n;
+    }
+    case '[':
+        ps->p++;
+        return parse_class(ps);
+    case '.': {
+        ps->p++;
+        int n = new_node(ps, N_SET);
+        ps->nodes[n].set = new_set(ps);
+        for (int b = 0; b < 128; b++) set_add(&ps->sets[ps->nodes[n].set], b);
+        ps->nodes[n].multibyte = true;
+        return n;
+    }
+    case '^':
+        ps->p++;
+        return new_node(ps, N_BOL);
+    case '$':
+        ps->p++;
+        return new_node(ps, N_EOL);
+    case '*': case '+': case '?': case '{':
+        return fail(ps, "nothing to repeat");
+    case '\\': {
+        if (ps->p + 1 >= ps->end) return fail(ps, "trailing \\");
+        ps->p += 2;
+        int n = new_node(ps, N_SET);
+        ps->nodes[n].set = new_set(ps);
+        bool neg;
+        if (class_escape(&ps->sets[ps->nodes[n].set], ps->p[-1], &neg)) {
+            ps->nodes[n].multibyte = neg;
+            return n;
+        }
+        int b = escape_byte(ps, ps->p[-1]);
+        if (b < 0) return -1;
+        set_add(&ps->sets[ps->nodes[n].set], (unsigned char)b);
+        return n;
+    }
+    default:
+        if (c >= 0x80) {
+            int cp;
+            int n = utf8_decode(ps->p, ps->end - ps->p, &cp);
+            int node = literal_node(ps, ps->p, n);
+            ps->p += n;
+            // a quantifier applies to the whole codepoint
+            int g = new_node(ps, N_GROUP);
+            ps->nodes[g].a = node;
+            return g;
+        }
+        ps->p++;
+        return byte_node(ps, c);
+    }
+}
+
+static bool parse_int(Parser *ps, int *out) {
+    if (ps->p >= ps->end || *ps->p < '0' || *ps->p > '9') return false;
+    int v = 0;
+    while (ps->p < ps->end && *ps->p >= '0' && *ps->p <= '9') {
+        v = v * 10 + (*ps->p++ - '0');
+        if (v > MAX_REPEAT) v = MAX_REPEAT + 1;
+    }
+    *out = v;
+    return true;
+}
+
+static int parse_repeat(Parser *ps) {
+    int atom = parse_atom(ps);
+    while (!ps->failed && ps->p < ps->end) {
+        int min, max;
+        char c = *ps->p;
+        if (c == '*') { min = 0; max = -1; ps->p++; }
+        else if (c == '+') { min = 1; max = -1; ps->p++; }
+        else if (c == '?') { min = 0; max = 1; ps->p++; }
+        else if (c == '{') {
+            ps->p++;
+            if (!parse_int(ps, &min)) return fail(ps, "bad {m,n}");
+            max = min;
+            if (ps->p < ps->end && *ps->p == ',') {
+                ps->p++;
+                if (!parse_int(ps, &max)) max = -1;
+            }
+            if (ps->p >= ps->end || *ps->p != '}') return fail(ps, "bad {m,n}");
+            ps->p++;
+            if (min > MAX_REPEAT || max > MAX_REPEAT || (max >= 0 && max < min)) return fail(ps, "bad {m,n}");
+        }
+        else break;
+
+        int n = new_node(ps, N_REPEAT);
+        ps->nodes[n].a = atom;
+        ps->nodes[n].min = min;
+        ps->nodes[n].max = max;
+        ps->nodes[n].greedy = true;
+        if (ps->p < ps->end && *ps->p == '?') { ps->nodes[n].greedy = false; ps->p++; }
+        atom = n;
+    }
+    return atom;
+}
+
+static int parse_concat(Parser *ps) {
+    int node = -1;
+    while (!ps->failed && ps->p < ps->end && *ps->p != '|' && *ps->p != ')') {
+        node = binary(ps, N_CONCAT, node, parse_repeat(ps));
+    }
+    return (node < 0) ? new_node(ps, N_EMPTY) : node;
+}
+
+static int parse_alt(Parser *ps) {
+    int node = parse_concat(ps);
+    while (!ps->failed && ps->p < ps->end && *ps->p == '|') {
+        ps->p++;
+        node = binary(ps, N_ALT, node, parse_concat(ps));
+    }
+    return node;
+}
+
+// ============================================================================
+// compiler
+// ============================================================================
+
+typedef struct {
+    Parser *ps;
+    Inst *prog;
+    int len, cap;
+    bool overflow;
+} Compiler;
+
+static int put(Compiler *c, int op, int x, int y) {
+    if (c->len == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 64;
+        c->prog = (Inst*)realloc(c->prog, c->cap * sizeof(Inst));
+    }
+    if (c->len >= MAX_PROGRAM) c->overflow = true;
+    c->prog[c->len] = (Inst){ op, x, y };
+    return c->len++;
+}
+
+static void emit(Compiler *c, int node) {
+    if (c->overflow) return;
+    Node *n = &c->ps->nodes[node];
+    switch (n->type) {
+    case N_EMPTY:
+        break;
+    case N_SET:
+        if (!n->multibyte) {
+            put(c, OP_SET, n->set, 0);
+        } else {
+            // ascii set | 2-, 3- or 4-byte sequence
+            int s1 = put(c, OP_SPLIT, 0, 0);
+            c->prog[s1].x = c->len;
+            put(c, OP_SET, n->set, 0);
+            int j1 = put(c, OP_JMP, 0, 0);
+            c->prog[s1].y = c->len;
+            int s2 = put(c, OP_SPLIT, c->len + 1, 0);
+            put(c, OP_SET, SET_LEAD2, 0);
+            put(c, OP_SET, SET_CONT, 0);
+            int j2 = put(c, OP_JMP, 0, 0);
+            c->prog[s2].y = c->len;
+            int s3 = put(c, OP_SPLIT, c->len + 1, 0);
+            put(c, OP_SET, SET_LEAD3, 0);
+            for (int k = 0; k < 2; k++) put(c, OP_SET, SET_CONT, 0);
+            int j3 = put(c, OP_JMP, 0, 0);
+            c->prog[s3].y = c->len;
+            put(c, OP_SET, SET_LEAD4, 0);
+            for (int k = 0; k < 3; k++) put(c, OP_SET, SET_CONT, 0);
+            c->prog[j1].x = c->prog[j2].x = c->prog[j3].x = c->len;
+        }
+        break;
+    case N_CONCAT:
+        emit(c, n->a);
+        emit(c, c->ps->nodes[node].b);
+        break;
+    case N_ALT: {
+        int s = put(c, OP_SPLIT, 0, 0);
+        c->prog[s].x = c->len;
+        emit(c, n->a);
+        int j = put(c, OP_JMP, 0, 0);
+        c->prog[s].y = c->len;
+        emit(c, c->ps->nodes[node].b);
+        c->prog[j].x = c->len;
+        break;
+    }
+    case N_REPEAT: {
+        int a = n->a, min = n->min, max = n->max;
+        bool greedy = n->greedy;
+        for (int i = 0; i < min; i++) emit(c, a);
+        if (max < 0) {
+            int s = put(c, OP_SPLIT, 0, 0);
+            emit(c, a);
+            put(c, OP_JMP, s, 0);
+            c->prog[s].x = greedy ? s + 1 : c->len;
+            c->prog[s].y = greedy ? c->len : s + 1;
+        } else {
+            for (int i = min; i < max && !c->overflow; i++) {
+                int s = put(c, OP_SPLIT, 0, 0);
+                emit(c, a);
+                c->prog[s].x = greedy ? s + 1 : c->len;
+                c->prog[s].y = greedy ? c->len : s + 1;
+            }
+        }
+        break;
+    }
+    case N_GROUP: {
+        int cap = n->cap, a = n->a;
+        if (cap >= 0) put(c, OP_SAVE, 2 * cap, 0);
+        emit(c, a);
+        if (cap >= 0) put(c, OP_SAVE, 2 * cap + 1, 0);
+        break;
+    }
+    case N_BOL:
+        put(c, OP_BOL, 0, 0);
+        break;
+    case N_EOL:
+        put(c, OP_EOL, 0, 0);
+        break;
+    }
+}
+
+// leading literal bytes of the pattern (stops at the first non-literal)
+static void collect_prefix(Parser *ps, int node, char *out, int *len, bool *stop) {
+    if (*stop || node < 0) return;
+    Node *n = &ps->nodes[node];
+    switch (n->type) {
+    case N_CONCAT:
+        collect_prefix(ps, n->a, out, len, stop);
+        collect_prefix(ps, n->b, out, len, stop);
+        return;
+    case N_GROUP:
+        collect_prefix(ps, n->a, out, len, stop);
+        return;
+    case N_BOL:
+    case N_EMPTY:
+        return;
+    case N_SET: {
+        int count = 0, last = 0;
+        for (int b = 0; b < 256; b++) if (set_has(&ps->sets[n->set], b)) { count++; last = b; }
+        if (count == 1 && !n->multibyte && *len < 64) { out[(*len)++] = (char)last; return; }
+        break;
+    }
+    default:
+        break;
+    }
+    *stop = true;
+}
+
+Regex* regex_compile(const char *pattern, int len, char *error, int error_size) {
+    Parser ps = { 0 };
+    ps.p = pattern;
+    ps.end = pattern + len;
+    ps.error = error;
+    ps.error_size = error_size;
+    ps.groups = 1;
+
+    // fixed utf-8 sets first, see SET_*
+    for (int i = 0; i < SET_FIXED; i++) new_set(&ps);
+    for (int b = 0xC2; b <= 0xDF; b++) set_add(&ps.sets[SET_LEAD2], b);
+    for (int b = 0xE0; b <= 0xEF; b++) set_add(&ps.sets[SET_LEAD3], b);
+    for (int b = 0xF0; b <= 0xF4; b++) set_add(&ps.sets[SET_LEAD4], b);
+    for (int b = 0x80; b <= 0xBF; b++) set_add(&ps.sets[SET_CONT], b);
+
+    int root = parse_alt(&ps);
+    if (!ps.failed && ps.p < ps.end) fail(&ps, "unmatched )");
+
+    Compiler c = { &ps, NULL, 0, 0, false };
+    if (!ps.failed) {
+        put(&c, OP_SAVE, 0, 0);
+        emit(&c, root);
+        put(&c, OP_SAVE, 1, 0);
+        put(&c, OP_MATCH, 0, 0);
+        if (c.overflow) fail(&ps, "pattern too large");
+    }
+    if (ps.failed) {
+        free(ps.nodes);
+        free(ps.sets);
+        free(c.prog);
+        return NULL;
+    }
+
+    Regex *re = (Regex*)calloc(1, sizeof(Regex));
+    re->prog = c.prog;
+    re->len = c.len;
+    re->sets = ps.sets;
+    re->nsets = ps.nsets;
+    re->groups = ps.groups;
+
+    // matches never span lines
+    for (int i = 0; i < re->nsets; i++) re->sets[i].bits['\n' >> 3] &= (unsigned char)~(1 << ('\n' & 7));
+
+    // byte classes: bytes no set tells apart share dfa transitions.
+    // '\n' always gets its own class (line reset).
+    bool boundary[257] = { false };
+    boundary['\n'] = boundary['\n' + 1] = true;
+    for (int i = 0; i < re->nsets; i++) {
+        for (int b = 1; b < 256; b++) {
+            if (set_has(&re->sets[i], b) != set_has(&re->sets[i], b - 1)) boundary[b] = true;
+        }
+    }
+    int cls = 0;
+    for (int b = 0; b < 256; b++) {
+        if (b > 0 && boundary[b]) cls++;
+        re->class_of[b] = (unsigned char)cls;
+    }
+    re->nclasses = cls + 1;
+
+    char prefix[64];
+    int prefix_len = 0;
+    bool stop = false;
+    collect_prefix(&ps, root, prefix, &prefix_len, &stop);
+    if (prefix_len > 0) {
+        re->prefix = (char*)malloc(prefix_len);
+        memcpy(re->prefix, prefix, prefix_len);
+        re->prefix_len = prefix_len;
+    }
+
+    free(ps.nodes);
+    return re;
+}
+
+void regex_free(Regex *re) {
+    if (re == NULL) return;
+    free(re->prog);
+    free(re->sets);
+    free(re->prefix);
+    free(re);
+}
+
+int regex_group_count(const Regex *re) {
+    return re->groups;
+}
+
+const char* regex_prefix(const Regex *re, int *len) {
+    *len = re->prefix_len;
+    return re->prefix;
+}
+
+// ============================================================================
+// lazy dfa
+// ============================================================================
+
+typedef struct {
+    int pcs;           // offset into pc_pool
+    int n;
+    int next;          // offset into next_pool, nclasses entries (-1 = not built).
+                       // entries are targets as (next << 1 | match), see entry_of
+    unsigned hash;
+    bool line_start;
+    bool match;        // a match ends here
+    bool match_eol;    // ... if the line ends here
+} DState;
+
+typedef struct {
+    int *sparse;
+    int *dense;
+    int n;
+    int *caps;         // per pc, 2 * groups slots
+} ThreadList;
+
+struct RegexCache {
+    const Regex *re;
+    size_t max_bytes;
+    size_t used;
+    int flushes;
+
+    DState *states;
+    int count, cap;
+    int *pc_pool;
+    size_t pc_len, pc_cap;
+    int *next_pool;
+    size_t next_len, next_cap;
+    int *table;        // open addressing, state index + 1
+    int table_cap;
+    int start;         // line-start state, -1 = not built
+
+    // closure scratch
+    int *mark;
+    int generation;
+    int *stack;
+    int *leaves;
+    int nleaves;
+    int *seeds;
+
+    // pike vm, allocated on first use
+    ThreadList lists[2];
+    int *vm_stack;
+    int *vm_caps;
+};
+
+RegexCache* regex_cache_create(const Regex *re, size_t max_bytes) {
+    RegexCache *c = (RegexCache*)calloc(1, sizeof(RegexCache));
+    c->re = re;
+    c->max_bytes = max_bytes ? max_bytes : REGEX_CACHE_BYTES;
+    c->start = -1;
+    c->mark = (int*)calloc(re->len, sizeof(int));
+    c->stack = (int*)malloc((3 * re->len + 4) * sizeof(int));
+    c->leaves = (int*)malloc((re->len + 1) * sizeof(int));
+    c->seeds = (int*)malloc((re->len + 1) * sizeof(int));
+    c->table_cap = 256;
+    c->table = (int*)calloc(c->table_cap, sizeof(int));
+    return c;
+}
+
+void regex_cache_free(RegexCache *c) {
+    if (c == NULL) return;
+    free(c->states);
+    free(c->pc_pool);
+    free(c->next_pool);
+    free(c->table);
+    free(c->mark);
+    free(c->stack);
+    free(c->leaves);
+    free(c->seeds);
+    for (int i = 0; i < 2; i++) {
+        free(c->lists[i].sparse);
+        free(c->lists[i].dense);
+        free(c->lists[i].caps);
+    }
+    free(c->vm_stack);
+    free(c->vm_caps);
+    free(c);
+}
+
+static int cmp_int(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+// epsilon closure of seeds into c->leaves (sorted): the SET, EOL and
+// MATCH instructions reachable without consuming a byte. at_eol passes
+// through EOL instead of stopping there.
+static void closure(RegexCache *c, const int *seeds, int nseeds, bool line_start, bool at_eol) {
+    const Inst *prog = c->re->prog;
+    int gen = ++c->generation;
+    int top = 0;
+    c->nleaves = 0;
+    for (int i = nseeds - 1; i >= 0; i--) c->stack[top++] = seeds[i];
+
+    while (top > 0) {
+        int pc = c->stack[--top];
+        if (c->mark[pc] == gen) continue;
+        c->mark[pc] = gen;
+        switch (prog[pc].op) {
+        case OP_SPLIT: c->stack[top++] = prog[pc].y; c->stack[top++] = prog[pc].x; break;
+        case OP_JMP:   c->stack[top++] = prog[pc].x; break;
+        case OP_SAVE:  c->stack[top++] = pc + 1; break;
+        case OP_BOL:   if (line_start) c->stack[top++] = pc + 1; break;
+        case OP_EOL:   if (at_eol) c->stack[top++] = pc + 1; else c->leaves[c->nleaves++] = pc; break;
+        default:       c->leaves[c->nleaves++] = pc; break;
+        }
+    }
+    qsort(c->leaves, c->nleaves, sizeof(int), cmp_int);
+}
+
+static unsigned hash_leaves(const int *pcs, int n, bool line_start) {
+    unsigned h = line_start ? 0x9E3779B9u : 0x85EBCA6Bu;
+    for (int i = 0; i < n; i++) h = (h ^ (unsigned)pcs[i]) * 16777619u;
+    return h;
+}
+
+static void flush(RegexCache *c) {
+    c->count = 0;
+    c->pc_len = 0;
+    c->next_len = 0;
+    c->used = 0;
+    c->start = -1;
+    memset(c->table, 0, c->table_cap * sizeof(int));
+    c->flushes++;
+}
+
+static void table_insert(RegexCache *c, int index) {
+    unsigned mask = (unsigned)c->table_cap - 1;
+    unsigned i = c->states[index].hash & mask;
+    while (c->table[i] != 0) i = (i + 1) & mask;
+    c->table[i] = index + 1;
+}
+
+// state for c->leaves, -1 if the cache is over budget
+static int add_state(RegexCache *c, bool line_start) {
+    const Regex *re = c->re;
+    unsigned h = hash_leaves(c->leaves, c->nleaves, line_start);
+    unsigned mask = (unsigned)c->table_cap - 1;
+    for (unsigned i = h & mask; c->table[i] != 0; i = (i + 1) & mask) {
+        DState *s = &c->states[c->table[i] - 1];
+        if (s->hash == h && s->line_start == line_start && s->n == c->nleaves
+            && memcmp(&c->pc_pool[s->pcs], c->leaves, c->nleaves * sizeof(int)) == 0) {
+            return c->table[i] - 1;
+        }
+    }
+
+    size_t cost = sizeof(DState) + (c->nleaves + re->nclasses) * sizeof(int) + 2 * sizeof(int);
+    if (c->count > 0 && c->used + cost > c->max_bytes) return -1;
+    c->used += cost;
+
+    if (c->count == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 64;
+        c->states = (DState*)realloc(c->states, c->cap * sizeof(DState));
+    }
+    if (c->pc_len + c->nleaves > c->pc_cap) {
+        while (c->pc_len + c->nleaves > c->pc_cap) c->pc_cap = c->pc_cap ? c->pc_cap * 2 : 1024;
+        c->pc_pool = (int*)realloc(c->pc_pool, c->pc_cap * sizeof(int));
+    }
+    if (c->next_len + re->nclasses > c->next_cap) {
+        while (c->next_len + re->nclasses > c->next_cap) c->next_cap = c->next_cap ? c->next_cap * 2 : 1024;
+        c->next_pool = (int*)realloc(c->next_pool, c->next_cap * sizeof(int));
+    }
+    if ((c->count + 1) * 2 > c->table_cap) {
+        free(c->table);
+        c->table_cap *= 2;
+        c->table = (int*)calloc(c->table_cap, sizeof(int));
+        for (int i = 0; i < c->count; i++) table_insert(c, i);
+    }
+
+    int index = c->count++;
+    DState *s = &c->states[index];
+    s->pcs = (int)c->pc_len;
+    s->n = c->nleaves;
+    s->next = (int)c->next_len;
+    s->hash = h;
+    s->line_start = line_start;
+    s->match = false;
+    s->match_eol = false;
+    memcpy(&c->pc_pool[s->pcs], c->leaves, c->nleaves * sizeof(int));
+    c->pc_len += c->nleaves;
+    for (int k = 0; k < re->nclasses; k++) c->next_pool[s->next + k] = -1;
+    c->next_len += re->nclasses;
+    table_insert(c, index);
+
+    int eol_seeds = 0;
+    for (int k = 0; k < s->n; k++) {
+        int pc = c->pc_pool[s->pcs + k];
+        if (re->prog[pc].op == OP_MATCH) s->match = true;
+        if (re->prog[pc].op == OP_EOL) c->seeds[eol_seeds++] = pc;
+    }
+    if (eol_seeds > 0 && !s->match) {
+        closure(c, c->seeds, eol_seeds, line_start, true);
+        for (int k = 0; k < c->nleaves; k++) {
+            if (re->prog[c->leaves[k]].op == OP_MATCH) s->match_eol = true;
+        }
+    }
+    return index;
+}
+
+static int start_state(RegexCache *c) {
+    if (c->start < 0) {
+        int seed = 0;
+        closure(c, &seed, 1, true, false);
+        c->start = add_state(c, true);
+        if (c->start < 0) {
+            flush(c);
+            c->start = add_state(c, true);
+        }
+    }
+    return c->start;
+}
+
+// what transitions store: the target's row, low bit = match ends there.
+// the scan loop then needs a single dependent load per byte.
+static inline int entry_of(const RegexCache *c, int s) {
+    return (c->states[s].next << 1) | c->states[s].match;
+}
+
+static inline int state_of(const RegexCache *c, int entry) {
+    return (entry >> 1) / c->re->nclasses;
+}
+
+// transition on a byte other than '\n'. flushes the cache when full.
+static int next_state(RegexCache *c, int s, unsigned char b) {
+    const Regex *re = c->re;
+    DState *st = &c->states[s];
+    int n = 0;
+    for (int k = 0; k < st->n; k++) {
+        int pc = c->pc_pool[st->pcs + k];
+        if (re->prog[pc].op == OP_SET && set_has(&re->sets[re->prog[pc].x], b)) c->seeds[n++] = pc + 1;
+    }
+    c->seeds[n++] = 0;   // unanchored: a match may start at every byte
+
+    closure(c, c->seeds, n, false, false);
+    int t = add_state(c, false);
+    if (t < 0) {
+        // over budget: drop every state, keep going from this one
+        flush(c);
+        return entry_of(c, add_state(c, false));
+    }
+    int e = entry_of(c, t);
+    c->next_pool[c->states[s].next + re->class_of[b]] = e;
+    return e;
+}
+
+static bool dfa_scan(RegexCache *c, const char *text, size_t from, size_t to, size_t *line_start, size_t *line_end) {
+    const unsigned char *u = (const unsigned char*)text;
+    const unsigned char *class_of = c->re->class_of;
+    int e = entry_of(c, start_state(c));
+    size_t line = from;
+    size_t i = from;
+
+    for (; i < to; i++) {
+        if (e & 1) goto found;
+        unsigned char b = u[i];
+        if (b == '\n') {
+            if (c->states[state_of(c, e)].match_eol) goto found;
+            line = i + 1;
+            e = entry_of(c, start_state(c));
+            continue;
+        }
+        int t = c->next_pool[(e >> 1) + class_of[b]];
+        e = (t >= 0) ? t : next_state(c, state_of(c, e), b);
+    }
+    if ((e & 1) || c->states[state_of(c, e)].match_eol) goto found;
+    return false;
+
+found:
+    *line_start = line;
+    const char *nl = (i < to) ? (const char*)memchr(&text[i], '\n', to - i) : NULL;
+    *line_end = nl ? (size_t)(nl - text) : to;
+    return true;
+}
+
+bool regex_find_line(RegexCache *c, const char *text, size_t len, size_t from,
+                     size_t *line_start, size_t *line_end) {
+    const Regex *re = c->re;
+    if (re->prefix_len == 0) return dfa_scan(c, text, from, len, line_start, line_end);
+
+    // every match starts with the prefix: only lines holding it are run
+    SearchQuery q = { 0 };
+    q.needle = re->prefix;
+    q.len = re->prefix_len;
+    size_t pos = from;
+    while (pos < len) {
+        const char *hit = search_find(&q, &text[pos], len - pos);
+        if (hit == NULL) return false;
+        size_t at = (size_t)(hit - text);
+        size_t ls = at;
+        while (ls > pos && text[ls - 1] != '\n') ls--;
+        const char *nl = (const char*)memchr(hit, '\n', len - at);
+        size_t le = nl ? (size_t)(nl - text) : len;
+        if (dfa_scan(c, text, ls, le, line_start, line_end)) return true;
+        pos = le + 1;
+    }
+    return false;
+}
+
+// ============================================================================
+// pike vm
+// ============================================================================
+
+// follows epsilon edges from pc at position i, threads land in l in priority order
+static void add_thread(RegexCache *c, ThreadList *l, int pc0, int *caps, size_t i, size_t ls, size_t le) {
+    const Inst *prog = c->re->prog;
+    int ncap = 2 * c->re->groups;
+    int *stack = c->vm_stack;
+    int top = 0;
+
+    // entries: pc >= 0, or a capture restore encoded as (-1 - slot, value)
+    stack[top++] = pc0;
+    while (top > 0) {
+        int pc = stack[--top];
+        if (pc < 0) {
+            int value = stack[--top];
+            caps[-1 - pc] = value;
+            continue;
+        }
+        for (;;) {
+            if (l->sparse[pc] < l->n && l->dense[l->sparse[pc]] == pc) break;
+            l->sparse[pc] = l->n;
+            l->dense[l->n++] = pc;
+
+            const Inst *in = &prog[pc];
+            if (in->op == OP_JMP) { pc = in->x; continue; }
+            if (in->op == OP_SPLIT) { stack[top++] = in->y; pc = in->x; continue; }
+            if (in->op == OP_SAVE) {
+                stack[top++] = caps[in->x];
+                stack[top++] = -1 - in->x;
+                caps[in->x] = (int)i;
+                pc++;
+                continue;
+            }
+            if (in->op == OP_BOL) { if (i != ls) break; pc++; continue; }
+            if (in->op == OP_EOL) { if (i != le) break; pc++; continue; }
+            memcpy(&l->caps[pc * ncap], caps, ncap * sizeof(int));
+            break;
+        }
+    }
+}
+
+bool regex_match(RegexCache *c, const char *text, size_t line_start, size_t line_end,
+                 size_t from, int *groups, int ngroups) {
+    const Regex *re = c->re;
+    int ncap = 2 * re->groups;
+    if (c->vm_stack == NULL) {
+        for (int k = 0; k < 2; k++) {
+            c->lists[k].sparse = (int*)calloc(re->len, sizeof(int));
+            c->lists[k].dense = (int*)malloc(re->len * sizeof(int));
+            c->lists[k].caps = (int*)malloc((size_t)re->len * ncap * sizeof(int));
+        }
+        c->vm_stack = (int*)malloc((4 * re->len + 4) * sizeof(int));
+        c->vm_caps = (int*)malloc(ncap * sizeof(int));
+    }
+
+    ThreadList *clist = &c->lists[0], *nlist = &c->lists[1];
+    clist->n = 0;
+    bool matched = false;
+    const unsigned char *u = (const unsigned char*)text;
+
+    for (size_t i = from; ; i++) {
+        if (!matched) {
+            for (int k = 0; k < ncap; k++) c->vm_caps[k] = -1;
+            add_thread(c, clist, 0, c->vm_caps, i, line_start, line_end);
+        }
+        if (clist->n == 0) break;
+
+        nlist->n = 0;
+        for (int k = 0; k < clist->n; k++) {
+            int pc = clist->dense[k];
+            const Inst *in = &re->prog[pc];
+            int *caps = &clist->caps[pc * ncap];
+            if (in->op == OP_SET) {
+                if (i < line_end && set_has(&re->sets[in->x], u[i])) {
+                    memcpy(c->vm_caps, caps, ncap * sizeof(int));
+                    add_thread(c, nlist, pc + 1, c->vm_caps, i + 1, line_start, line_end);
+                }
+            } else if (in->op == OP_MATCH) {
+                if ((size_t)caps[0] == i) continue;  // empty match
+                matched = true;
+                memcpy(groups, caps, (ncap < 2 * ngroups ? ncap : 2 * ngroups) * sizeof(int));
+                break;  // lower priority threads lose
+            }
+        }
+        ThreadList *t = clist; clist = nlist; nlist = t;
+        if (i >= line_end) break;
+    }
+
+    for (int k = ncap; k < 2 * ngroups; k++) groups[k] = -1;
+    return matched;
+}
@@ -0,0 +1,190 @@
+#include "include/render.h"
+#include "include/mono.h"
+#include "include/profile.h"
+
+// unique across layouts, so a cache never mistakes one layout for another
+static unsigned last_gen = 0;
+
+// a fixed advance and how many glyphs fit on a line, placing them exactly
+// as the general path does so both wrap at the same glyph
+static void detect_mono(Layout *lo) {
+    float a = lo->ascii[' '];
+    lo->mono = a;
+    lo->mono_cols = 0;
+    for (int c = ' ' + 1; c < 127; c++) {
+        if (lo->ascii[c] != a) lo->mono = 0;
+    }
+    // below a pixel the half pixel slack of layout_tab could skip a stop
+    if (lo->mono < 1) {
+        lo->mono = 0;
+        return;
+    }
+    int cols = 0;
+    float x = 0;
+    while (layout_fits(lo, x, a)) {
+        // an absurdly narrow glyph: not worth the division
+        if (++cols > (1 << 16)) return;
+        x += a + lo->spacing;
+    }
+    lo->mono_cols = cols;
+}
+
+void layout_init(Layout *lo, MeasureFn measure, void *user, float max_width, int line_height) {
+    lo->measure = measure;
+    lo->user = user;
+    for (int c = 0; c < 128; c++) lo->ascii[c] = measure(user, c);
+    lo->max_width = max_width;
+    lo->spacing = 1.0f;
+    lo->line_height = line_height;
+    lo->pad = 4;
+    lo->gap = 2;
+    lo->tab_width = 4;
+    lo->gen = ++last_gen;
+    detect_mono(lo);
+}
+
+void layout_changed(Layout *lo) {
+    if (lo->tab_width < 1) lo->tab_width = 1;
+    lo->gen = ++last_gen;
+    detect_mono(lo);
+}
+
+// advance of the glyph at text[i] with the pen at (*line, *px). one that
+// would pass max_width goes to the next line first; a tab is measured
+// again there.
+static inline float place(const Layout *lo, const char *text, int len, int i, int *n, int *line, float *px) {
+    float w = layout_width_at(lo, text, len, i, n);
+    if (text[i] == '\t') w = layout_tab(lo, *px);
+    if (!layout_fits(lo, *px, w)) {
+        (*line)++;
+        *px = 0;
+        if (text[i] == '\t') w = layout_tab(lo, 0);
+    }
+    return w;
+}
+
+int layout_line_count(const Layout *lo, const char *text, int len) {
+    int n = 1;
+    if (mono_active(lo, len) && mono_line_count(lo, text, len, &n)) return n;
+    int lines = 1;
+    float x = 0;
+    for (int i = 0; i < len; i += n) {
+        if (text[i] == '\n') { lines++; x = 0; n = 1; continue; }
+        float w = place(lo, text, len, i, &n, &lines, &x);
+        x += w + lo->spacing;
+    }
+    return lines;
+}
+
+int layout_line_map(const Layout *lo, const char *text, int len, int *starts, float *end_x, float *x) {
+    int n = 1;
+    if (mono_active(lo, len) && mono_line_map(lo, text, len, starts, end_x, x, &n)) return n;
+    int line = 0;
+    float px = 0;
+    starts[0] = 0;
+    for (int i = 0; i < len; i += n) {
+        if (text[i] == '\n') {
+            x[i] = px;
+            end_x[line++] = px;
+            starts[line] = i + 1;
+            px = 0;
+            n = 1;
+            continue;
+        }
+        int was = line;
+        float before = px;
+        float w = place(lo, text, len, i, &n, &line, &px);
+        if (line != was) {
+            end_x[was] = before;
+            starts[line] = i;
+        }
+        for (int k = 0; k < n; k++) x[i + k] = px;
+        px += w + lo->spacing;
+    }
+    end_x[line] = px;
+    return line + 1;
+}
+
+void layout_caret(const Layout *lo, const char *text, int len, int index, int *line, float *x) {
+    if (mono_active(lo, len) && mono_caret(lo, text, len, index, line, x)) return;
+    int n = 1;
+    int l = 0;
+    float px = 0;
+    for (int i = 0; i < index && i < len; i += n) {
+        if (text[i] == '\n') { l++; px = 0; n = 1; continue; }
+        float w = place(lo, text, len, i, &n, &l, &px);
+        px += w + lo->spacing;
+    }
+    *line = l;
+    *x = px;
+}
+
+int layout_hit_test(const Layout *lo, const char *text, int len, float x, float y, bool left_margin) {
+    PROFILE_SCOPE("layout_hit_test");
+    int index = 0;
+    if (mono_active(lo, len) && mono_hit_test(lo, text, len, x, y, left_margin, &index)) return index;
+    int n = 1;
+    int line = 0;
+    float px = 0;
+    float min_dist = 100000.0f;
+
+    for (int i = 0; i <= len; i += n) {
+        n = 1;
+        float line_top = line * lo->line_height;
+        float line_bottom = line_top + lo->line_height;
+        bool on_this_line = (y >= line_top && y < line_bottom);
+        if (i == len && y >= line_bottom) on_this_line = true;
+
+        if (on_this_line) {
+            if (left_margin && px == 0) return i;
+            float dist = (x > px) ? (x - px) : (px - x);
+            if (dist < min_dist) { min_dist = dist; index = i; }
+        }
+
+        if (i < len) {
+            if (text[i] == '\n') { line++; px = 0; continue; }
+            float w = place(lo, text, len, i, &n, &line, &px);
+            px += w + lo->spacing;
+        }
+    }
+    return index;
+}
+
+void layout_begin(LayoutIter *it, const Layout *lo, const char *text, int len) {
+    it->lo = lo;
+    it->text = text;
+    it->len = len;
+    it->i = 0;
+    it->n = 0;
+    it->next_line = 0;
+    it->next_x = 0;
+}
+
+bool layout_next(LayoutIter *it) {
+    it->i += it->n;
+    if (it->i >= it->len) return false;
+    it->line = it->next_line;
+    it->x = it->next_x;
+
+    if (it->text[it->i] == '\n') {
+        it->n = 1;
+        it->cp = '\n';
+        it->w = 0;
+        it->next_line = it->line + 1;
+        it->next_x = 0;
+        return true;
+    }
+    unsigned char c = (unsigned char)it->text[it->i];
+    it->cp = c;
+    it->n = 1;
+    if (c >= 0x80) it->n = utf8_decode(&it->text[it->i], (size_t)(it->len - it->i), &it->cp);
+    it->w = (c == '\t') ? layout_tab(it->lo, it->x) : layout_advance(it->lo, it->cp);
+    if (!layout_fits(it->lo, it->x, it->w)) {
+        it->line++;
+        it->x = 0;
+        if (c == '\t') it->w = layout_tab(it->lo, 0);
+    }
+    it->next_line = it->line;
+    it->next_x = it->x + it->w + it->lo->spacing;
+    return true;
+}
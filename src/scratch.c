@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include "include/scratch.h"
+#define ALLOC_SUBSYSTEM ALLOC_OTHER
+#include "include/alloc_stats.h"
+
+#define MAX_CHUNKS 32   // each at least twice the one before
+
+typedef struct {
+    char *data;
+    size_t cap;
+} Chunk;
+
+static Chunk chunks[MAX_CHUNKS];
+static int chunk_count = 0;
+static int current = 0;
+static size_t used = 0;       // in chunks[current]
+static size_t below = 0;      // capacity of the chunks before current
+static size_t peak = 0;
+
+void* scratch_alloc(size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if (current >= chunk_count || used + size > chunks[current].cap) {
+        // the next chunk, opened (or reopened bigger) as needed
+        int next = (current < chunk_count) ? current + 1 : current;
+        if (next >= MAX_CHUNKS) abort();
+        size_t cap = (next > 0) ? chunks[next - 1].cap * 2 : SCRATCH_CHUNK_BYTES;
+        while (cap < size) cap *= 2;
+        if (next < chunk_count && chunks[next].cap < cap) {
+            // too small for this request: later chunks go with it
+            for (int i = next; i < chunk_count; i++) free(chunks[i].data);
+            chunk_count = next;
+        }
+        if (next == chunk_count) {
+            chunks[next].data = (char*)malloc(cap);
+            chunks[next].cap = cap;
+            chunk_count++;
+        }
+        if (current < next) below += chunks[current].cap;
+        current = next;
+        used = 0;
+    }
+    void *p = &chunks[current].data[used];
+    used += size;
+    if (below + used > peak) peak = below + used;
+    return p;
+}
+
+ScratchMark scratch_begin(void) {
+    return (ScratchMark){ current, used };
+}
+
+void scratch_end(ScratchMark mark) {
+    while (current > mark.chunk) {
+        current--;
+        below -= chunks[current].cap;
+    }
+    used = mark.used;
+}
+
+void scratch_frame_reset(void) {
+    // a frame that spilled over: one chunk big enough for it from now on
+    if (chunk_count > 1 || (chunk_count == 1 && peak > chunks[0].cap)) {
+        size_t cap = SCRATCH_CHUNK_BYTES;
+        while (cap < peak && cap < SCRATCH_RETAIN_BYTES) cap *= 2;
+        for (int i = 0; i < chunk_count; i++) free(chunks[i].data);
+        chunks[0].data = (char*)malloc(cap);
+        chunks[0].cap = cap;
+        chunk_count = 1;
+    }
+    current = 0;
+    used = 0;
+    below = 0;
+    peak = 0;
+}
+
+size_t scratch_used(void) {
+    return below + used;
+}
+
+size_t scratch_peak(void) {
+    return peak;
+}
+
+void scratch_release(void) {
+    for (int i = 0; i < chunk_count; i++) free(chunks[i].data);
+    chunk_count = 0;
+    current = 0;
+    used = 0;
+    below = 0;
+    peak = 0;
+}
@@ -0,0 +1,404 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/search.h"
+#include "include/marker.h"
+#include "include/simd.h"
+#include "include/profile.h"
+#define ALLOC_SUBSYSTEM ALLOC_SEARCH
+#include "include/alloc_stats.h"
+
+// ----------------------------------------------------------------------------
+// byte kernels
+// ----------------------------------------------------------------------------
+
+static const char* find_scalar(const char *h, size_t n, const char *nd, size_t m) {
+    const char *p = h;
+    const char *end = h + n - m + 1;
+    while (p < end) {
+        p = (const char*)memchr(p, nd[0], end - p);
+        if (p == NULL) return NULL;
+        if (memcmp(p, nd, m) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+#ifdef SIMD_X86
+
+static const char* find_sse2(const char *h, size_t n, const char *nd, size_t m) {
+    const __m128i first = _mm_set1_epi8(nd[0]);
+    const __m128i last = _mm_set1_epi8(nd[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)&h[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&h[i + m - 1]);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask != 0) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(&h[at], nd, m) == 0) return &h[at];
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(&h[i], n - i, nd, m);
+}
+
+SIMD_TARGET_AVX2
+static const char* find_avx2(const char *h, size_t n, const char *nd, size_t m) {
+    const __m256i first = _mm256_set1_epi8(nd[0]);
+    const __m256i last = _mm256_set1_epi8(nd[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&h[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i*)&h[i + m - 1]);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (mask != 0) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(&h[at], nd, m) == 0) return &h[at];
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(&h[i], n - i, nd, m);
+}
+
+#endif
+
+typedef const char* (*FindFn)(const char *h, size_t n, const char *nd, size_t m);
+
+static FindFn kernel_fn(ScanKernel kernel) {
+#ifdef SIMD_X86
+    if (kernel == SCAN_AUTO) kernel = simd_has_avx2() ? SCAN_AVX2 : SCAN_SSE2;
+    if (kernel == SCAN_AVX2 && simd_has_avx2()) return find_avx2;
+    if (kernel == SCAN_SSE2 || kernel == SCAN_AVX2) return find_sse2;
+#else
+    (void)kernel;
+#endif
+    return find_scalar;
+}
+
+const char* search_find_with(ScanKernel kernel, const SearchQuery *q, const char *hay, size_t len) {
+    size_t m = (size_t)q->len;
+    if (m == 0 || m > len) return NULL;
+    if (m == 1) return (const char*)memchr(hay, q->needle[0], len);
+    return kernel_fn(kernel)(hay, len, q->needle, m);
+}
+
+const char* search_find(const SearchQuery *q, const char *hay, size_t len) {
+    static FindFn best = NULL;
+    size_t m = (size_t)q->len;
+    if (m < 2 || m > len) return search_find_with(SCAN_AUTO, q, hay, len);
+    // search job workers race here on first use; each picks the same kernel
+    FindFn fn = __atomic_load_n(&best, __ATOMIC_RELAXED);
+    if (fn == NULL) {
+        fn = kernel_fn(SCAN_AUTO);
+        __atomic_store_n(&best, fn, __ATOMIC_RELAXED);
+    }
+    return fn(hay, len, q->needle, m);
+}
+
+// ----------------------------------------------------------------------------
+// queries & block matching
+// ----------------------------------------------------------------------------
+
+bool search_query_init(SearchQuery *q, const char *needle, int len, int flags) {
+    q->needle = (char*)malloc(len + 1);
+    memcpy(q->needle, needle, len);
+    q->needle[len] = '\0';
+    q->len = len;
+    q->flags = flags;
+    q->cross_blocks = (flags & SEARCH_CROSS_BLOCKS) && !(flags & SEARCH_REGEX);
+    q->regex = NULL;
+    q->cache = NULL;
+    q->error[0] = '\0';
+
+    if ((flags & SEARCH_REGEX) && len > 0) {
+        q->regex = regex_compile(needle, len, q->error, sizeof(q->error));
+        if (q->regex == NULL) {
+            q->len = 0;
+            return false;
+        }
+        q->cache = regex_cache_create(q->regex, REGEX_CACHE_BYTES);
+    }
+    return true;
+}
+
+void search_query_free(SearchQuery *q) {
+    regex_cache_free(q->cache);
+    regex_free(q->regex);
+    free(q->needle);
+    q->needle = NULL;
+    q->regex = NULL;
+    q->cache = NULL;
+    q->len = 0;
+}
+
+// lazy blocks are read in place
+static const char* text_of(const Block *b) {
+    return b->text ? b->text : b->src;
+}
+
+// walks the needle from (b, p) through block boundaries
+static bool match_from(const SearchQuery *q, Block *b, int p, Block **end_block, int *end) {
+    const char *t = text_of(b);
+    int len = block_len(b);
+    int i = p;
+    for (int k = 0; k < q->len; ) {
+        if (i < len) {
+            if (t[i] != q->needle[k]) return false;
+            i++; k++;
+        } else {
+            if (b->next == NULL || q->needle[k] != SEARCH_BLOCK_SEP) return false;
+            k++;
+            b = b->next;
+            t = text_of(b);
+            len = block_len(b);
+            i = 0;
+        }
+    }
+    *end_block = b;
+    *end = i;
+    return true;
+}
+
+// regex: the dfa picks lines, the vm runs on those only
+static bool regex_in_block(const SearchQuery *q, Block *b, int from, SearchMatch *out) {
+    const char *t = text_of(b);
+    size_t len = (size_t)block_len(b);
+    if ((size_t)from > len) return false;
+
+    size_t pos = (size_t)from;
+    while (pos > 0 && t[pos - 1] != '\n') pos--;
+    size_t line_start, line_end;
+    while (pos <= len && regex_find_line(q->cache, t, len, pos, &line_start, &line_end)) {
+        size_t at = (line_start < (size_t)from) ? (size_t)from : line_start;
+        if (regex_match(q->cache, t, line_start, line_end, at, out->groups, SEARCH_REPL_GROUPS)) {
+            out->block = out->end_block = b;
+            out->start = out->groups[0];
+            out->end = out->groups[1];
+            return true;
+        }
+        pos = line_end + 1;
+    }
+    return false;
+}
+
+bool search_in_block(const SearchQuery *q, Block *b, int from, SearchMatch *out) {
+    if (q->len == 0) return false;
+    if (q->regex != NULL) return regex_in_block(q, b, from, out);
+    const char *t = text_of(b);
+    int len = block_len(b);
+
+    if (from < len) {
+        const char *hit = search_find(q, &t[from], (size_t)(len - from));
+        if (hit != NULL) {
+            out->block = out->end_block = b;
+            out->start = (int)(hit - t);
+            out->end = out->start + q->len;
+            return true;
+        }
+    }
+    if (!q->cross_blocks || b->next == NULL) return false;
+
+    // only starts in the last len - 1 bytes (or at the boundary) can cross
+    int p = len - q->len + 1;
+    if (p < from) p = from;
+    for (; p <= len; p++) {
+        if (p < len && t[p] != q->needle[0]) continue;
+        if (match_from(q, b, p, &out->end_block, &out->end)) {
+            out->block = b;
+            out->start = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool search_next(Document *doc, const SearchQuery *q, Block *b, int from, SearchMatch *out) {
+    PROFILE_SCOPE("search_next");
+    if (search_in_block(q, b, from, out)) return true;
+    for (Block *cur = b->next; cur != NULL; cur = cur->next) {
+        if (search_in_block(q, cur, 0, out)) return true;
+    }
+    for (Block *cur = doc->start; cur != NULL; cur = cur->next) {
+        if (search_in_block(q, cur, 0, out)) return true;
+        if (cur == b) break;
+    }
+    return false;
+}
+
+// groups of the regex match at m->start, false if there is none
+static bool regex_groups_at(const SearchQuery *q, const SearchMatch *m, int *groups) {
+    const char *t = text_of(m->block);
+    size_t len = (size_t)block_len(m->block);
+    size_t line_start = (size_t)m->start;
+    while (line_start > 0 && t[line_start - 1] != '\n') line_start--;
+    const char *nl = (const char*)memchr(&t[m->start], '\n', len - m->start);
+    size_t line_end = nl ? (size_t)(nl - t) : len;
+    return regex_match(q->cache, t, line_start, line_end, (size_t)m->start, groups, SEARCH_REPL_GROUPS)
+        && groups[0] == m->start;
+}
+
+bool search_verify(const SearchQuery *q, const SearchMatch *m) {
+    if (q->len == 0 || m->start > block_len(m->block)) return false;
+    if (q->regex != NULL) {
+        int groups[2 * SEARCH_REPL_GROUPS];
+        return m->end_block == m->block && regex_groups_at(q, m, groups) && groups[1] == m->end;
+    }
+    Block *end_block;
+    int end;
+    return match_from(q, m->block, m->start, &end_block, &end)
+        && end_block == m->end_block && end == m->end;
+}
+
+// ----------------------------------------------------------------------------
+// replace
+// ----------------------------------------------------------------------------
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Builder;
+
+static void put(Builder *out, const char *s, size_t n) {
+    if (out->len + n + 1 > out->cap) {
+        size_t cap = out->cap ? out->cap * 2 : 256;
+        while (cap < out->len + n + 1) cap *= 2;
+        out->data = (char*)realloc(out->data, cap);
+        out->cap = cap;
+    }
+    memcpy(&out->data[out->len], s, n);
+    out->len += n;
+    out->data[out->len] = '\0';
+}
+
+// repl with $n / \n group references expanded (regex queries only)
+static void put_replacement(Builder *out, const SearchQuery *q, const char *t, const int *groups,
+                            const char *repl, int repl_len) {
+    if (q->regex == NULL) {
+        put(out, repl, repl_len);
+        return;
+    }
+    int ngroups = regex_group_count(q->regex);
+    int i = 0;
+    while (i < repl_len) {
+        char c = repl[i];
+        if ((c == '$' || c == '\\') && i + 1 < repl_len) {
+            char d = repl[i + 1];
+            if (d >= '0' && d <= '9') {
+                int g = d - '0';
+                if (g < ngroups && groups[2 * g] >= 0) put(out, &t[groups[2 * g]], groups[2 * g + 1] - groups[2 * g]);
+                i += 2;
+                continue;
+            }
+            if (d == c) {
+                put(out, &c, 1);
+                i += 2;
+                continue;
+            }
+        }
+        put(out, &c, 1);
+        i++;
+    }
+}
+
+Block* search_replace(Document *doc, const SearchQuery *q, const SearchMatch *m, const char *repl, int repl_len) {
+    Block *b = m->block;
+    Block *e = m->end_block;
+    block_touch(b);
+
+    // captures are taken from the text as it is now
+    int groups[2 * SEARCH_REPL_GROUPS];
+    if (q->regex != NULL && !regex_groups_at(q, m, groups)) {
+        for (int k = 0; k < 2 * SEARCH_REPL_GROUPS; k++) groups[k] = -1;
+    }
+
+    const char *tail = &text_of(e)[m->end];
+    Builder out = { 0 };
+    put(&out, b->text, m->start);
+    put_replacement(&out, q, b->text, groups, repl, repl_len);
+    int repl_end = (int)out.len;
+    put(&out, tail, strlen(tail));
+
+    markers_join(doc, b, m->start, e, m->end, repl_end - m->start);
+    if (e != b) remove_blocks_after(doc, b, e);
+    free(b->text);
+    b->text = out.data;
+    b->text_cap = (int)out.cap;
+    block_touch(b);   // the cached length described the old text
+    b->cursor_index = repl_end;
+    return b;
+}
+
+int search_replace_all(Document *doc, const SearchQuery *q, const char *repl, int repl_len, Block **focus) {
+    PROFILE_SCOPE("search_replace_all");
+    Block *focus_block = focus ? *focus : NULL;
+    int focus_cursor = focus_block ? focus_block->cursor_index : -1;
+    int count = 0;
+
+    Block *b = doc->start;
+    while (b != NULL) {
+        SearchMatch m;
+        if (!search_in_block(q, b, 0, &m)) { b = b->next; continue; }
+
+        block_touch(b);
+        Builder out = { 0 };
+        Block *src = b;  // block being copied (b, or one merged into it)
+        int pos = 0;
+        int new_cursor = -1;
+
+        do {
+            const char *t = text_of(src);
+            if (src == focus_block && focus_cursor >= pos && focus_cursor <= m.start) {
+                new_cursor = (int)out.len + focus_cursor - pos;
+            }
+            put(&out, &t[pos], m.start - pos);
+            int repl_at = (int)out.len;
+            put_replacement(&out, q, t, m.groups, repl, repl_len);
+            count++;
+
+            // markers follow as if the matches were replaced one by one:
+            // b's list is always in terms of out + the rest of src
+            Block *last = (m.end_block != src) ? m.end_block : b;
+            int last_at = (last == b) ? repl_at + m.end - m.start : m.end;
+            markers_join(doc, b, repl_at, last, last_at, (int)out.len - repl_at);
+
+            // a cursor inside the match ends up after the replacement
+            bool inside = (src == focus_block && focus_cursor > m.start && (m.end_block != src || focus_cursor < m.end))
+                       || (m.end_block == focus_block && m.end_block != src && focus_cursor < m.end);
+            if (inside) new_cursor = (int)out.len;
+
+            if (m.end_block != src) {
+                // blocks the match runs through are absorbed into b,
+                // copying continues in the end block. a cursor in one of
+                // them is inside the match
+                while (b->next != m.end_block) {
+                    if (b->next == focus_block) new_cursor = (int)out.len;
+                    remove_blocks_after(doc, b, b->next);
+                }
+                src = m.end_block;
+            }
+            pos = m.end;
+        } while (search_in_block(q, src, pos, &m));
+
+        const char *t = text_of(src);
+        int len = block_len(src);
+        if (src == focus_block && focus_cursor >= pos) new_cursor = (int)out.len + focus_cursor - pos;
+        put(&out, &t[pos], len - pos);
+        if (src != b) remove_blocks_after(doc, b, src);
+
+        free(b->text);
+        b->text = out.data;
+        b->text_cap = (int)out.cap;
+        block_touch(b);
+        if (new_cursor >= 0) {
+            b->cursor_index = new_cursor;
+            if (focus != NULL) *focus = b;
+            focus_block = NULL;
+        } else if (b->cursor_index > (int)out.len) {
+            b->cursor_index = (int)out.len;
+        }
+        b = b->next;
+    }
+    return count;
+}
@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <string.h>
+#include "include/search_job.h"
+#include "include/search.h"
+#include "include/profile.h"
+#define ALLOC_SUBSYSTEM ALLOC_SEARCH
+#include "include/alloc_stats.h"
+
+typedef struct {
+    int first, last;     // snapshot block range
+    SearchHit *hits;
+    int count, cap;
+    int done;            // set by the worker (release), read by poll (acquire)
+} Chunk;
+
+struct SearchJob {
+    ThreadPool *pool;
+    TaskGroup group;
+    SearchSnapshot snap;
+    SearchQuery query;
+    unsigned char *skip; // per snapshot block: ruled out by the trigram index
+    int cancel;
+
+    Chunk *chunks;
+    int chunk_count;
+
+    // published, main thread only
+    int published;
+    SearchHit *hits;
+    int hit_count, hit_cap;
+};
+
+typedef struct {
+    SearchJob *job;
+    int lo, hi;          // chunk range
+} RangeTask;
+
+// ----------------------------------------------------------------------------
+// snapshot
+// ----------------------------------------------------------------------------
+
+void search_snapshot(Document *doc, SearchSnapshot *snap) {
+    int count = 0;
+    for (Block *b = doc->start; b; b = b->next) count++;
+
+    snap->count = count;
+    snap->blocks = (Block*)calloc(count ? count : 1, sizeof(Block));
+    snap->meta = &doc->meta;
+    snap->gen = block_meta_pin(&doc->meta);
+
+    // every copy reads like a lazy block: src + src_len, text == NULL.
+    // loaded texts are borrowed, block_touch copies them before a write
+    int i = 0;
+    for (Block *b = doc->start; b; b = b->next, i++) {
+        Block *s = &snap->blocks[i];
+        s->id = b->id;
+        s->version = b->version;
+        s->file_offset = -1;
+        s->src = (b->text != NULL) ? b->text : b->src;
+        s->src_len = block_len(b);
+        s->next = (i + 1 < count) ? &snap->blocks[i + 1] : NULL;
+    }
+}
+
+void search_snapshot_free(SearchSnapshot *snap) {
+    if (snap->meta != NULL) block_meta_unpin(snap->meta, snap->gen);
+    free(snap->blocks);
+    snap->blocks = NULL;
+    snap->meta = NULL;
+    snap->count = 0;
+}
+
+// ----------------------------------------------------------------------------
+// workers
+// ----------------------------------------------------------------------------
+
+static void add_hit(SearchJob *job, Chunk *c, const SearchMatch *m) {
+    if (c->count == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 64;
+        c->hits = (SearchHit*)realloc(c->hits, c->cap * sizeof(SearchHit));
+    }
+    SearchHit *h = &c->hits[c->count++];
+    h->block_index = (int)(m->block - job->snap.blocks);
+    h->end_block_index = (int)(m->end_block - job->snap.blocks);
+    h->block_id = m->block->id;
+    h->end_block_id = m->end_block->id;
+    h->start = m->start;
+    h->end = m->end;
+}
+
+static void run_chunk(SearchJob *job, Chunk *c) {
+    PROFILE_SCOPE("search_chunk");
+    // the regex program is shared, dfa states are per worker
+    SearchQuery q = job->query;
+    if (q.regex != NULL) q.cache = regex_cache_create(q.regex, REGEX_CACHE_BYTES);
+
+    int i = c->first;
+    int from = 0;
+    while (i < c->last && !__atomic_load_n(&job->cancel, __ATOMIC_RELAXED)) {
+        if (job->skip != NULL && job->skip[i]) { i++; from = 0; continue; }
+        SearchMatch m;
+        Block *b = &job->snap.blocks[i];
+        if (!search_in_block(&q, b, from, &m)) { i++; from = 0; continue; }
+
+        add_hit(job, c, &m);
+        // continue after the match, like a sequential scan would
+        i = (int)(m.end_block - job->snap.blocks);
+        from = m.end;
+    }
+    if (q.regex != NULL) regex_cache_free(q.cache);
+    __atomic_store_n(&c->done, 1, __ATOMIC_RELEASE);
+}
+
+static void run_range(void *arg) {
+    RangeTask *r = (RangeTask*)arg;
+    SearchJob *job = r->job;
+    int lo = r->lo, hi = r->hi;
+    free(r);
+
+    // hand the upper halves to thieves, keep the first chunk
+    while (hi - lo > 1) {
+        int mid = lo + (hi - lo) / 2;
+        RangeTask *upper = (RangeTask*)malloc(sizeof(RangeTask));
+        *upper = (RangeTask){ job, mid, hi };
+        pool_submit(job->pool, &job->group, run_range, upper);
+        hi = mid;
+    }
+    if (lo < hi) run_chunk(job, &job->chunks[lo]);
+}
+
+// ----------------------------------------------------------------------------
+// api
+// ----------------------------------------------------------------------------
+
+SearchJob* search_job_start(ThreadPool *pool, Document *doc, const char *needle, int len, int flags,
+                            TrigramIndex *index) {
+    SearchJob *job = (SearchJob*)calloc(1, sizeof(SearchJob));
+    job->pool = pool;
+    search_query_init(&job->query, needle, len, flags);
+    search_snapshot(doc, &job->snap);
+    if (job->query.len == 0) return job;
+
+    if (index != NULL) {
+        // edited blocks are candidates this time and re-indexed on the way
+        TrigramFilter *filter = trigram_filter(index, &job->query);
+        if (filter != NULL) job->skip = (unsigned char*)malloc(job->snap.count ? job->snap.count : 1);
+        int i = 0;
+        for (Block *b = doc->start; b; b = b->next, i++) {
+            if (filter != NULL) job->skip[i] = !trigram_filter_has(filter, b);
+            if (!trigram_index_current(index, b)) trigram_index_add(index, b);
+        }
+        trigram_filter_free(filter);
+    }
+
+    // chunks of whole blocks, about SEARCH_CHUNK_BYTES each
+    int cap = 16;
+    job->chunks = (Chunk*)calloc(cap, sizeof(Chunk));
+    int first = 0;
+    size_t bytes = 0;
+    for (int i = 0; i < job->snap.count; i++) {
+        if (job->skip == NULL || !job->skip[i]) bytes += job->snap.blocks[i].src_len;
+        if (bytes >= SEARCH_CHUNK_BYTES || i + 1 == job->snap.count) {
+            if (job->chunk_count == cap) {
+                cap *= 2;
+                job->chunks = (Chunk*)realloc(job->chunks, cap * sizeof(Chunk));
+            }
+            job->chunks[job->chunk_count++] = (Chunk){ first, i + 1, NULL, 0, 0, 0 };
+            first = i + 1;
+            bytes = 0;
+        }
+    }
+
+    if (job->chunk_count > 0) {
+        RangeTask *all = (RangeTask*)malloc(sizeof(RangeTask));
+        *all = (RangeTask){ job, 0, job->chunk_count };
+        pool_submit(pool, &job->group, run_range, all);
+    }
+    return job;
+}
+
+int search_job_poll(SearchJob *job, bool *done) {
+    while (job->published < job->chunk_count
+           && __atomic_load_n(&job->chunks[job->published].done, __ATOMIC_ACQUIRE)) {
+        Chunk *c = &job->chunks[job->published];
+        for (int k = 0; k < c->count; k++) {
+            // a match crossing into this chunk swallows overlapping hits
+            if (job->hit_count > 0) {
+                const SearchHit *last = &job->hits[job->hit_count - 1];
+                const SearchHit *h = &c->hits[k];
+                if (h->block_index < last->end_block_index
+                    || (h->block_index == last->end_block_index && h->start < last->end)) continue;
+            }
+            if (job->hit_count == job->hit_cap) {
+                job->hit_cap = job->hit_cap ? job->hit_cap * 2 : 256;
+                job->hits = (SearchHit*)realloc(job->hits, job->hit_cap * sizeof(SearchHit));
+            }
+            job->hits[job->hit_count++] = c->hits[k];
+        }
+        free(c->hits);
+        c->hits = NULL;
+        job->published++;
+    }
+    if (done) *done = (job->published == job->chunk_count);
+    return job->hit_count;
+}
+
+const SearchHit* search_job_hits(const SearchJob *job) {
+    return job->hits;
+}
+
+void search_job_free(SearchJob *job) {
+    if (job == NULL) return;
+    __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+    pool_wait(job->pool, &job->group);
+
+    for (int i = 0; i < job->chunk_count; i++) free(job->chunks[i].hits);
+    free(job->chunks);
+    free(job->skip);
+    free(job->hits);
+    search_query_free(&job->query);
+    search_snapshot_free(&job->snap);
+    free(job);
+}
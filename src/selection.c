@@ -0,0 +1,173 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/selection.h"
+#include "include/marker.h"
+#include "include/profile.h"
+#define ALLOC_SUBSYSTEM ALLOC_EDIT
+#include "include/alloc_stats.h"
+
+// only handles in [sel_lo, sel_hi) can hold a range, so clearing costs
+// the size of the last selection rather than of the document
+static void clear_ranges(BlockMeta *m) {
+    for (int h = m->sel_lo; h < m->sel_hi; h++) {
+        m->sel_start[h] = -1;
+        m->sel_len[h] = 0;
+    }
+    m->sel_lo = 0;
+    m->sel_hi = 0;
+}
+
+static void set_range(BlockMeta *m, const Block *b, int start, int len) {
+    int h = b->handle;
+    m->sel_start[h] = start;
+    m->sel_len[h] = len;
+    if (m->sel_lo == m->sel_hi) {
+        m->sel_lo = h;
+        m->sel_hi = h + 1;
+    } else {
+        if (h < m->sel_lo) m->sel_lo = h;
+        if (h >= m->sel_hi) m->sel_hi = h + 1;
+    }
+}
+
+void selection_begin(Selection *sel, Block *b, int index) {
+    sel->anchor = b;
+    sel->anchor_index = index;
+}
+
+void selection_clear(Selection *sel, Document *doc) {
+    sel->anchor = NULL;
+    clear_ranges(&doc->meta);
+}
+
+void update_selection_range(Document *doc, const Selection *sel, Block *current_hover, int current_index) {
+    PROFILE_SCOPE("update_selection_range");
+    if (sel->anchor == NULL || current_hover == NULL) return;
+
+    // reset all
+    BlockMeta *m = &doc->meta;
+    clear_ranges(m);
+
+    // define order (start -> end)
+    Block *start_b = sel->anchor;
+    int start_i = sel->anchor_index;
+    Block *end_b = current_hover;
+    int end_i = current_index;
+
+    // check inversion (backwards drag)
+    if (start_b != end_b) {
+        Block *check = doc->start;
+        bool found_end_first = false;
+        while (check != NULL) {
+            if (check == end_b) { found_end_first = true; break; }
+            if (check == start_b) break;
+            check = check->next;
+        }
+        if (found_end_first) {
+            start_b = current_hover; start_i = current_index;
+            end_b = sel->anchor;     end_i = sel->anchor_index;
+        }
+    } else {
+        if (start_i > end_i) { int t = start_i; start_i = end_i; end_i = t; }
+    }
+
+    // apply range
+    Block *curr = start_b;
+    bool finished = false;
+    
+    while (curr != NULL && !finished) {
+        int len = block_len(curr);
+        
+        if (curr == end_b) finished = true;
+
+        if (curr == start_b && curr == end_b) {
+            set_range(m, curr, start_i, end_i - start_i);
+        } 
+        else if (curr == start_b) {
+            set_range(m, curr, start_i, len - start_i);
+        } 
+        else if (curr == end_b) {
+            set_range(m, curr, 0, end_i);
+        } 
+        else {
+            set_range(m, curr, 0, len);
+        }
+        curr = curr->next;
+    }
+}
+
+// deletes selected range. returns surviving block to update focus.
+Block* delete_selected_text(Document *doc) {
+    PROFILE_SCOPE("delete_selected_text");
+    BlockMeta *m = &doc->meta;
+    Block *first = NULL;
+    Block *last = NULL;
+    bool has_selection = false;
+
+    // find selection bounds from the selected handles alone. the range is
+    // a run of the list: xor-ing every selected block with every selected
+    // successor leaves the one no selected block points to (the first),
+    // and the last is the one whose successor is not selected.
+    uintptr_t head = 0;
+    for (int h = m->sel_lo; h < m->sel_hi; h++) {
+        if (m->sel_start[h] == -1) continue;
+        Block *b = m->block[h];
+        Block *next = b->next;
+        bool next_selected = next != NULL && m->sel_start[next->handle] != -1;
+        head ^= (uintptr_t)b;
+        if (next_selected) head ^= (uintptr_t)next;
+        else last = b;
+        if (m->sel_len[h] > 0) has_selection = true;
+    }
+    first = (Block*)head;
+
+    // ignore 0-length selection (cursor only)
+    if (first != NULL && first == last && m->sel_len[first->handle] == 0) return NULL;
+    if (first != last && first != NULL) has_selection = true;
+    if (!has_selection) return NULL;
+
+    int sel_start = m->sel_start[first->handle];
+
+    // scenario: single block (simple memmove)
+    if (first == last) {
+        block_erase(first, sel_start, m->sel_len[first->handle]);
+        first->cursor_index = sel_start;
+        clear_ranges(m);
+        return first; 
+    }
+
+    // scenario: multi-block (complex merge)
+    
+    // 1. tail of the last block goes right after the kept head of the
+    //    first, copied straight across (no temporary)
+    block_touch(first);
+    block_load(last);
+    int last_len = strlen(last->text);
+    int tail_start = m->sel_len[last->handle];
+    if (tail_start > last_len) tail_start = last_len;
+    int tail_len = last_len - tail_start;
+    block_reserve(first, sel_start + tail_len + 1);
+    memcpy(&first->text[sel_start], &last->text[tail_start], tail_len + 1);
+
+    // 2. delete intermediate nodes manually (the last one included).
+    //    markers in the deleted text land where it started, those of the
+    //    tail follow it
+    markers_join(doc, first, sel_start, last, tail_start, 0);
+    Block *block_after_selection = last->next;
+    Block *curr = first->next;
+    
+    while (curr != NULL && curr != block_after_selection) {
+        Block *next_node = curr->next;
+        free_block(curr);
+        curr = next_node;
+    }
+
+    // 3. reconnect list
+    first->next = block_after_selection;
+    if (block_after_selection == NULL) doc->end = first;
+
+    first->cursor_index = sel_start;
+    clear_ranges(m);
+    return first;
+}
@@ -0,0 +1,233 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/textscan.h"
+#include "include/simd.h"
+#define ALLOC_SUBSYSTEM ALLOC_FILE
+#include "include/alloc_stats.h"
+
+typedef struct {
+    size_t w;            // write position in the normalized buffer
+    size_t nl_total;     // '\n' written so far
+    size_t block_start;
+    size_t block_nl;     // nl_total when the current block started
+    size_t last_sep;     // second '\n' of the last separator (SIZE_MAX = none)
+} ScanState;
+
+static void push_span(TextSpans *out, size_t start, size_t len, size_t lines) {
+    if (out->count == out->cap) {
+        out->cap = out->cap ? out->cap * 2 : 64;
+        out->spans = (TextSpan*)realloc(out->spans, out->cap * sizeof(TextSpan));
+    }
+    out->spans[out->count++] = (TextSpan){ start, len, (int)lines };
+}
+
+// '\n' already written at output o, with nl_before newlines ahead of it.
+// a separator needs the previous output byte to be a '\n' that is not
+// itself the end of a separator ("\n\n\n" = one break + a leading '\n').
+static inline void on_newline(const char *data, ScanState *s, TextSpans *out, size_t o, size_t nl_before) {
+    if (o == 0 || data[o - 1] != '\n' || o - 1 == s->last_sep) return;
+
+    push_span(out, s->block_start, o - 1 - s->block_start, nl_before - s->block_nl);
+    s->block_start = o + 1;
+    s->block_nl = nl_before + 1;
+    s->last_sep = o;
+}
+
+static void scan_scalar(char *data, size_t r, size_t len, ScanState *s, TextSpans *out) {
+    for (; r < len; r++) {
+        char c = data[r];
+        if (c == '\r' && r + 1 < len && data[r + 1] == '\n') continue;
+
+        data[s->w] = c;
+        if (c == '\n') {
+            on_newline(data, s, out, s->w, s->nl_total);
+            s->nl_total++;
+        }
+        s->w++;
+    }
+}
+
+#ifdef SIMD_X86
+
+// only a '\n' with another one 1-2 bytes back can close a blank line.
+// rare, so each candidate is verified on the output.
+static inline uint64_t separator_candidates(uint64_t nl, uint64_t prev_nl) {
+    return nl & ((nl << 1) | (nl << 2) | (prev_nl >> 63) | (prev_nl >> 62));
+}
+
+// slow path for a 64 byte chunk at r that holds a '\r' or a separator
+// candidate. the chunk is not written yet when it holds a '\r'.
+static void scan_chunk(char *data, size_t r, size_t len, uint64_t nl, uint64_t cr, uint64_t cand,
+                       ScanState *s, TextSpans *out) {
+    size_t w0 = s->w;
+    uint64_t removed = 0;
+
+    if (cr == 0) {
+        s->w += 64;
+    } else {
+        // '\r' directly before '\n' is dropped (lookahead for the last byte)
+        removed = cr & (nl >> 1);
+        if ((cr >> 63) && r + 64 < len && data[r + 64] == '\n') removed |= 1ull << 63;
+
+        // compact through scratch with fixed 64 byte copies. the final
+        // store stays inside the consumed chunk since w never passes r.
+        char in[128], packed[128];
+        memcpy(in, data + r, 64);
+        memset(in + 64, 0, 64);
+        uint64_t m = removed;
+        size_t seg = 0, kept = 0;
+        while (m) {
+            size_t bit = (size_t)__builtin_ctzll(m);
+            memcpy(packed + kept, in + seg, 64);
+            kept += bit - seg;
+            seg = bit + 1;
+            m &= m - 1;
+        }
+        memcpy(packed + kept, in + seg, 64);
+        kept += 64 - seg;
+        memcpy(data + s->w, packed, 64);
+        s->w += kept;
+    }
+
+    while (cand) {
+        int i = __builtin_ctzll(cand);
+        uint64_t below = (1ull << i) - 1;
+        size_t o = w0 + i - (size_t)__builtin_popcountll(removed & below);
+        on_newline(data, s, out, o, s->nl_total + (size_t)__builtin_popcountll(nl & below));
+        cand &= cand - 1;
+    }
+    s->nl_total += (size_t)__builtin_popcountll(nl);
+}
+
+// both kernels keep w / nl_total in locals: every store into data may
+// alias the state, so going through s would reload it each chunk.
+
+static size_t scan_sse2(char *data, size_t len, ScanState *s, TextSpans *out) {
+    const __m128i vnl = _mm_set1_epi8('\n');
+    const __m128i vcr = _mm_set1_epi8('\r');
+    uint64_t prev_nl = 0;
+    size_t w = s->w, nl_total = s->nl_total;
+    size_t r = 0;
+
+    for (; r + 64 <= len; r += 64) {
+        __m128i v[4];
+        uint64_t nl = 0, cr = 0;
+        for (int k = 0; k < 4; k++) {
+            v[k] = _mm_loadu_si128((const __m128i*)(data + r + 16 * k));
+            nl |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[k], vnl)) << (16 * k);
+            cr |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[k], vcr)) << (16 * k);
+        }
+        uint64_t cand = separator_candidates(nl, prev_nl);
+        prev_nl = nl;
+
+        if (cr == 0) {
+            if (w != r) {
+                for (int k = 0; k < 4; k++) _mm_storeu_si128((__m128i*)(data + w + 16 * k), v[k]);
+            }
+            if (cand == 0) {
+                w += 64;
+                nl_total += (size_t)__builtin_popcountll(nl);
+                continue;
+            }
+        }
+        s->w = w;
+        s->nl_total = nl_total;
+        scan_chunk(data, r, len, nl, cr, cand, s, out);
+        w = s->w;
+        nl_total = s->nl_total;
+    }
+    s->w = w;
+    s->nl_total = nl_total;
+    return r;
+}
+
+SIMD_TARGET_AVX2
+static size_t scan_avx2(char *data, size_t len, ScanState *s, TextSpans *out) {
+    const __m256i vnl = _mm256_set1_epi8('\n');
+    const __m256i vcr = _mm256_set1_epi8('\r');
+    uint64_t prev_nl = 0;
+    size_t w = s->w, nl_total = s->nl_total;
+    size_t r = 0;
+
+    for (; r + 64 <= len; r += 64) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)(data + r));
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(data + r + 32));
+        uint64_t nl = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, vnl))
+                    | (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, vnl)) << 32;
+        uint64_t cr = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, vcr))
+                    | (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, vcr)) << 32;
+        uint64_t cand = separator_candidates(nl, prev_nl);
+        prev_nl = nl;
+
+        if (cr == 0) {
+            if (w != r) {
+                _mm256_storeu_si256((__m256i*)(data + w), lo);
+                _mm256_storeu_si256((__m256i*)(data + w + 32), hi);
+            }
+            if (cand == 0) {
+                w += 64;
+                nl_total += (size_t)__builtin_popcountll(nl);
+                continue;
+            }
+        }
+        s->w = w;
+        s->nl_total = nl_total;
+        scan_chunk(data, r, len, nl, cr, cand, s, out);
+        w = s->w;
+        nl_total = s->nl_total;
+    }
+    s->w = w;
+    s->nl_total = nl_total;
+    return r;
+}
+
+#endif
+
+static ScanKernel best_kernel(void) {
+    static ScanKernel best = SCAN_AUTO;
+    if (best == SCAN_AUTO) {
+#ifdef SIMD_X86
+        best = simd_has_avx2() ? SCAN_AVX2 : SCAN_SSE2;
+#else
+        best = SCAN_SCALAR;
+#endif
+    }
+    return best;
+}
+
+void text_split_with(ScanKernel kernel, char *data, size_t len, TextSpans *out) {
+    ScanState s = { 0, 0, 0, 0, SIZE_MAX };
+    out->count = 0;
+
+    if (kernel == SCAN_AUTO) kernel = best_kernel();
+
+    size_t r = 0;
+#ifdef SIMD_X86
+    if (kernel == SCAN_AVX2 && best_kernel() == SCAN_AVX2) r = scan_avx2(data, len, &s, out);
+    else if (kernel != SCAN_SCALAR) r = scan_sse2(data, len, &s, out);
+#endif
+    scan_scalar(data, r, len, &s, out);
+
+    push_span(out, s.block_start, s.w - s.block_start, s.nl_total - s.block_nl + 1);
+    out->len = s.w;
+}
+
+void text_split(char *data, size_t len, TextSpans *out) {
+    text_split_with(SCAN_AUTO, data, len, out);
+}
+
+void text_split_free(TextSpans *out) {
+    free(out->spans);
+    out->spans = NULL;
+    out->count = 0;
+    out->cap = 0;
+}
+
+const char* text_split_kernel_name(void) {
+    switch (best_kernel()) {
+        case SCAN_AVX2: return "avx2";
+        case SCAN_SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
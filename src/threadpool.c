@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include "include/threadpool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Cond;
+typedef HANDLE Thread;
+#define mutex_init(m)      InitializeCriticalSection(m)
+#define mutex_destroy(m)   DeleteCriticalSection(m)
+#define mutex_lock(m)      EnterCriticalSection(m)
+#define mutex_unlock(m)    LeaveCriticalSection(m)
+#define cond_init(c)       InitializeConditionVariable(c)
+#define cond_destroy(c)    ((void)(c))
+#define cond_wait(c, m)    SleepConditionVariableCS(c, m, INFINITE)
+#define cond_signal(c)     WakeConditionVariable(c)
+#define cond_broadcast(c)  WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Cond;
+typedef pthread_t Thread;
+#define mutex_init(m)      pthread_mutex_init(m, NULL)
+#define mutex_destroy(m)   pthread_mutex_destroy(m)
+#define mutex_lock(m)      pthread_mutex_lock(m)
+#define mutex_unlock(m)    pthread_mutex_unlock(m)
+#define cond_init(c)       pthread_cond_init(c, NULL)
+#define cond_destroy(c)    pthread_cond_destroy(c)
+#define cond_wait(c, m)    pthread_cond_wait(c, m)
+#define cond_signal(c)     pthread_cond_signal(c)
+#define cond_broadcast(c)  pthread_cond_broadcast(c)
+#endif
+
+#define ALLOC_SUBSYSTEM ALLOC_OTHER
+#include "include/alloc_stats.h"
+
+typedef struct {
+    TaskFn fn;
+    void *arg;
+    TaskGroup *group;
+} Task;
+
+// ring buffer, owner end = back, thief end = front
+typedef struct {
+    Mutex lock;
+    Task *items;
+    int front;
+    int count;
+    int cap;
+} Deque;
+
+typedef struct {
+    ThreadPool *pool;
+    int index;
+    Thread thread;
+} Worker;
+
+struct ThreadPool {
+    int count;
+    Worker *workers;
+    Deque *deques;
+
+    Mutex lock;        // guards everything below and TaskGroup.pending
+    Cond wake;         // queued > 0 or stopping
+    Cond done;         // some group reached pending == 0
+    int queued;        // tasks sitting in deques
+    int sleeping;
+    bool stop;
+    unsigned next;     // round-robin target for outside submits
+};
+
+static _Thread_local Worker *current_worker = NULL;
+
+// ----------------------------------------------------------------------------
+// deques
+// ----------------------------------------------------------------------------
+
+static void deque_push_back(Deque *d, Task t) {
+    mutex_lock(&d->lock);
+    if (d->count == d->cap) {
+        int cap = d->cap ? d->cap * 2 : 64;
+        Task *items = (Task*)malloc(cap * sizeof(Task));
+        for (int i = 0; i < d->count; i++) items[i] = d->items[(d->front + i) % d->cap];
+        free(d->items);
+        d->items = items;
+        d->front = 0;
+        d->cap = cap;
+    }
+    d->items[(d->front + d->count) % d->cap] = t;
+    d->count++;
+    mutex_unlock(&d->lock);
+}
+
+static bool deque_pop_back(Deque *d, Task *out) {
+    mutex_lock(&d->lock);
+    bool ok = d->count > 0;
+    if (ok) {
+        d->count--;
+        *out = d->items[(d->front + d->count) % d->cap];
+    }
+    mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool deque_steal_front(Deque *d, Task *out) {
+    mutex_lock(&d->lock);
+    bool ok = d->count > 0;
+    if (ok) {
+        *out = d->items[d->front];
+        d->front = (d->front + 1) % d->cap;
+        d->count--;
+    }
+    mutex_unlock(&d->lock);
+    return ok;
+}
+
+// ----------------------------------------------------------------------------
+// workers
+// ----------------------------------------------------------------------------
+
+static bool find_task(Worker *w, Task *out) {
+    ThreadPool *pool = w->pool;
+    if (deque_pop_back(&pool->deques[w->index], out)) return true;
+    for (int k = 1; k < pool->count; k++) {
+        if (deque_steal_front(&pool->deques[(w->index + k) % pool->count], out)) return true;
+    }
+    return false;
+}
+
+static void run_worker(Worker *w) {
+    ThreadPool *pool = w->pool;
+    current_worker = w;
+
+    for (;;) {
+        Task t;
+        if (find_task(w, &t)) {
+            mutex_lock(&pool->lock);
+            pool->queued--;
+            mutex_unlock(&pool->lock);
+
+            t.fn(t.arg);
+
+            mutex_lock(&pool->lock);
+            if (--t.group->pending == 0) cond_broadcast(&pool->done);
+            mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->stop) {
+            pool->sleeping++;
+            cond_wait(&pool->wake, &pool->lock);
+            pool->sleeping--;
+        }
+        bool quit = pool->stop && pool->queued == 0;
+        mutex_unlock(&pool->lock);
+        if (quit) break;
+    }
+    current_worker = NULL;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg) { run_worker((Worker*)arg); return 0; }
+#else
+static void* thread_main(void *arg) { run_worker((Worker*)arg); return NULL; }
+#endif
+
+static int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// api
+// ----------------------------------------------------------------------------
+
+ThreadPool* pool_create(int threads) {
+    if (threads <= 0) threads = cpu_count();
+
+    ThreadPool *pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    pool->count = threads;
+    pool->workers = (Worker*)calloc(threads, sizeof(Worker));
+    pool->deques = (Deque*)calloc(threads, sizeof(Deque));
+    mutex_init(&pool->lock);
+    cond_init(&pool->wake);
+    cond_init(&pool->done);
+
+    for (int i = 0; i < threads; i++) mutex_init(&pool->deques[i].lock);
+    for (int i = 0; i < threads; i++) {
+        Worker *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+#ifdef _WIN32
+        w->thread = CreateThread(NULL, 0, thread_main, w, 0, NULL);
+#else
+        pthread_create(&w->thread, NULL, thread_main, w);
+#endif
+    }
+    return pool;
+}
+
+void pool_destroy(ThreadPool *pool) {
+    if (pool == NULL) return;
+    mutex_lock(&pool->lock);
+    pool->stop = true;
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->count; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->workers[i].thread, INFINITE);
+        CloseHandle(pool->workers[i].thread);
+#else
+        pthread_join(pool->workers[i].thread, NULL);
+#endif
+    }
+    for (int i = 0; i < pool->count; i++) {
+        mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].items);
+    }
+    cond_destroy(&pool->wake);
+    cond_destroy(&pool->done);
+    mutex_destroy(&pool->lock);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+int pool_size(const ThreadPool *pool) {
+    return pool->count;
+}
+
+void pool_submit(ThreadPool *pool, TaskGroup *group, TaskFn fn, void *arg) {
+    mutex_lock(&pool->lock);
+    group->pending++;
+    pool->queued++;
+    int target = (current_worker != NULL && current_worker->pool == pool)
+               ? current_worker->index
+               : (int)(pool->next++ % (unsigned)pool->count);
+    bool wake = pool->sleeping > 0;
+    mutex_unlock(&pool->lock);
+
+    deque_push_back(&pool->deques[target], (Task){ fn, arg, group });
+    if (wake) {
+        mutex_lock(&pool->lock);
+        cond_signal(&pool->wake);
+        mutex_unlock(&pool->lock);
+    }
+}
+
+void pool_wait(ThreadPool *pool, TaskGroup *group) {
+    mutex_lock(&pool->lock);
+    while (group->pending > 0) cond_wait(&pool->done, &pool->lock);
+    mutex_unlock(&pool->lock);
+}
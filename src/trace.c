@@ -0,0 +1,353 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/trace.h"
+#define ALLOC_SUBSYSTEM ALLOC_FILE
+#include "include/alloc_stats.h"
+
+static const char MAGIC[8] = { 'T', 'E', 'D', 'T', 'R', 'A', 'C', 'E' };
+
+typedef struct {
+    float max_width;
+    float spacing;
+    int32_t line_height, pad, gap, top, left;
+    float ascii[128];
+    int32_t tab_width;   // version 3
+} TraceLayout;
+
+// header bytes of the layout in a trace of the given version
+static size_t layout_size(uint32_t version) {
+    return (version < 3) ? offsetof(TraceLayout, tab_width) : sizeof(TraceLayout);
+}
+
+unsigned long long trace_doc_hash(const Document *doc) {
+    unsigned long long h = 1469598103934665603ULL;
+    for (const Block *b = doc->start; b; b = b->next) {
+        const char *t = b->text ? b->text : b->src;
+        int len = block_len(b);
+        for (int i = 0; i < len; i++) h = (h ^ (unsigned char)t[i]) * 1099511628211ULL;
+        h = (h ^ 0xFF) * 1099511628211ULL;  // block boundary
+    }
+    return h;
+}
+
+// codepoint -> advance, open addressing (0 = empty slot)
+typedef struct {
+    int *keys;
+    float *values;
+    int cap, count;
+} AdvanceMap;
+
+static float* map_slot(AdvanceMap *m, int cp, bool *found) {
+    if ((m->count + 1) * 2 > m->cap) {
+        AdvanceMap old = *m;
+        m->cap = old.cap ? old.cap * 2 : 256;
+        m->keys = (int*)calloc(m->cap, sizeof(int));
+        m->values = (float*)malloc(m->cap * sizeof(float));
+        m->count = 0;
+        for (int i = 0; i < old.cap; i++) {
+            if (old.keys[i] == 0) continue;
+            bool f;
+            *map_slot(m, old.keys[i], &f) = old.values[i];
+        }
+        free(old.keys);
+        free(old.values);
+    }
+    unsigned i = ((unsigned)cp * 2654435761u) & (m->cap - 1);
+    while (m->keys[i] != 0 && m->keys[i] != cp) i = (i + 1) & (m->cap - 1);
+    *found = (m->keys[i] == cp);
+    if (!*found) {
+        m->keys[i] = cp;
+        m->count++;
+    }
+    return &m->values[i];
+}
+
+// ----------------------------------------------------------------------------
+// recording
+// ----------------------------------------------------------------------------
+
+struct TraceWriter {
+    FILE *f;
+    AdvanceMap measured;
+};
+
+static void put(TraceWriter *w, const void *p, size_t n) {
+    fwrite(p, 1, n, w->f);
+}
+
+static void put_u8(TraceWriter *w, int v) {
+    fputc(v, w->f);
+}
+
+static void put_varint(TraceWriter *w, uint32_t v) {
+    while (v >= 0x80) {
+        fputc((int)(v | 0x80) & 0xFF, w->f);
+        v >>= 7;
+    }
+    fputc((int)v, w->f);
+}
+
+TraceWriter* trace_write_open(const char *path, const EditorState *ed) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return NULL;
+    TraceWriter *w = (TraceWriter*)calloc(1, sizeof(TraceWriter));
+    w->f = f;
+    setvbuf(f, NULL, _IOFBF, 1 << 16);
+
+    uint32_t version = TRACE_VERSION, blocks = 0;
+    uint64_t bytes = 0;
+    for (const Block *b = ed->doc->start; b; b = b->next) {
+        blocks++;
+        bytes += block_len(b);
+    }
+    const Layout *lo = &ed->layout;
+    TraceLayout tl = { lo->max_width, lo->spacing, lo->line_height, lo->pad, lo->gap, ed->top, ed->left, { 0 }, lo->tab_width };
+    memcpy(tl.ascii, lo->ascii, sizeof(tl.ascii));
+
+    put(w, MAGIC, sizeof(MAGIC));
+    put(w, &version, 4);
+    put(w, &blocks, 4);
+    put(w, &bytes, 8);
+    put(w, &tl, sizeof(tl));
+    return w;
+}
+
+void trace_frame(TraceWriter *w, double time, float scroll_y, int height) {
+    int32_t h = height;
+    put_u8(w, 'F');
+    put(w, &time, 8);
+    put(w, &scroll_y, 4);
+    put(w, &h, 4);
+}
+
+void trace_event(TraceWriter *w, const InputEvent *ev) {
+    switch (ev->type) {
+    case INPUT_CHAR:
+        put_u8(w, 'C');
+        put_u8(w, ev->mods);
+        put_varint(w, (uint32_t)ev->codepoint);
+        break;
+    case INPUT_KEY:
+        put_u8(w, 'K');
+        put_u8(w, ev->mods);
+        put_u8(w, ev->key);
+        break;
+    case INPUT_PASTE:
+        put_u8(w, 'P');
+        put_u8(w, ev->mods);
+        put_varint(w, (uint32_t)ev->text_len);
+        put(w, ev->text, ev->text_len);
+        break;
+    case INPUT_MOUSE_PRESS:
+    case INPUT_MOUSE_DRAG:
+        put_u8(w, ev->type == INPUT_MOUSE_PRESS ? 'M' : 'D');
+        put(w, &ev->x, 4);
+        put(w, &ev->y, 4);
+        break;
+    case INPUT_RESIZE:
+        put_u8(w, 'R');
+        put(w, &ev->x, 4);
+        put(w, &ev->y, 4);
+        break;
+    }
+}
+
+void trace_measure(TraceWriter *w, int codepoint, float advance) {
+    bool found;
+    float *slot = map_slot(&w->measured, codepoint, &found);
+    if (found) return;
+    *slot = advance;
+    put_u8(w, 'G');
+    put_varint(w, (uint32_t)codepoint);
+    put(w, &advance, 4);
+}
+
+void trace_write_close(TraceWriter *w, const Document *doc) {
+    if (w == NULL) return;
+    uint64_t hash = trace_doc_hash(doc);
+    uint32_t blocks = 0;
+    for (const Block *b = doc->start; b; b = b->next) blocks++;
+    put_u8(w, 'E');
+    put(w, &hash, 8);
+    put(w, &blocks, 4);
+    fclose(w->f);
+    free(w->measured.keys);
+    free(w->measured.values);
+    free(w);
+}
+
+// ----------------------------------------------------------------------------
+// replay
+// ----------------------------------------------------------------------------
+
+struct TraceReader {
+    unsigned char *data;
+    size_t size, pos;
+    uint32_t blocks;
+    uint64_t bytes;
+    TraceLayout layout;
+    AdvanceMap advances;
+    float fallback;      // for codepoints the recording never measured
+
+    bool ended;
+    uint64_t end_hash;
+    uint32_t end_blocks;
+};
+
+static bool get(TraceReader *r, void *p, size_t n) {
+    if (r->size - r->pos < n) return false;
+    memcpy(p, &r->data[r->pos], n);
+    r->pos += n;
+    return true;
+}
+
+static bool get_varint(TraceReader *r, uint32_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (r->pos >= r->size) return false;
+        unsigned char c = r->data[r->pos++];
+        *v |= (uint32_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+TraceReader* trace_read_open(const char *path, const char **error) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) { *error = "cannot open file"; return NULL; }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    TraceReader *r = (TraceReader*)calloc(1, sizeof(TraceReader));
+    r->data = (unsigned char*)malloc(size > 0 ? size : 1);
+    r->size = (size > 0 && fread(r->data, 1, size, f) == (size_t)size) ? (size_t)size : 0;
+    fclose(f);
+
+    char magic[8];
+    uint32_t version = 0;
+    if (!get(r, magic, 8) || memcmp(magic, MAGIC, 8) != 0 || !get(r, &version, 4)) {
+        *error = "not a trace";
+    } else if (version < 1 || version > TRACE_VERSION) {
+        *error = "unsupported trace version";
+    } else if (!get(r, &r->blocks, 4) || !get(r, &r->bytes, 8) || !get(r, &r->layout, layout_size(version))) {
+        *error = "truncated header";
+    } else {
+        if (version < 3) r->layout.tab_width = 4;
+        r->fallback = r->layout.ascii['?'];
+        return r;
+    }
+    trace_read_close(r);
+    return NULL;
+}
+
+void trace_read_doc_info(const TraceReader *r, unsigned *blocks, unsigned long long *bytes) {
+    *blocks = r->blocks;
+    *bytes = r->bytes;
+}
+
+static float measure_recorded(void *user, int codepoint) {
+    TraceReader *r = (TraceReader*)user;
+    if (r->advances.cap == 0) return r->fallback;
+    unsigned i = ((unsigned)codepoint * 2654435761u) & (r->advances.cap - 1);
+    while (r->advances.keys[i] != 0) {
+        if (r->advances.keys[i] == codepoint) return r->advances.values[i];
+        i = (i + 1) & (r->advances.cap - 1);
+    }
+    return r->fallback;
+}
+
+void trace_read_init(TraceReader *r, EditorState *ed, Document *doc) {
+    editor_init(ed, doc, measure_recorded, r);
+    Layout *lo = &ed->layout;
+    memcpy(lo->ascii, r->layout.ascii, sizeof(lo->ascii));
+    lo->max_width = r->layout.max_width;
+    lo->spacing = r->layout.spacing;
+    lo->line_height = r->layout.line_height;
+    lo->pad = r->layout.pad;
+    lo->gap = r->layout.gap;
+    lo->tab_width = r->layout.tab_width;
+    layout_changed(lo);
+    ed->top = r->layout.top;
+    ed->left = r->layout.left;
+}
+
+bool trace_read_frame(TraceReader *r, TraceFrame *frame, InputQueue *q) {
+    q->count = 0;
+    if (r->pos >= r->size || r->data[r->pos] != 'F') return false;
+    r->pos++;
+    int32_t height;
+    if (!get(r, &frame->time, 8) || !get(r, &frame->scroll_y, 4) || !get(r, &height, 4)) return false;
+    frame->height = height;
+
+    // events up to the next frame; pastes point into the file buffer
+    while (r->pos < r->size && r->data[r->pos] != 'F') {
+        int tag = r->data[r->pos++];
+        InputEvent ev = { .time = frame->time };
+        uint32_t v;
+        unsigned char mods = 0, key = 0;
+        switch (tag) {
+        case 'C':
+            if (!get(r, &mods, 1) || !get_varint(r, &v)) return false;
+            ev.type = INPUT_CHAR;
+            ev.mods = mods;
+            ev.codepoint = (int)v;
+            break;
+        case 'K':
+            if (!get(r, &mods, 1) || !get(r, &key, 1)) return false;
+            ev.type = INPUT_KEY;
+            ev.mods = mods;
+            ev.key = key;
+            break;
+        case 'P':
+            if (!get(r, &mods, 1) || !get_varint(r, &v) || r->size - r->pos < v) return false;
+            ev.type = INPUT_PASTE;
+            ev.mods = mods;
+            ev.text = (const char*)&r->data[r->pos];
+            ev.text_len = (int)v;
+            r->pos += v;
+            break;
+        case 'M':
+        case 'D':
+            if (!get(r, &ev.x, 4) || !get(r, &ev.y, 4)) return false;
+            ev.type = (tag == 'M') ? INPUT_MOUSE_PRESS : INPUT_MOUSE_DRAG;
+            break;
+        case 'R':
+            if (!get(r, &ev.x, 4) || !get(r, &ev.y, 4)) return false;
+            ev.type = INPUT_RESIZE;
+            break;
+        case 'G': {
+            float advance;
+            if (!get_varint(r, &v) || !get(r, &advance, 4)) return false;
+            bool found;
+            *map_slot(&r->advances, (int)v, &found) = advance;
+            continue;
+        }
+        case 'E':
+            r->ended = get(r, &r->end_hash, 8) && get(r, &r->end_blocks, 4);
+            r->pos = r->size;
+            return true;
+        default:
+            return false;   // corrupt
+        }
+        input_push(q, ev);
+    }
+    return true;
+}
+
+bool trace_read_end(const TraceReader *r, unsigned long long *hash, unsigned *blocks) {
+    *hash = r->end_hash;
+    *blocks = r->end_blocks;
+    return r->ended;
+}
+
+void trace_read_close(TraceReader *r) {
+    if (r == NULL) return;
+    free(r->data);
+    free(r->advances.keys);
+    free(r->advances.values);
+    free(r);
+}
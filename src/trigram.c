@@ -0,0 +1,309 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/trigram.h"
+#include "include/search_job.h"
+#include "include/profile.h"
+#define ALLOC_SUBSYSTEM ALLOC_INDEX
+#include "include/alloc_stats.h"
+
+// block ids in indexing order (they may repeat after edits), stored as
+// zigzag varint deltas: the initial build adds ids in document order, so
+// most deltas of common trigrams fit in one byte.
+typedef struct {
+    uint8_t *data;
+    int len;
+    int cap;
+    int count;
+    uint32_t last;
+} Postings;
+
+typedef struct {
+    unsigned version;    // indexed Block.version + 1, 0 = not indexed
+    unsigned postings;   // postings added for that version
+} IdEntry;
+
+struct TrigramIndex {
+    size_t max_bytes;
+    size_t used;
+    bool full;           // budget spent, further blocks stay unindexed
+
+    Postings *buckets;
+    int shift;           // bucket = hash >> shift
+    int bucket_count;
+    uint32_t *stamp;     // per bucket: last block that added it (dedupe)
+    uint32_t stamp_gen;
+
+    IdEntry *ids;        // by block id
+    int id_cap;
+
+    size_t live;         // postings of indexed versions
+    size_t stale;        // postings left behind by edits
+    int blocks;          // blocks indexed at their current version
+};
+
+static inline uint32_t bucket_of(const TrigramIndex *ix, uint32_t tri) {
+    return (tri * 2654435761u) >> ix->shift;
+}
+
+static const char* text_of(const Block *b) {
+    return b->text ? b->text : b->src;
+}
+
+// ----------------------------------------------------------------------------
+// index
+// ----------------------------------------------------------------------------
+
+TrigramIndex* trigram_index_create(size_t max_bytes) {
+    TrigramIndex *ix = (TrigramIndex*)calloc(1, sizeof(TrigramIndex));
+    ix->max_bytes = max_bytes ? max_bytes : TRIGRAM_INDEX_BYTES;
+
+    // about an eighth of the budget goes to buckets, the rest to postings
+    int bits = 12;
+    while (bits < 22 && ((size_t)2 << bits) * (sizeof(Postings) + sizeof(uint32_t)) <= ix->max_bytes / 8) bits++;
+    ix->bucket_count = 1 << bits;
+    ix->shift = 32 - bits;
+    ix->buckets = (Postings*)calloc(ix->bucket_count, sizeof(Postings));
+    ix->stamp = (uint32_t*)calloc(ix->bucket_count, sizeof(uint32_t));
+    ix->used = (size_t)ix->bucket_count * (sizeof(Postings) + sizeof(uint32_t));
+    return ix;
+}
+
+void trigram_index_free(TrigramIndex *ix) {
+    if (ix == NULL) return;
+    for (int i = 0; i < ix->bucket_count; i++) free(ix->buckets[i].data);
+    free(ix->buckets);
+    free(ix->stamp);
+    free(ix->ids);
+    free(ix);
+}
+
+size_t trigram_index_bytes(const TrigramIndex *ix) {
+    return ix->used;
+}
+
+static IdEntry* id_entry(TrigramIndex *ix, int id) {
+    if (id >= ix->id_cap) {
+        int cap = ix->id_cap ? ix->id_cap : 1024;
+        while (cap <= id) cap *= 2;
+        ix->ids = (IdEntry*)realloc(ix->ids, cap * sizeof(IdEntry));
+        memset(&ix->ids[ix->id_cap], 0, (cap - ix->id_cap) * sizeof(IdEntry));
+        ix->used += (cap - ix->id_cap) * sizeof(IdEntry);
+        ix->id_cap = cap;
+    }
+    return &ix->ids[id];
+}
+
+static bool push(TrigramIndex *ix, Postings *p, uint32_t id) {
+    if (p->len + 5 > p->cap) {
+        int cap = p->cap ? p->cap * 2 : 8;
+        size_t grow = (size_t)(cap - p->cap);
+        if (ix->used + grow > ix->max_bytes) return false;
+        p->data = (uint8_t*)realloc(p->data, cap);
+        p->cap = cap;
+        ix->used += grow;
+    }
+    int32_t delta = (int32_t)(id - p->last);
+    uint32_t v = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    while (v >= 0x80) {
+        p->data[p->len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p->data[p->len++] = (uint8_t)v;
+    p->last = id;
+    p->count++;
+    return true;
+}
+
+void trigram_index_add(TrigramIndex *ix, const Block *b) {
+    if (b->id < 0) return;
+    IdEntry *e = id_entry(ix, b->id);
+    if (e->version != 0) {
+        ix->live -= e->postings;
+        ix->stale += e->postings;
+        ix->blocks--;
+        e->version = 0;
+        e->postings = 0;
+    }
+    if (ix->full) return;
+
+    if (++ix->stamp_gen == 0) {
+        memset(ix->stamp, 0, ix->bucket_count * sizeof(uint32_t));
+        ix->stamp_gen = 1;
+    }
+    uint32_t gen = ix->stamp_gen;
+    const unsigned char *t = (const unsigned char*)text_of(b);
+    int len = block_len(b);
+    unsigned count = 0;
+    uint32_t tri = 0;
+
+    for (int i = 0; i < len; i++) {
+        tri = ((tri << 8) | t[i]) & 0xFFFFFF;
+        if (i < 2) continue;
+        uint32_t h = bucket_of(ix, tri);
+        if (ix->stamp[h] == gen) continue;
+        ix->stamp[h] = gen;
+        if (!push(ix, &ix->buckets[h], (uint32_t)b->id)) {
+            // out of budget: what was pushed is just noise now
+            ix->full = true;
+            ix->stale += count;
+            return;
+        }
+        count++;
+    }
+    e->version = b->version + 1;
+    e->postings = count;
+    ix->live += count;
+    ix->blocks++;
+}
+
+bool trigram_index_current(const TrigramIndex *ix, const Block *b) {
+    return b->id >= 0 && b->id < ix->id_cap && ix->ids[b->id].version == b->version + 1;
+}
+
+int trigram_index_sync(TrigramIndex *ix, Document *doc) {
+    int count = 0;
+    for (Block *b = doc->start; b; b = b->next) {
+        if (trigram_index_current(ix, b)) continue;
+        if (ix->full && (b->id >= ix->id_cap || ix->ids[b->id].version == 0)) continue;
+        trigram_index_add(ix, b);
+        count++;
+    }
+    return count;
+}
+
+bool trigram_index_wants_rebuild(const TrigramIndex *ix) {
+    return ix->stale > 4096 && ix->stale > ix->live;
+}
+
+// ----------------------------------------------------------------------------
+// queries
+// ----------------------------------------------------------------------------
+
+struct TrigramFilter {
+    const TrigramIndex *ix;
+    unsigned char *mark;   // by id: how many of the query's lists it was in, in order
+    int mark_count;
+    int lists;
+};
+
+TrigramFilter* trigram_filter(TrigramIndex *ix, const SearchQuery *q) {
+    const char *lit = q->needle;
+    int len = q->len;
+    if (q->regex != NULL) {
+        lit = regex_prefix(q->regex, &len);
+    } else if (q->cross_blocks && memchr(lit, SEARCH_BLOCK_SEP, len) != NULL) {
+        return NULL;  // parts of the match live in other blocks
+    }
+    if (len < 3) return NULL;
+
+    // distinct buckets of the literal, rarest first
+    uint32_t buckets[64];
+    int n = 0;
+    uint32_t tri = 0;
+    for (int i = 0; i < len; i++) {
+        tri = ((tri << 8) | (unsigned char)lit[i]) & 0xFFFFFF;
+        if (i < 2) continue;
+        uint32_t h = bucket_of(ix, tri);
+        bool seen = false;
+        for (int k = 0; k < n && !seen; k++) seen = (buckets[k] == h);
+        if (!seen && n < 64) buckets[n++] = h;
+    }
+    for (int i = 1; i < n; i++) {
+        uint32_t h = buckets[i];
+        int k = i;
+        while (k > 0 && ix->buckets[buckets[k - 1]].count > ix->buckets[h].count) {
+            buckets[k] = buckets[k - 1];
+            k--;
+        }
+        buckets[k] = h;
+    }
+    if (n > TRIGRAM_MAX_QUERY) n = TRIGRAM_MAX_QUERY;
+
+    // lists covering most blocks cost more to walk than they prune
+    if (n == 0 || ix->buckets[buckets[0]].count > ix->blocks / 2) return NULL;
+    for (int j = 1; j < n; j++) {
+        if (ix->buckets[buckets[j]].count > ix->blocks / 4) { n = j; break; }
+    }
+
+    TrigramFilter *f = (TrigramFilter*)malloc(sizeof(TrigramFilter));
+    f->ix = ix;
+    f->mark_count = ix->id_cap;
+    f->mark = (unsigned char*)calloc(ix->id_cap ? ix->id_cap : 1, 1);
+    f->lists = n;
+
+    // an id survives list j only if it was in lists 0..j-1
+    for (int j = 0; j < n; j++) {
+        const Postings *p = &ix->buckets[buckets[j]];
+        uint32_t id = 0;
+        for (int k = 0; k < p->len; ) {
+            uint32_t v = 0;
+            int shift = 0;
+            while (p->data[k] & 0x80) { v |= (uint32_t)(p->data[k++] & 0x7F) << shift; shift += 7; }
+            v |= (uint32_t)p->data[k++] << shift;
+            id += (v >> 1) ^ (0u - (v & 1));
+            if (id < (uint32_t)f->mark_count && f->mark[id] == j) f->mark[id] = (unsigned char)(j + 1);
+        }
+    }
+    return f;
+}
+
+bool trigram_filter_has(const TrigramFilter *f, const Block *b) {
+    if (b->id >= f->mark_count || !trigram_index_current(f->ix, b)) return true;
+    return f->mark[b->id] == f->lists;
+}
+
+void trigram_filter_free(TrigramFilter *f) {
+    if (f == NULL) return;
+    free(f->mark);
+    free(f);
+}
+
+// ----------------------------------------------------------------------------
+// background build
+// ----------------------------------------------------------------------------
+
+struct TrigramJob {
+    ThreadPool *pool;
+    TaskGroup group;
+    SearchSnapshot snap;
+    TrigramIndex *index;
+    int cancel;
+    int done;            // set by the worker (release)
+};
+
+static void run_build(void *arg) {
+    PROFILE_SCOPE("trigram_build");
+    TrigramJob *job = (TrigramJob*)arg;
+    for (int i = 0; i < job->snap.count; i++) {
+        if (__atomic_load_n(&job->cancel, __ATOMIC_RELAXED)) return;
+        trigram_index_add(job->index, &job->snap.blocks[i]);
+    }
+    __atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+}
+
+TrigramJob* trigram_job_start(ThreadPool *pool, Document *doc, size_t max_bytes) {
+    TrigramJob *job = (TrigramJob*)calloc(1, sizeof(TrigramJob));
+    job->pool = pool;
+    job->index = trigram_index_create(max_bytes);
+    search_snapshot(doc, &job->snap);
+    pool_submit(pool, &job->group, run_build, job);
+    return job;
+}
+
+TrigramIndex* trigram_job_take(TrigramJob *job) {
+    if (job->index == NULL || !__atomic_load_n(&job->done, __ATOMIC_ACQUIRE)) return NULL;
+    pool_wait(job->pool, &job->group);
+    TrigramIndex *ix = job->index;
+    job->index = NULL;
+    return ix;
+}
+
+void trigram_job_free(TrigramJob *job) {
+    if (job == NULL) return;
+    __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+    pool_wait(job->pool, &job->group);
+    trigram_index_free(job->index);
+    search_snapshot_free(&job->snap);
+    free(job);
+}
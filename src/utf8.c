@@ -0,0 +1,207 @@
+#include <stdint.h>
+#include <string.h>
+#include "include/utf8.h"
+#include "include/simd.h"
+
+// a decoded U+FFFD is an error unless the text spelled it out
+static inline bool is_error(const char *s, int n, int cp) {
+    return cp == UTF8_REPLACEMENT && !(n == 3 && memcmp(s, "\xEF\xBF\xBD", 3) == 0);
+}
+
+static Utf8Info check_scalar(const char *data, size_t len, size_t *errors, size_t max_errors) {
+    Utf8Info info = { 0, 0, 0 };
+    size_t i = 0;
+    while (i < len) {
+        if ((unsigned char)data[i] < 0x80) { i++; info.codepoints++; continue; }
+
+        int cp;
+        int n = utf8_decode(&data[i], len - i, &cp);
+        if (is_error(&data[i], n, cp)) {
+            if (info.error_count == 0) info.first_error = i;
+            if (errors != NULL && info.error_count < max_errors) errors[info.error_count] = i;
+            info.error_count++;
+        }
+        info.codepoints++;
+        i += n;
+    }
+    return info;
+}
+
+// fast paths only answer "valid + count"; errors are rare, so any
+// failure is re-run through check_scalar for offsets.
+#ifndef SIMD_X86
+static bool validate_scalar(const char *data, size_t len, size_t *codepoints) {
+    Utf8Info info = check_scalar(data, len, NULL, 0);
+    *codepoints = info.codepoints;
+    return info.error_count == 0;
+}
+#endif
+
+#ifdef SIMD_X86
+
+static bool validate_sse2(const char *data, size_t len, size_t *codepoints) {
+    size_t i = 0, count = 0;
+    while (i < len) {
+        if (i + 16 <= len && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)&data[i])) == 0) {
+            i += 16;
+            count += 16;
+            continue;
+        }
+        if ((unsigned char)data[i] < 0x80) { i++; count++; continue; }
+
+        int cp;
+        int n = utf8_decode(&data[i], len - i, &cp);
+        if (is_error(&data[i], n, cp)) return false;
+        i += n;
+        count++;
+    }
+    *codepoints = count;
+    return true;
+}
+
+// error classes of a (previous byte, byte) pair. a pair is invalid when
+// all three nibble lookups agree on at least one class.
+#define TOO_SHORT      (1 << 0) // 11______ 0_______ / 11______ 11______
+#define TOO_LONG       (1 << 1) // 0_______ 10______
+#define OVERLONG_3     (1 << 2) // 11100000 100_____
+#define TOO_LARGE      (1 << 3) // 11110100 1001____ ...
+#define SURROGATE      (1 << 4) // 11101101 101_____
+#define OVERLONG_2     (1 << 5) // 1100000_ 10______
+#define TOO_LARGE_1000 (1 << 6) // 11110101 1000____ ...
+#define OVERLONG_4     (1 << 6) // 11110000 1000____
+#define TWO_CONTS      (1 << 7) // 10______ 10______
+#define CARRY          (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+#define TABLE16(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// input shifted right by n bytes, pulling in the tail of prev
+#define PREV(input, prev, n) _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+SIMD_TARGET_AVX2
+static inline __m256i high_nibbles(__m256i v) {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+SIMD_TARGET_AVX2
+static inline __m256i check_block(__m256i input, __m256i prev_input) {
+    const __m256i byte_1_high_table = TABLE16(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const __m256i byte_1_low_table = TABLE16(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000);
+    const __m256i byte_2_high_table = TABLE16(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+    __m256i prev1 = PREV(input, prev_input, 1);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(byte_1_high_table, high_nibbles(prev1)),
+                         _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+        _mm256_shuffle_epi8(byte_2_high_table, high_nibbles(input)));
+
+    // third / fourth bytes of 3- and 4-byte sequences must be continuations
+    __m256i prev2 = PREV(input, prev_input, 2);
+    __m256i prev3 = PREV(input, prev_input, 3);
+    __m256i is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must_be_cont = _mm256_and_si256(_mm256_or_si256(is_third, is_fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must_be_cont, special);
+}
+
+SIMD_TARGET_AVX2
+static bool validate_avx2(const char *data, size_t len, size_t *codepoints) {
+    // a block ending in an unfinished sequence must not be followed by ascii
+    const __m256i max_complete = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    const __m256i not_cont = _mm256_set1_epi8(-65); // signed > -65: not 10xxxxxx
+
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)&data[i]);
+        uint32_t high = (uint32_t)_mm256_movemask_epi8(input);
+        if (high == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+            prev_incomplete = _mm256_setzero_si256();
+            count += 32;
+        } else {
+            error = _mm256_or_si256(error, check_block(input, prev_input));
+            prev_incomplete = _mm256_subs_epu8(input, max_complete);
+            count += (size_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(input, not_cont)));
+        }
+        prev_input = input;
+    }
+
+    // the tail goes through zero padding, so a truncated sequence at the
+    // very end shows up as "too short" like any other
+    char pad[32] = {0};
+    memcpy(pad, &data[i], len - i);
+    __m256i input = _mm256_loadu_si256((const __m256i*)pad);
+    error = _mm256_or_si256(error, check_block(input, prev_input));
+    for (; i < len; i++) {
+        if (((unsigned char)data[i] & 0xC0) != 0x80) count++;
+    }
+
+    *codepoints = count;
+    return _mm256_testz_si256(error, error);
+}
+
+#endif
+
+typedef bool (*ValidateFn)(const char *data, size_t len, size_t *codepoints);
+
+static ValidateFn best_validator(void) {
+    static ValidateFn best = NULL;
+    if (best == NULL) {
+#ifdef SIMD_X86
+        best = simd_has_avx2() ? validate_avx2 : validate_sse2;
+#else
+        best = validate_scalar;
+#endif
+    }
+    return best;
+}
+
+bool utf8_validate(const char *data, size_t len) {
+    size_t count;
+    return best_validator()(data, len, &count);
+}
+
+size_t utf8_count(const char *data, size_t len) {
+    return utf8_check(data, len, NULL, 0).codepoints;
+}
+
+Utf8Info utf8_check(const char *data, size_t len, size_t *errors, size_t max_errors) {
+    Utf8Info info = { 0, 0, 0 };
+    if (best_validator()(data, len, &info.codepoints)) return info;
+    return check_scalar(data, len, errors, max_errors);
+}
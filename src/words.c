@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include "include/words.h"
+#include "include/simd.h"
+#define ALLOC_SUBSYSTEM ALLOC_DOCUMENT
+#include "include/alloc_stats.h"
+
+// ----------------------------------------------------------------------------
+// classification
+// ----------------------------------------------------------------------------
+
+static inline bool is_blank(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool is_word(unsigned char c) {
+    unsigned char lower = c | 0x20;
+    return c >= 0x80 || (lower >= 'a' && lower <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// n <= 64 bytes into word / blank masks
+static void classify_scalar(const char *p, int n, uint64_t *word, uint64_t *blank) {
+    uint64_t w = 0, b = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)p[i];
+        if (is_word(c)) w |= 1ull << i;
+        else if (is_blank(c)) b |= 1ull << i;
+    }
+    *word = w;
+    *blank = b;
+}
+
+// starts / ends of chunk k from its class masks. carry_* = class of the
+// last byte of the previous chunk. bytes past len are valid = 0 and read
+// as blank, so the end of a run at len is found too.
+static inline void emit(uint64_t word, uint64_t blank, uint64_t valid, int k,
+                        uint64_t *carry_w, uint64_t *carry_p, uint64_t *starts, uint64_t *ends) {
+    uint64_t w = word & valid;
+    uint64_t p = ~(word | blank) & valid;
+    uint64_t prev_w = (w << 1) | *carry_w;
+    uint64_t prev_p = (p << 1) | *carry_p;
+    starts[k] = (w & ~prev_w) | (p & ~prev_p);
+    ends[k] = (prev_w & ~w) | (prev_p & ~p);
+    *carry_w = w >> 63;
+    *carry_p = p >> 63;
+}
+
+#ifdef SIMD_X86
+
+static int bounds_sse2(const char *text, int len, uint64_t *carry_w, uint64_t *carry_p, uint64_t *starts, uint64_t *ends) {
+    const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+    const __m128i nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    const __m128i case_bit = _mm_set1_epi8(0x20), under = _mm_set1_epi8('_');
+    const __m128i a_lo = _mm_set1_epi8('a' - 1), z_hi = _mm_set1_epi8('z' + 1);
+    const __m128i d_lo = _mm_set1_epi8('0' - 1), d_hi = _mm_set1_epi8('9' + 1);
+    int k = 0;
+    for (; (k + 1) * 64 <= len; k++) {
+        uint64_t word = 0, blank = 0;
+        for (int q = 0; q < 4; q++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(text + k * 64 + q * 16));
+            __m128i b = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+            __m128i lower = _mm_or_si128(v, case_bit);
+            __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, a_lo), _mm_cmplt_epi8(lower, z_hi));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, d_lo), _mm_cmplt_epi8(v, d_hi));
+            // non-ascii bytes already have the sign bit movemask reads
+            __m128i w = _mm_or_si128(_mm_or_si128(letter, digit), _mm_or_si128(_mm_cmpeq_epi8(v, under), v));
+            word |= (uint64_t)(uint16_t)_mm_movemask_epi8(w) << (16 * q);
+            blank |= (uint64_t)(uint16_t)_mm_movemask_epi8(b) << (16 * q);
+        }
+        emit(word, blank, ~0ull, k, carry_w, carry_p, starts, ends);
+    }
+    return k;
+}
+
+SIMD_TARGET_AVX2
+static int bounds_avx2(const char *text, int len, uint64_t *carry_w, uint64_t *carry_p, uint64_t *starts, uint64_t *ends) {
+    const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+    const __m256i nl = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+    const __m256i case_bit = _mm256_set1_epi8(0x20), under = _mm256_set1_epi8('_');
+    const __m256i a_lo = _mm256_set1_epi8('a' - 1), z_hi = _mm256_set1_epi8('z' + 1);
+    const __m256i d_lo = _mm256_set1_epi8('0' - 1), d_hi = _mm256_set1_epi8('9' + 1);
+    int k = 0;
+    for (; (k + 1) * 64 <= len; k++) {
+        uint64_t word = 0, blank = 0;
+        for (int q = 0; q < 2; q++) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(text + k * 64 + q * 32));
+            __m256i b = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(v, nl), _mm256_cmpeq_epi8(v, cr)));
+            __m256i lower = _mm256_or_si256(v, case_bit);
+            __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, a_lo), _mm256_cmpgt_epi8(z_hi, lower));
+            __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, d_lo), _mm256_cmpgt_epi8(d_hi, v));
+            __m256i w = _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_or_si256(_mm256_cmpeq_epi8(v, under), v));
+            word |= (uint64_t)(uint32_t)_mm256_movemask_epi8(w) << (32 * q);
+            blank |= (uint64_t)(uint32_t)_mm256_movemask_epi8(b) << (32 * q);
+        }
+        emit(word, blank, ~0ull, k, carry_w, carry_p, starts, ends);
+    }
+    return k;
+}
+
+#endif
+
+static ScanKernel best_kernel(void) {
+    static ScanKernel best = SCAN_AUTO;
+    if (best == SCAN_AUTO) {
+#ifdef SIMD_X86
+        best = simd_has_avx2() ? SCAN_AVX2 : SCAN_SSE2;
+#else
+        best = SCAN_SCALAR;
+#endif
+    }
+    return best;
+}
+
+void word_bounds_with(ScanKernel kernel, const char *text, int len, uint64_t *starts, uint64_t *ends) {
+    if (kernel == SCAN_AUTO) kernel = best_kernel();
+    uint64_t carry_w = 0, carry_p = 0;
+    int k = 0;
+#ifdef SIMD_X86
+    if (kernel == SCAN_AVX2 && best_kernel() == SCAN_AVX2) k = bounds_avx2(text, len, &carry_w, &carry_p, starts, ends);
+    else if (kernel != SCAN_SCALAR) k = bounds_sse2(text, len, &carry_w, &carry_p, starts, ends);
+#endif
+    // the rest, up to the chunk holding position len
+    for (; k < word_bits_words(len); k++) {
+        int n = len - k * 64;
+        if (n > 64) n = 64;
+        uint64_t word, blank;
+        classify_scalar(text + k * 64, n, &word, &blank);
+        emit(word, blank, (n == 64) ? ~0ull : (1ull << n) - 1, k, &carry_w, &carry_p, starts, ends);
+    }
+}
+
+void word_bounds(const char *text, int len, uint64_t *starts, uint64_t *ends) {
+    word_bounds_with(SCAN_AUTO, text, len, starts, ends);
+}
+
+// ----------------------------------------------------------------------------
+// blocks
+// ----------------------------------------------------------------------------
+
+WordBits block_words(Block *b) {
+    block_load(b);
+    BlockMeta *m = b->meta;
+    int h = b->handle;
+    int len = block_len(b);
+    int n = word_bits_words(len);
+    if (m->words_version[h] != b->version + 1) {
+        m->words[h] = (uint64_t*)realloc(m->words[h], 2 * n * sizeof(uint64_t));
+        word_bounds(b->text, len, m->words[h], m->words[h] + n);
+        m->words_version[h] = b->version + 1;
+    }
+    return (WordBits){ m->words[h], m->words[h] + n, len };
+}
+
+// ----------------------------------------------------------------------------
+// lookups
+// ----------------------------------------------------------------------------
+
+int word_prev_start(const WordBits *w, int index) {
+    if (index <= 0) return 0;
+    int i = index - 1;
+    int k = i >> 6;
+    uint64_t bits = w->starts[k] & (~0ull >> (63 - (i & 63)));
+    while (bits == 0) {
+        if (--k < 0) return 0;
+        bits = w->starts[k];
+    }
+    return k * 64 + 63 - __builtin_clzll(bits);
+}
+
+int word_next_end(const WordBits *w, int index) {
+    if (index >= w->len) return w->len;
+    int i = index + 1;
+    int k = i >> 6;
+    int last = w->len >> 6;
+    uint64_t bits = w->ends[k] & (~0ull << (i & 63));
+    while (bits == 0) {
+        if (++k > last) return w->len;
+        bits = w->ends[k];
+    }
+    return k * 64 + __builtin_ctzll(bits);
+}